@@ -24,6 +24,11 @@ long util_sys_random(void)
 //  return random();
 }
 
+void util_sys_entropy(uint8_t *bytes, size_t len)
+{
+  while(len-- > 0) *bytes++ = (uint8_t)util_sys_random();
+}
+
 int _debugging = 0;
 void util_sys_logging(int enabled)
 {
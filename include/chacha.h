@@ -10,6 +10,12 @@ extern "C" {
 // a convert-in-place utility
 uint8_t *chacha20(uint8_t *key, uint8_t *nonce, uint8_t *bytes, uint32_t len);
 
+// starting at a given 64-byte block counter, in and out may be the same
+uint8_t *chacha20_counter(uint8_t *key, uint8_t *nonce, uint64_t counter, uint8_t *in, uint8_t *out, uint32_t len);
+
+// cap the block-parallel kernel used (0 scalar, 1 sse2/neon 4-way, 2 avx2 8-way), returns the one now in use
+uint8_t chacha20_kernel(uint8_t max);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -24,6 +24,7 @@ struct chan_struct
   void (*handle)(chan_t c, void *arg);
 
   enum chan_states state;
+  uint8_t priority; // link send queue class, LINK_INTERACTIVE default
 };
 
 // caller must manage lists of channels per e3x_exchange based on cid
@@ -50,6 +51,9 @@ chan_t chan_err(chan_t c, char *err); // generates local-only error packet for n
 // must be called after every send or receive, processes resends/timeouts, fires handlers
 chan_t chan_process(chan_t c, uint32_t now);
 
+// set the link send queue priority class for this channel's packets
+chan_t chan_priority(chan_t c, uint8_t priority);
+
 // set up internal handler for all incoming packets on this channel
 chan_t chan_handle(chan_t c, void (*handle)(chan_t c, void *arg), void *arg);
 
@@ -0,0 +1,23 @@
+#ifndef _CRC32C_H_
+#define _CRC32C_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// crc32c (castagnoli), uses sse4.2 or armv8 crc instructions when available
+uint32_t crc32c(const uint8_t *data, uint32_t len);
+
+// continue a running crc, start with 0
+uint32_t crc32c_update(uint32_t crc, const uint8_t *data, uint32_t len);
+
+// cap the kernel used (0 table, 1 hardware), returns the one now in use
+uint8_t crc32c_kernel(uint8_t max);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !_CRC32C_H_ */
@@ -41,6 +41,9 @@ void e3x_random(uint8_t (*frand)(void));
 // sha256 hashing, from one of the cipher sets
 uint8_t *e3x_hash(uint8_t *in, size_t len, uint8_t *out32);
 
+// top up the cipher sets' ephemeral key pools (init option "pool") by at most one key each, call when idle, returns how many were made
+uint32_t e3x_refill(void);
+
 
 // local endpoint state management
 #include "e3x_self.h"
@@ -38,6 +38,11 @@ typedef struct e3x_cipher_struct
   lob_t (*ephemeral_encrypt)(ephemeral_t ephemeral, lob_t inner);
   lob_t (*ephemeral_decrypt)(ephemeral_t ephemeral, lob_t outer);
 
+  // optional, make one more pre-generated key if there's room, returns how many were made
+  uint8_t (*refill)(void);
+
+  uint32_t replays; // channel packets dropped by the ephemeral replay window
+
   uint8_t id, csid;
   char hex[3], *alg;
 } *e3x_cipher_t;
@@ -48,7 +53,8 @@ typedef struct e3x_cipher_struct
 #define CS_1c 1
 #define CS_2a 2
 #define CS_3a 3
-#define CS_MAX 4
+#define CS_4a 4
+#define CS_MAX 5
 
 extern e3x_cipher_t e3x_cipher_sets[]; // all created
 extern e3x_cipher_t e3x_cipher_default; // just one of them for the rand/hash utils
@@ -64,5 +70,28 @@ e3x_cipher_t cs1a_init(lob_t options);
 e3x_cipher_t cs1c_init(lob_t options);
 e3x_cipher_t cs2a_init(lob_t options);
 e3x_cipher_t cs3a_init(lob_t options);
+e3x_cipher_t cs4a_init(lob_t options);
+
+// builds with only cs1a (-DE3X_ONLY_1a) call it directly instead of through the table, so LTO can inline the packet path
+#ifdef E3X_ONLY_1a
+#define E3X_CALL(cs, fn) cs1a_##fn
+uint8_t *cs1a_hash(uint8_t *in, size_t len, uint8_t *out32);
+uint8_t *cs1a_err(void);
+uint8_t cs1a_generate(lob_t keys, lob_t secrets);
+local_t cs1a_local_new(lob_t keys, lob_t secrets);
+void cs1a_local_free(local_t local);
+lob_t cs1a_local_decrypt(local_t local, lob_t outer);
+remote_t cs1a_remote_new(lob_t key, uint8_t *token);
+void cs1a_remote_free(remote_t remote);
+uint8_t cs1a_remote_verify(remote_t remote, local_t local, lob_t outer);
+lob_t cs1a_remote_encrypt(remote_t remote, local_t local, lob_t inner);
+ephemeral_t cs1a_ephemeral_new(remote_t remote, lob_t outer);
+void cs1a_ephemeral_free(ephemeral_t ephemeral);
+lob_t cs1a_ephemeral_encrypt(ephemeral_t ephemeral, lob_t inner);
+lob_t cs1a_ephemeral_decrypt(ephemeral_t ephemeral, lob_t outer);
+uint8_t cs1a_refill(void);
+#else
+#define E3X_CALL(cs, fn) (cs)->fn
+#endif
 
 #endif
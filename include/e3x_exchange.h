@@ -11,6 +11,7 @@ typedef struct e3x_exchange_struct
   e3x_cipher_t cs; // convenience
   e3x_self_t self;
   remote_t remote;
+  lob_t key; // theirs, to make a new remote w/ a new ephemeral key when going down
   ephemeral_t ephem;
   uint32_t in, out;
   uint32_t cid, last;
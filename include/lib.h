@@ -4,7 +4,10 @@
 #include "js0n.h"
 #include "lob.h"
 #include "murmur.h"
+#include "crc32c.h"
 #include "chacha.h"
+#include "poly1305.h"
+#include "x25519.h"
 #include "xht.h"
 #include "aes128.h"
 #include "sha256.h"
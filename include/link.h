@@ -4,6 +4,23 @@
 
 #include "mesh.h"
 
+// send queue priority classes, lower is more urgent
+enum link_priorities { LINK_HANDSHAKE, LINK_CONTROL, LINK_INTERACTIVE, LINK_BULK, LINK_PRIORITIES };
+
+// one delivery path for a link, links may have several
+typedef struct link_pipe_struct
+{
+  link_t (*send)(link_t link, lob_t packet, void *arg);
+  void *arg;
+  uint32_t rtt; // smoothed ms, 0 until measured
+  uint32_t probes, replies; // measurement counts, difference is loss
+  uint8_t fails; // consecutive delivery failures, down at LINK_PIPE_FAILS
+  struct link_pipe_struct *next;
+} *link_pipe_t;
+
+// consecutive send failures before a pipe is considered down
+#define LINK_PIPE_FAILS 3
+
 struct link_struct
 {
   // public link data
@@ -13,13 +30,31 @@ struct link_struct
   lob_t key;
   chan_t chans;
 
-  // transport plumbing
-  void *send_arg;
-  link_t (*send_cb)(link_t link, lob_t packet, void *arg);
+  // last encrypted handshake, reused until the exchange out at changes
+  lob_t handshake;
+  uint32_t handshake_at;
+
+  // transport plumbing, newest first
+  link_pipe_t pipes;
+
+  // outgoing packets waiting on the pipe, one list per priority
+  lob_t queue[LINK_PRIORITIES];
+  uint32_t queued; // bytes in the queue
+  uint32_t inflight; // bytes given to the pipe that it hasn't link_sent() yet
+  uint32_t window; // max inflight bytes, 0 is unlimited
+
+  // keepalive timing, in the same units as process(now)
+  uint32_t seen; // last process() after we heard from them
+  uint32_t probed; // last keepalive probe sent
   
   // these are for internal link management only
   link_t next;
   uint8_t csid;
+  uint8_t turn; // striping rotation
+  uint8_t blocked:1; // window was full, fire writable event when it opens
+  uint8_t stripe:1; // spread bulk packets across all healthy pipes
+  uint8_t heard:1; // received something since the last process()
+  uint8_t flushing:1; // in link_flush(), pipes calling link_sent() from send don't recurse
 };
 
 // these all create or return existing one from the mesh
@@ -40,22 +75,59 @@ void link_free(link_t link);
 // load in the key to existing link
 link_t link_load(link_t link, uint8_t csid, lob_t key);
 
-// add a delivery pipe to this link
+// add a delivery pipe to this link, NULL only if it wasn't added (a failed handshake on it counts in its fails)
 link_t link_pipe(link_t link, link_t (*send)(link_t link, lob_t packet, void *arg), void *arg);
 
+// remove a pipe (transport closed it), traffic fails over to any others
+link_t link_unpipe(link_t link, link_t (*send)(link_t link, lob_t packet, void *arg), void *arg);
+
+// iterate over the pipes, pass NULL to start
+link_pipe_t link_pipes(link_t link, link_pipe_t after);
+
+// the pipe currently chosen for sending, lowest rtt adjusted for loss
+link_pipe_t link_pipe_best(link_t link);
+
+// deliver this encrypted packet on a specific pipe
+link_t link_pipe_send(link_t link, link_pipe_t pipe, lob_t outer);
+
+// track measurements, a probe was sent and a reply came back after rtt ms
+link_pipe_t link_pipe_probe(link_t link, link_pipe_t pipe);
+link_pipe_t link_pipe_rtt(link_t link, link_pipe_t pipe, uint32_t rtt);
+
+// bool to spread bulk traffic across every healthy pipe
+link_t link_stripe(link_t link, uint8_t stripe);
+
 // process a decrypted channel packet
 link_t link_receive(link_t link, lob_t inner);
 
+// process a list of decrypted channel packets, channel handlers run once at the end
+link_t link_receive_batch(link_t link, lob_t inners);
+
 // process an incoming handshake
 link_t link_receive_handshake(link_t link, lob_t handshake);
 
-// try to deliver this encrypted packet
+// try to deliver this encrypted packet (interactive priority)
 link_t link_send(link_t link, lob_t outer);
 
+// queue this encrypted packet at the given priority, sends whatever the window allows
+link_t link_queue(link_t link, lob_t outer, uint8_t priority);
+
+// deliver any queued packets in priority order while the window has space
+link_t link_flush(link_t link);
+
+// set the max bytes in flight to the pipe (0 is unlimited), returns current
+uint32_t link_window(link_t link, uint32_t window);
+
+// called by pipes when this many bytes have actually left, opens the window and flushes
+link_t link_sent(link_t link, uint32_t len);
+
+// returns link if there's window space for more data, else NULL until the writable event
+link_t link_writable(link_t link);
+
 // encrypt and send this packet
 link_t link_direct(link_t link, lob_t inner);
 
-// return current handshake (caller free's)
+// return current handshake (caller free's), cached until the out at changes
 lob_t link_handshake(link_t link);
 
 // send current handshake(s) 
@@ -76,4 +148,7 @@ chan_t link_chan(link_t link, lob_t open);
 // process any channel timeouts based on the current/given time
 link_t link_process(link_t link, uint32_t now);
 
+// when link_process() next has work (keepalive, timeout or channel timeout), now if overdue, 0 if nothing scheduled
+uint32_t link_deadline(link_t link, uint32_t now);
+
 #endif
@@ -43,6 +43,9 @@ lob_t lob_unlink(lob_t parent);
 // initialize head/body from raw, parses json
 lob_t lob_parse(const uint8_t *raw, size_t len);
 
+// same as parse but takes ownership of malloc'd raw (no copy), it is free'd on failure
+lob_t lob_adopt(uint8_t *raw, size_t len);
+
 // return full encoded packet
 uint8_t *lob_raw(lob_t p);
 size_t lob_len(lob_t p);
@@ -4,7 +4,7 @@
 typedef struct mesh_struct *mesh_t;
 typedef struct link_struct *link_t;
 typedef struct chan_struct *chan_t;
-
+typedef struct mesh_admission_struct *mesh_admission_t;
 
 
 #include "e3x.h"
@@ -23,6 +23,49 @@ struct mesh_struct
   uint16_t port_local, port_public;
   char *ipv4_local, *ipv4_public;
   link_t links;
+  // seconds, 0 disables
+  uint32_t keepalive; // probe links that have been quiet this long
+  uint32_t timeout; // force links down that have been quiet this long
+  mesh_admission_t admission; // handshake load shedding, NULL when off
+  void *keys_seen; // internal lru of handshake keys to hashnames
+  uint32_t keys_hit, keys_parsed; // handshakes whose hashname came from keys_seen vs was parsed and hashed
+};
+
+// handshake keys remembered with their hashname, 0 disables
+#ifndef MESH_KEY_CACHE
+#define MESH_KEY_CACHE 32
+#endif
+
+// handshake admission buckets, sources hash into these
+#ifndef MESH_ADMISSION_BUCKETS
+#define MESH_ADMISSION_BUCKETS 64
+#endif
+
+// seconds a cookie is valid for, the previous one is still accepted
+#define MESH_COOKIE_EPOCH 60
+
+// handshakes echoing a valid cookie get this many times the rate and burst, from their own bucket
+#ifndef MESH_COOKIE_SCALE
+#define MESH_COOKIE_SCALE 4
+#endif
+
+struct mesh_admission_struct
+{
+  // counters, public
+  uint32_t admitted; // handshakes within their source's budget
+  uint32_t challenged; // over budget, answered with a cookie instead
+  uint32_t cookied; // admitted by echoing a valid cookie
+  uint32_t dropped; // bad cookies, cookied ones over budget and challenges nobody can send
+
+  // internal
+  uint32_t rate, burst; // tokens per second per source, max saved
+  uint32_t now; // last mesh_process time
+  uint8_t secret[32];
+  struct {
+    uint32_t tokens;
+    uint32_t cookies; // tokens for cookied handshakes
+    uint32_t at;
+  } buckets[MESH_ADMISSION_BUCKETS];
 };
 
 mesh_t mesh_new(void);
@@ -57,12 +100,34 @@ mesh_t mesh_unlink(link_t link);
 // processes incoming packet, it will take ownership of packet, returns link delivered to if success
 link_t mesh_receive(mesh_t mesh, lob_t packet);
 
+// processes a list of incoming packets, channel packets are decrypted together and handled once per link, returns last link delivered to
+link_t mesh_receive_batch(mesh_t mesh, lob_t packets);
+
 // process any unencrypted handshake packet
 link_t mesh_receive_handshake(mesh_t mesh, lob_t handshake);
 
 // process any channel timeouts based on the current/given time
 mesh_t mesh_process(mesh_t mesh, uint32_t now);
 
+// when mesh_process() should next run, now if it's overdue and 0 if nothing is scheduled (event loops sleep until then)
+uint32_t mesh_deadline(mesh_t mesh, uint32_t now);
+
+// limit handshakes to rate per second from any source with a burst allowance, rate 0 turns it off
+mesh_t mesh_admission(mesh_t mesh, uint32_t rate, uint32_t burst);
+
+// transports pass every packet with its source address (any unique bytes) before mesh_receive
+// returns the packet to receive or NULL if it was consumed, sets challenge to a packet to send back to the source
+lob_t mesh_admit(mesh_t mesh, lob_t packet, uint8_t *from, size_t len, lob_t *challenge);
+
+// wraps an outgoing handshake with a cookie from a challenge, takes ownership of handshake
+lob_t mesh_cookie(lob_t handshake, char *cookie);
+
+// length mesh_cookie() would make it, so size limits can be checked before giving it up
+size_t mesh_cookie_len(lob_t handshake, char *cookie);
+
+// probe idle links after keepalive seconds and take them down after timeout seconds of silence, 0 disables either
+mesh_t mesh_keepalive(mesh_t mesh, uint32_t keepalive, uint32_t timeout);
+
 // callback when the mesh is free'd
 void mesh_on_free(mesh_t mesh, char *id, void (*free)(mesh_t mesh));
 
@@ -78,9 +143,17 @@ void mesh_discover(mesh_t mesh, lob_t discovered);
 void mesh_on_link(mesh_t mesh, char *id, void (*link)(link_t link));
 void mesh_link(mesh_t mesh, link_t link);
 
+// callback when a link's send window has space again after being full
+void mesh_on_writable(mesh_t mesh, char *id, void (*writable)(link_t link));
+void mesh_writable(mesh_t mesh, link_t link);
+
 // callback when a new incoming channel is requested
 void mesh_on_open(mesh_t mesh, char *id, lob_t (*open)(link_t link, lob_t open));
 lob_t mesh_open(mesh_t mesh, link_t link, lob_t open);
 
+// callback with each encrypted handshake before it is decrypted, return NULL to take it
+void mesh_on_handshake(mesh_t mesh, char *id, lob_t (*handshake)(mesh_t mesh, lob_t outer));
+lob_t mesh_handshake(mesh_t mesh, lob_t outer);
+
 
 #endif
@@ -0,0 +1,56 @@
+#ifndef net_shm_h
+#define net_shm_h
+
+#ifdef __linux__
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mesh.h"
+#include "util_loop.h"
+
+// default bytes in each direction's ring, must be a power of two
+#ifndef NET_SHM_RING
+#define NET_SHM_RING 1048576
+#endif
+
+// most packets taken from one ring before delivering them
+#ifndef NET_SHM_BATCH
+#define NET_SHM_BATCH 256
+#endif
+
+// ms between connect attempts while a listener's backlog is full
+#ifndef NET_SHM_RETRY
+#define NET_SHM_RETRY 10
+#endif
+
+// same-host transport, every peer gets a memfd with one single-producer/single-consumer ring per direction
+// packets are copied straight into the ring and an eventfd doorbell is only rung when the other side is asleep, so a busy pipe makes no syscalls
+// a unix socket at the path hands over the memfd and eventfds and stays open so either side going away is noticed
+typedef struct net_shm_struct *net_shm_t;
+
+// listen at options {"path":"/run/x.sock","ring":65536}, resolves {"type":"shm","path":"..."} paths for its mesh
+// peers are only accepted from our own uid (or root) unless options has "any":true
+net_shm_t net_shm_new(mesh_t mesh, lob_t options);
+net_shm_t net_shm_free(net_shm_t net);
+
+// our path for others to link to, caller frees
+lob_t net_shm_path(net_shm_t net);
+
+// the kernel-verified credentials of the process at the other end of this link, NULL if it has no shm pipe
+net_shm_t net_shm_peer(net_shm_t net, link_t link, uid_t *uid, pid_t *pid);
+
+// accept, drain the rings and send any backlog, delivers packets into mesh (polling this spins)
+net_shm_t net_shm_process(net_shm_t net);
+
+// event loop interface, the listener and each peer's socket and doorbell (which are armed by asking for these)
+int net_shm_fds(net_shm_t net, struct pollfd *fds, int max, int *ms);
+net_shm_t net_shm_ready(net_shm_t net, struct pollfd *fds, int count);
+
+// have the reference loop drive this transport
+net_shm_t net_shm_loop(net_shm_t net, util_loop_t loop);
+
+#endif // __linux__
+
+#endif // net_shm_h
@@ -9,24 +9,37 @@
 #include <stdlib.h>
 
 #include "mesh.h"
+#include "util_loop.h"
+
+// bytes read from a socket at once
+#ifndef NET_TCP4_READ
+#define NET_TCP4_READ 65536
+#endif
 
 // overall server
-typedef struct net_tcp4_struct
-{
-  int server;
-  int port;
-  mesh_t mesh;
-  xht_t pipes;
-  lob_t path;
-} *net_tcp4_t;
-
-// create a new listening tcp server
+typedef struct net_tcp4_struct *net_tcp4_t;
+
+// create a new listening tcp server, resolves {"type":"tcp4","ip":"...","port":123} paths for its mesh
 net_tcp4_t net_tcp4_new(mesh_t mesh, lob_t options);
-void net_tcp4_free(net_tcp4_t net);
+net_tcp4_t net_tcp4_free(net_tcp4_t net);
 
-// check all sockets for work (just for testing, use libuv or such for production instead)
-net_tcp4_t net_tcp4_loop(net_tcp4_t net);
+// accept, read and flush whatever won't block, delivers packets into mesh (polling this spins)
+net_tcp4_t net_tcp4_process(net_tcp4_t net);
 
-#endif
+// event loop interface, the listener and every connection w/ write interest only while there's data or a connect pending
+int net_tcp4_fds(net_tcp4_t net, struct pollfd *fds, int max, int *ms);
+net_tcp4_t net_tcp4_ready(net_tcp4_t net, struct pollfd *fds, int count);
 
-#endif
+// have the reference loop drive this transport
+net_tcp4_t net_tcp4_loop(net_tcp4_t net, util_loop_t loop);
+
+// return server socket handle / port
+int net_tcp4_socket(net_tcp4_t net);
+uint16_t net_tcp4_port(net_tcp4_t net);
+
+// send a packet directly, over the existing connection to this address or a new one
+net_tcp4_t net_tcp4_direct(net_tcp4_t net, lob_t packet, char *ip, uint16_t port);
+
+#endif // POSIX
+
+#endif // net_tcp4_h
@@ -9,17 +9,33 @@
 #include <stdlib.h>
 
 #include "mesh.h"
+#include "util_loop.h"
+
+// ms between meta frames to a pipe that's waiting on the other side, only while busy
+#ifndef NET_UDP4_NUDGE
+#define NET_UDP4_NUDGE 100
+#endif
 
 // overall server
 typedef struct net_udp4_struct *net_udp4_t;
 
-// create a new listening udp server
+// create a new listening udp server, options:
+//   port, window (link send window in bytes)
+//   crc (1 for crc32c frame checks), frames (windowed mode frames in flight, 0 lockstep), fec (parity group when windowed)
+// the frame modes aren't negotiated, every peer must be created w/ the same ones
 net_udp4_t net_udp4_new(mesh_t mesh, lob_t options);
 net_udp4_t net_udp4_free(net_udp4_t net);
 
-// send/receive any waiting frames, delivers packets into mesh
+// send/receive any waiting frames, delivers packets into mesh (never blocks, polling this spins)
 net_udp4_t net_udp4_process(net_udp4_t net);
 
+// event loop interface, report the socket w/ its interest and service it once ready or after *ms
+int net_udp4_fds(net_udp4_t net, struct pollfd *fds, int max, int *ms);
+net_udp4_t net_udp4_ready(net_udp4_t net, struct pollfd *fds, int count);
+
+// have the reference loop drive this transport
+net_udp4_t net_udp4_loop(net_udp4_t net, util_loop_t loop);
+
 // return server socket handle / port
 int net_udp4_socket(net_udp4_t net);
 uint16_t net_udp4_port(net_udp4_t net);
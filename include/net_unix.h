@@ -0,0 +1,49 @@
+#ifndef net_unix_h
+#define net_unix_h
+
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mesh.h"
+#include "util_loop.h"
+
+// largest packet, every message is one whole packet
+#ifndef NET_UNIX_MAX
+#define NET_UNIX_MAX 65536
+#endif
+
+// ms between connect attempts while a listener's backlog is full
+#ifndef NET_UNIX_RETRY
+#define NET_UNIX_RETRY 10
+#endif
+
+// same-host transport over SOCK_SEQPACKET unix sockets, no framing or hashing since the kernel keeps message boundaries
+typedef struct net_unix_struct *net_unix_t;
+
+// listen at options {"path":"/run/x.sock"} (replacing any stale socket there), resolves {"type":"unix","path":"..."} paths for its mesh
+// peers are only accepted from our own uid (or root) unless options has "any":true
+net_unix_t net_unix_new(mesh_t mesh, lob_t options);
+net_unix_t net_unix_free(net_unix_t net);
+
+// our path for others to link to, caller frees
+lob_t net_unix_path(net_unix_t net);
+
+// the kernel-verified credentials of the process at the other end of this link, NULL if it has no unix pipe
+net_unix_t net_unix_peer(net_unix_t net, link_t link, uid_t *uid, pid_t *pid);
+
+// accept, read and send whatever won't block, delivers packets into mesh (polling this spins)
+net_unix_t net_unix_process(net_unix_t net);
+
+// event loop interface, the listener and every connection w/ write interest only while packets are queued
+int net_unix_fds(net_unix_t net, struct pollfd *fds, int max, int *ms);
+net_unix_t net_unix_ready(net_unix_t net, struct pollfd *fds, int count);
+
+// have the reference loop drive this transport
+net_unix_t net_unix_loop(net_unix_t net, util_loop_t loop);
+
+#endif // POSIX
+
+#endif // net_unix_h
@@ -0,0 +1,30 @@
+#ifndef _POLY1305_H_
+#define _POLY1305_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// one-time authenticator, a key must never be used for more than one message
+typedef struct poly1305_context {
+  uint32_t r[5], h[5], pad[4];
+  size_t leftover;
+  uint8_t buffer[16];
+  uint8_t final;
+} POLY1305_CTX;
+
+void poly1305_init(POLY1305_CTX *ctx, const uint8_t key[32]);
+void poly1305_update(POLY1305_CTX *ctx, const uint8_t *m, size_t len);
+void poly1305_finish(POLY1305_CTX *ctx, uint8_t mac[16]);
+
+// all at once
+uint8_t *poly1305(uint8_t mac[16], const uint8_t *m, size_t len, const uint8_t key[32]);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !_POLY1305_H_ */
@@ -35,6 +35,14 @@ faster somewhat faster, but increases the code size. */
     #define uECC_SQUARE_FUNC 0
 #endif
 
+/* uECC_FIXED_BASE - If enabled (defined as nonzero), multiplying the curve generator (key
+generation and signing) uses a 4-bit window table of precomputed affine multiples that is built
+by uECC_precompute(), one addition per window and no doublings. This is several times faster but keeps
+about 60KB (secp256r1) or 30KB (secp160r1) of RAM per curve, so it is meant for servers. */
+#ifndef uECC_FIXED_BASE
+    #define uECC_FIXED_BASE 0
+#endif
+
 /* uECC_VLI_NATIVE_LITTLE_ENDIAN - If enabled (defined as nonzero), this will switch to native
 little-endian format for *all* arrays passed in and out of the public API. This includes public 
 and private keys, shared secrets, signatures and message hashes. 
@@ -130,6 +138,16 @@ Returns the function that will be used to generate random bytes.
 */
 uECC_RNG_Function uECC_get_rng(void);
 
+#if uECC_FIXED_BASE
+/* uECC_precompute() function.
+Builds the fixed-base table for a curve, curves without one use the regular ladder. This is not
+thread-safe, call it once per curve at startup before any other threads use uECC.
+
+Returns 1 if the table is available, 0 if it could not be built.
+*/
+int uECC_precompute(uECC_Curve curve);
+#endif
+
 /* uECC_curve_private_key_size() function.
 
 Returns the size of a private key for the curve in bytes.
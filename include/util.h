@@ -10,6 +10,7 @@
 #include "util_chunks.h"
 #include "util_frames.h"
 #include "util_unix.h"
+#include "util_workers.h"
 
 // make sure out is 2*len + 1
 char *util_hex(uint8_t *in, size_t len, char *out);
@@ -4,6 +4,15 @@
 #include <stdint.h>
 #include "lob.h"
 
+// largest packet accepted in stream mode
+#define UTIL_CHUNKS_STREAM_MAX (64*1024*1024)
+
+// most spans exported at once for writev()
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+#include <sys/uio.h>
+#define UTIL_CHUNKS_IOV 16
+#endif
+
 // for list of incoming chunks
 typedef struct util_chunk_struct
 {
@@ -23,8 +32,20 @@ typedef struct util_chunks_struct
   uint8_t waiting; // current writing chunk size;
   uint8_t readat; // always less than a max chunk, offset into reading
 
+  // stream mode, each packet is a varint length then the raw bytes
+  lob_t ready; // packets read in full
+  uint8_t *readbuf; // storage of the packet being read, becomes its raw
+  uint32_t readlen; // length of the packet being read (or varint so far)
+  uint32_t readgot; // bytes of it read so far
+  uint8_t readbits; // shift of the next varint byte
+  uint8_t head[5]; // varint length of the packet being written
+  uint8_t headlen, headat;
+#ifdef UTIL_CHUNKS_IOV
+  uint8_t iohead[UTIL_CHUNKS_IOV][5]; // size bytes of the chunks/packets after the current one when exported
+#endif
+
   uint8_t cap;
-  uint8_t blocked:1, blocking:1, ack:1, err:1; // bool flags
+  uint8_t blocked:1, blocking:1, ack:1, err:1, stream:1; // bool flags
 } *util_chunks_t;
 
 
@@ -33,6 +54,10 @@ util_chunks_t util_chunks_new(uint8_t size);
 
 util_chunks_t util_chunks_free(util_chunks_t chunks);
 
+// varint length framing w/ no size cap, acks or blocking, for reliable streams (tcp, unix sockets) on both sides
+// packets are read straight into their own storage, the frame-based calls below don't apply
+util_chunks_t util_chunks_stream(util_chunks_t chunks, uint8_t stream);
+
 // turn this packet into chunks and append, free's out
 util_chunks_t util_chunks_send(util_chunks_t chunks, lob_t out);
 
@@ -51,9 +76,15 @@ uint32_t util_chunks_len(util_chunks_t chunks);
 // return the next block of data to be written to the stream transport, max len is util_chunks_len()
 uint8_t *util_chunks_write(util_chunks_t chunks);
 
-// advance the write this far, don't mix with util_chunks_out() usage
+// advance the write this far, may span many chunks/packets, don't mix with util_chunks_out() usage
 util_chunks_t util_chunks_written(util_chunks_t chunks, size_t len);
 
+#ifdef UTIL_CHUNKS_IOV
+// fill up to max (capped at UTIL_CHUNKS_IOV) spans w/ everything ready to write for one writev(), returns count
+// valid until the next call or util_chunks_written()
+int util_chunks_iov(util_chunks_t chunks, struct iovec *iov, int max);
+#endif
+
 // queues incoming stream based data
 util_chunks_t util_chunks_read(util_chunks_t chunks, uint8_t *block, size_t len);
 
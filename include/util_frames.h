@@ -4,13 +4,8 @@
 #include <stdint.h>
 #include "lob.h"
 
-// for list of incoming frames
-typedef struct util_frame_struct
-{
-  struct util_frame_struct *prev;
-  uint32_t hash;
-  uint8_t data[];
-} *util_frame_t;
+// most frames in flight in windowed mode, limited by the ack bitmap in meta frames
+#define UTIL_FRAMES_WINDOW 32
 
 typedef struct util_frames_struct
 {
@@ -18,18 +13,35 @@ typedef struct util_frames_struct
   lob_t inbox; // received packets waiting to be processed
   lob_t outbox; // current packet being sent out
 
-  util_frame_t cache; // stacked linked list of incoming frames in progress
+  uint8_t *cache; // incoming frames in progress, reassembled in place (growing by doubling) and adopted as the packet's raw storage
+  uint32_t *hashes; // hash of each cached frame
+  uint32_t cachelen; // bytes allocated for cache
+  uint16_t hashlen; // entries allocated for hashes
 
   uint32_t inbase; // last confirmed inbox hash
   uint32_t outbase; // last confirmed outbox hash
 
-  uint8_t in; // number of incoming frames received/waiting
-  uint8_t out; //  number of outgoing frames of outbox sent since outbase
+  uint16_t in; // number of incoming frames received/waiting
+  uint16_t out; //  number of outgoing frames of outbox sent since outbase
+
+  // windowed mode only, frames are numbered and acked selectively
+  uint64_t inmask; // frames received past the next expected one, bit0 is frame inseq+in
+  uint64_t resend; // frames to retransmit, bit0 is frame outack
+  uint16_t inseq; // frame number starting the packet being reassembled
+  uint16_t inmax; // one past the highest frame number known to be sent to us
+  uint16_t outseq; // frame number starting the first outbox packet
+  uint16_t outack; // oldest frame not acked yet
+  uint16_t outnext; // next frame never sent yet
+  uint8_t window; // max frames in flight, 0 is lockstep
+  uint8_t fec; // data frames per parity frame when windowed, 0 is off
+  uint8_t *fecs; // parity groups being received
 
   uint8_t size; // frame size
   uint8_t flush:1; // bool to signal a flush is needed
   uint8_t err:1; // unrecoverable failure
   uint8_t more:1; // last incoming meta said there was more
+  uint8_t parity:1; // a parity frame is due to be sent
+  uint8_t crc:1; // frames are checked w/ crc32c instead of murmur
 
 } *util_frames_t;
 
@@ -39,6 +51,16 @@ util_frames_t util_frames_new(uint8_t size);
 
 util_frames_t util_frames_free(util_frames_t frames);
 
+// check frames w/ crc32c (hardware when available) instead of murmur, both sides must agree
+util_frames_t util_frames_crc(util_frames_t frames, uint8_t crc);
+
+// switch to windowed mode with up to UTIL_FRAMES_WINDOW frames in flight and selective acks, 0 is lockstep
+// both sides must use the same mode, resets any state so set it before sending
+util_frames_t util_frames_window(util_frames_t frames, uint8_t window);
+
+// windowed only, send a xor parity frame after every group of (2, 4, 8 or 16) frames so one lost frame per group is rebuilt w/o a resend, 0 is off
+util_frames_t util_frames_fec(util_frames_t frames, uint8_t group);
+
 // turn this packet into frames and append, free's out
 util_frames_t util_frames_send(util_frames_t frames, lob_t out);
 
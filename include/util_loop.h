@@ -0,0 +1,42 @@
+#ifndef util_loop_h
+#define util_loop_h
+
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+
+#include <poll.h>
+#include "mesh.h"
+
+// most fds any one transport can report per pass
+#ifndef UTIL_LOOP_FDS
+#define UTIL_LOOP_FDS 1024
+#endif
+
+// the uniform transport interface, every net_* can be driven by any event loop through these two
+
+// fill in up to max fds w/ their interest (POLLIN/POLLOUT), lower *ms (-1 is no limit) if it needs a timer, returns how many
+typedef int (*util_loop_fds_t)(void *net, struct pollfd *fds, int max, int *ms);
+
+// service the transport, fds are the ones it reported w/ revents set (all 0 when woken by a timer), NULL on fatal error
+// set the fd of any it closed to -1 so the loop can forget it
+typedef void *(*util_loop_ready_t)(void *net, struct pollfd *fds, int count);
+
+// reference loop, epoll on linux and poll() elsewhere, sleeps until an fd is ready, a transport timer or the mesh deadline
+typedef struct util_loop_struct *util_loop_t;
+
+util_loop_t util_loop_new(mesh_t mesh);
+util_loop_t util_loop_free(util_loop_t loop);
+
+// transports register themselves w/ their own net_*_loop(), the net is only used as the arg
+util_loop_t util_loop_add(util_loop_t loop, void *net, util_loop_fds_t fds, util_loop_ready_t ready);
+util_loop_t util_loop_remove(util_loop_t loop, void *net);
+
+// one pass, waits at most ms (-1 is until something happens) and services whatever is ready, NULL on error
+util_loop_t util_loop_once(util_loop_t loop, int ms);
+
+// pass until util_loop_stop() is called (from any callback)
+util_loop_t util_loop_run(util_loop_t loop);
+util_loop_t util_loop_stop(util_loop_t loop);
+
+#endif // POSIX
+
+#endif
@@ -16,6 +16,9 @@ unsigned long util_sys_long(unsigned long x);
 void util_sys_random_init(void);
 long util_sys_random(void);
 
+// fill with the platform's best entropy, used to seed e3x_rand
+void util_sys_entropy(uint8_t *bytes, size_t len);
+
 // -1 toggles debug, 0 disable, 1 enable
 void util_sys_logging(int enabled);
 
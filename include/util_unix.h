@@ -14,6 +14,9 @@ mesh_t util_links(mesh_t mesh, char *file);
 // simple sockets simpler
 int util_sock_timeout(int sock, uint32_t ms); // blocking timeout
 
+// clear path for a unix socket listener, only removes a socket file nobody is listening on anymore, -1 if anything else is there
+int util_sock_unlink(char *path);
+
 #endif
 
 #endif
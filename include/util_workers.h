@@ -0,0 +1,28 @@
+#ifndef util_workers_h
+#define util_workers_h
+
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+
+#include "mesh.h"
+
+// handshakes waiting on a thread before new ones are dropped
+#ifndef UTIL_WORKERS_QUEUE
+#define UTIL_WORKERS_QUEUE 256
+#endif
+
+// a pool of threads doing the handshake decryption for a mesh
+typedef struct util_workers_struct *util_workers_t;
+
+// starts the threads and takes all incoming handshakes from the mesh
+util_workers_t util_workers_new(mesh_t mesh, uint8_t threads);
+util_workers_t util_workers_free(util_workers_t workers);
+
+// call from the mesh thread, finishes any decrypted handshakes, returns how many
+uint32_t util_workers_process(util_workers_t workers);
+
+// handshakes queued or being decrypted
+uint32_t util_workers_pending(util_workers_t workers);
+
+#endif // POSIX
+
+#endif // util_workers_h
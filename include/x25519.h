@@ -0,0 +1,20 @@
+#ifndef _X25519_H_
+#define _X25519_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// RFC 7748 diffie-hellman, out = scalar * point, returns 0 or 1 if the result is all zeros (low order point)
+uint8_t x25519(uint8_t out[32], const uint8_t scalar[32], const uint8_t point[32]);
+
+// out = scalar * basepoint, for making public keys
+void x25519_base(uint8_t out[32], const uint8_t scalar[32]);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* !_X25519_H_ */
@@ -20,6 +20,7 @@ chan_t chan_new(lob_t open)
   c = malloc(sizeof (struct chan_struct));
   memset(c,0,sizeof (struct chan_struct));
   c->state = CHAN_OPENING;
+  c->priority = LINK_INTERACTIVE;
   c->id = id;
   c->type = lob_get(open,"type");
 
@@ -145,7 +146,7 @@ chan_t chan_send(chan_t c, lob_t inner)
     return LOG("dropping packet, no link");
   }
 
-  link_send(c->link, e3x_exchange_send(c->link->x, inner));
+  link_queue(c->link, e3x_exchange_send(c->link->x, inner), c->priority);
 
   lob_free(inner);
 
@@ -228,3 +229,11 @@ chan_t chan_handle(chan_t c, void (*handle)(chan_t c, void *arg), void *arg)
 
   return c;
 }
+
+// bulk channels yield to interactive ones
+chan_t chan_priority(chan_t c, uint8_t priority)
+{
+  if(!c || priority >= LINK_PRIORITIES) return LOG("bad args");
+  c->priority = priority;
+  return c;
+}
@@ -20,6 +20,8 @@ uint8_t e3x_cipher_init(lob_t options)
   
   if(lob_get_cmp(options, "force", "1a") == 0) return 0;
 
+#ifndef E3X_ONLY_1a
+
   e3x_cipher_sets[CS_1c] = cs1c_init(options);
   if(e3x_cipher_sets[CS_1c]) e3x_cipher_default = e3x_cipher_sets[CS_1c];
   if(lob_get(options, "err")) return 1;
@@ -32,6 +34,11 @@ uint8_t e3x_cipher_init(lob_t options)
   if(e3x_cipher_sets[CS_3a]) e3x_cipher_default = e3x_cipher_sets[CS_3a];
   if(lob_get(options, "err")) return 1;
 
+  e3x_cipher_sets[CS_4a] = cs4a_init(options);
+  if(e3x_cipher_sets[CS_4a]) e3x_cipher_default = e3x_cipher_sets[CS_4a];
+  if(lob_get(options, "err")) return 1;
+#endif
+
   return 0;
 }
 
@@ -41,6 +48,14 @@ e3x_cipher_t e3x_cipher_set(uint8_t csid, char *str)
   
   if(!csid && str && strlen(str) == 2) util_unhex(str,2,&csid);
 
+#ifdef E3X_ONLY_1a
+  i = CS_1a;
+  if(!e3x_cipher_sets[i]) return NULL;
+  if(csid == 0x1a) return e3x_cipher_sets[i];
+  if(str && strstr(e3x_cipher_sets[i]->alg,str)) return e3x_cipher_sets[i];
+  return NULL;
+#endif
+
   for(i=0; i<CS_MAX; i++)
   {
     if(!e3x_cipher_sets[i]) continue;
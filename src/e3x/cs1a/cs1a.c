@@ -28,10 +28,21 @@ typedef struct remote_struct
   uint32_t seq;
 } *remote_t;
 
+// sliding window of recently accepted channel seqs, serial arithmetic so it survives wrapping
+#define REPLAY_WINDOW 1024
+typedef struct replay_struct
+{
+  uint32_t top, bits[REPLAY_WINDOW/32];
+  uint8_t started;
+} replay_t;
+
+static e3x_cipher_t cs = NULL; // ourselves, for the replay count
+
 typedef struct ephemeral_struct
 {
   uint8_t enckey[16], deckey[16], token[16];
   uint32_t seq;
+  replay_t replay;
 } *ephemeral_t;
 
 // these are all the locally implemented handlers defined in e3x_cipher.h
@@ -56,6 +67,25 @@ static void ephemeral_free(ephemeral_t ephemeral);
 static lob_t ephemeral_encrypt(ephemeral_t ephemeral, lob_t inner);
 static lob_t ephemeral_decrypt(ephemeral_t ephemeral, lob_t outer);
 
+// ephemeral keypairs generated ahead of time, sized by the "pool" option
+typedef struct keypair_struct
+{
+  uint8_t secret[SECRET_BYTES], key[KEY_BYTES];
+} *keypair_t;
+static keypair_t pool = NULL;
+static uint8_t pool_size = 0, pool_count = 0;
+static uint8_t pool_refill(void);
+
+// recently decompressed remote keys, only used from the mesh thread (not local_decrypt)
+#define KEY_CACHE 16
+static struct
+{
+  uint8_t comp[COMP_BYTES], key[KEY_BYTES];
+  uint32_t used;
+} key_cache[KEY_CACHE];
+static uint32_t key_cache_tick = 0;
+static void key_decompress(uint8_t *comp, uint8_t *key);
+
 
 static int RNG(uint8_t *p_dest, unsigned p_size)
 {
@@ -77,8 +107,11 @@ e3x_cipher_t cs1a_init(lob_t options)
   // which alg's we support
   ret->alg = "HS256 ES160";
 
-  // normal init stuff
+  // normal init stuff, tables are built now while we're the only thread
   uECC_set_rng(&RNG);
+#if uECC_FIXED_BASE
+  uECC_precompute(curve);
+#endif
 
   // configure our callbacks (no RNG, default to platform's)
   ret->hash = cipher_hash;
@@ -100,6 +133,15 @@ e3x_cipher_t cs1a_init(lob_t options)
   ret->ephemeral_encrypt = (lob_t (*)(void *, lob_t))ephemeral_encrypt;
   ret->ephemeral_decrypt = (lob_t (*)(void *, lob_t))ephemeral_decrypt;
 
+  cs = ret;
+
+  // optional key pool
+  if(!pool && (pool_size = (uint8_t)lob_get_uint(options,"pool")))
+  {
+    if(!(pool = malloc(pool_size * sizeof(struct keypair_struct)))) pool_size = 0;
+    else ret->refill = pool_refill;
+  }
+
   return ret;
 }
 
@@ -109,6 +151,36 @@ uint8_t *cipher_hash(uint8_t *input, size_t len, uint8_t *output)
   return output;
 }
 
+// one key per call, this runs on every mesh tick and a keygen is the most it may cost
+static uint8_t pool_refill(void)
+{
+  if(pool_count >= pool_size || !uECC_make_key(pool[pool_count].key, pool[pool_count].secret, curve)) return 0;
+  pool_count++;
+  return 1;
+}
+
+void key_decompress(uint8_t *comp, uint8_t *key)
+{
+  uint8_t i, lru = 0;
+
+  key_cache_tick++;
+  for(i=0;i<KEY_CACHE;i++)
+  {
+    if(key_cache[i].used && memcmp(key_cache[i].comp,comp,COMP_BYTES) == 0)
+    {
+      key_cache[i].used = key_cache_tick;
+      memcpy(key,key_cache[i].key,KEY_BYTES);
+      return;
+    }
+    if(key_cache[i].used < key_cache[lru].used) lru = i;
+  }
+
+  uECC_decompress(comp,key,curve);
+  memcpy(key_cache[lru].comp,comp,COMP_BYTES);
+  memcpy(key_cache[lru].key,key,KEY_BYTES);
+  key_cache[lru].used = key_cache_tick;
+}
+
 uint8_t *cipher_err(void)
 {
   return 0;
@@ -256,9 +328,17 @@ remote_t remote_new(lob_t key, uint8_t *token)
   if(!(remote = malloc(sizeof(struct remote_struct)))) return NULL;
   memset(remote,0,sizeof (struct remote_struct));
 
-  // copy in key and make ephemeral ones
-  uECC_decompress(key->body,remote->key, curve);
-  uECC_make_key(remote->ekey, remote->esecret, curve);
+  // copy in key and make ephemeral ones, from the pool if any are ready
+  key_decompress(key->body,remote->key);
+  if(pool_count)
+  {
+    pool_count--;
+    memcpy(remote->ekey,pool[pool_count].key,KEY_BYTES);
+    memcpy(remote->esecret,pool[pool_count].secret,SECRET_BYTES);
+    memset(&pool[pool_count],0,sizeof(struct keypair_struct));
+  }else{
+    uECC_make_key(remote->ekey, remote->esecret, curve);
+  }
   uECC_compress(remote->ekey, remote->ecomp, curve);
   if(token)
   {
@@ -378,7 +458,7 @@ ephemeral_t ephemeral_new(remote_t remote, lob_t outer)
   e3x_rand((uint8_t*)&(ephem->seq),4);
 
   // decompress the exchange key and get the shared secret
-  uECC_decompress(outer->body,ekey, curve);
+  key_decompress(outer->body,ekey);
   if(!uECC_shared_secret(ekey, remote->esecret, shared, curve))
   {
     ephemeral_free(ephem);
@@ -404,6 +484,34 @@ void ephemeral_free(ephemeral_t ephem)
   free(ephem);
 }
 
+// 0 if seq is new to the window, without changing it
+static uint8_t replay_check(replay_t *w, uint32_t seq)
+{
+  int32_t diff = (int32_t)(seq - w->top);
+  if(!w->started || diff > 0) return 0;
+  if(-diff >= REPLAY_WINDOW) return 1; // too old to tell
+  return (w->bits[(seq / 32) % (REPLAY_WINDOW/32)] >> (seq % 32)) & 1;
+}
+
+// only once the packet authenticated
+static void replay_update(replay_t *w, uint32_t seq)
+{
+  int32_t diff = (int32_t)(seq - w->top);
+  if(!w->started || diff >= REPLAY_WINDOW)
+  {
+    memset(w->bits,0,sizeof(w->bits));
+    w->started = 1;
+    w->top = seq;
+  }
+  // slide forward, clearing the slots being reused
+  while((int32_t)(seq - w->top) > 0)
+  {
+    w->top++;
+    w->bits[(w->top / 32) % (REPLAY_WINDOW/32)] &= ~((uint32_t)1 << (w->top % 32));
+  }
+  w->bits[(seq / 32) % (REPLAY_WINDOW/32)] |= ((uint32_t)1 << (seq % 32));
+}
+
 lob_t ephemeral_encrypt(ephemeral_t ephem, lob_t inner)
 {
   lob_t outer;
@@ -436,10 +544,19 @@ lob_t ephemeral_encrypt(ephemeral_t ephem, lob_t inner)
 lob_t ephemeral_decrypt(ephemeral_t ephem, lob_t outer)
 {
   uint8_t iv[16], hmac[32];
+  uint32_t seq;
 
   memset(iv,0,16);
   memcpy(iv,outer->body+16,4);
 
+  // drop anything already seen before doing any crypto
+  memcpy(&seq,iv,4);
+  if(replay_check(&(ephem->replay),seq))
+  {
+    if(cs) cs->replays++;
+    return LOG("replayed seq %lu",(unsigned long)seq);
+  }
+
   memcpy(hmac,ephem->deckey,16);
   memcpy(hmac+16,iv,4);
   // mac just the ciphertext
@@ -447,6 +564,7 @@ lob_t ephemeral_decrypt(ephemeral_t ephem, lob_t outer)
   fold3(hmac,hmac);
 
   if(util_ct_memcmp(hmac,outer->body+(outer->body_len-4),4) != 0) return LOG("hmac failed");
+  replay_update(&(ephem->replay),seq);
 
   // decrypt in place
   aes_128_ctr(ephem->deckey,outer->body_len-(16+4+4),iv,outer->body+16+4,outer->body+16+4);
@@ -454,3 +572,22 @@ lob_t ephemeral_decrypt(ephemeral_t ephem, lob_t outer)
   // return parse attempt
   return lob_parse(outer->body+16+4, outer->body_len-(16+4+4));
 }
+
+#ifdef E3X_ONLY_1a
+// the direct entry points, see E3X_CALL
+uint8_t *cs1a_hash(uint8_t *in, size_t len, uint8_t *out32) { return cipher_hash(in, len, out32); }
+uint8_t *cs1a_err(void) { return cipher_err(); }
+uint8_t cs1a_generate(lob_t keys, lob_t secrets) { return cipher_generate(keys, secrets); }
+void *cs1a_local_new(lob_t keys, lob_t secrets) { return local_new(keys, secrets); }
+void cs1a_local_free(void *local) { local_free(local); }
+lob_t cs1a_local_decrypt(void *local, lob_t outer) { return local_decrypt(local, outer); }
+void *cs1a_remote_new(lob_t key, uint8_t *token) { return remote_new(key, token); }
+void cs1a_remote_free(void *remote) { remote_free(remote); }
+uint8_t cs1a_remote_verify(void *remote, void *local, lob_t outer) { return remote_verify(remote, local, outer); }
+lob_t cs1a_remote_encrypt(void *remote, void *local, lob_t inner) { return remote_encrypt(remote, local, inner); }
+void *cs1a_ephemeral_new(void *remote, lob_t outer) { return ephemeral_new(remote, outer); }
+void cs1a_ephemeral_free(void *ephem) { ephemeral_free(ephem); }
+lob_t cs1a_ephemeral_encrypt(void *ephem, lob_t inner) { return ephemeral_encrypt(ephem, inner); }
+lob_t cs1a_ephemeral_decrypt(void *ephem, lob_t outer) { return ephemeral_decrypt(ephem, outer); }
+uint8_t cs1a_refill(void) { return pool_refill(); }
+#endif
@@ -0,0 +1,534 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "telehash.h"
+
+// x25519 keys with chacha20-poly1305 (64bit nonce variant) for everything, no external deps
+#define KEY_BYTES 32
+#define SECRET_BYTES 32
+#define NONCE_BYTES 8
+#define TAG_BYTES 16
+
+// undefine the void* aliases so we can define them locally
+#undef local_t
+#undef remote_t
+#undef ephemeral_t
+
+typedef struct local_struct
+{
+  uint8_t secret[SECRET_BYTES], key[KEY_BYTES];
+} *local_t;
+
+typedef struct remote_struct
+{
+  uint8_t key[KEY_BYTES];
+  uint8_t esecret[SECRET_BYTES], ekey[KEY_BYTES];
+  uint8_t open[32], auth[32]; // derived once, auth lazily since it needs our local
+  void *authed; // which local the auth secret is for
+  uint64_t seq;
+} *remote_t;
+
+// sliding window of recently accepted channel nonces, serial arithmetic so it survives wrapping
+#define REPLAY_WINDOW 1024
+typedef struct replay_struct
+{
+  uint64_t top;
+  uint32_t bits[REPLAY_WINDOW/32];
+  uint8_t started;
+} replay_t;
+
+static e3x_cipher_t cs = NULL; // ourselves, for the replay count
+
+typedef struct ephemeral_struct
+{
+  uint8_t enckey[32], deckey[32], token[16];
+  uint64_t seq;
+  replay_t replay;
+} *ephemeral_t;
+
+// these are all the locally implemented handlers defined in e3x_cipher.h
+
+static uint8_t *cipher_hash(uint8_t *input, size_t len, uint8_t *output);
+static uint8_t *cipher_err(void);
+static uint8_t cipher_generate(lob_t keys, lob_t secrets);
+
+static local_t local_new(lob_t keys, lob_t secrets);
+static void local_free(local_t local);
+static lob_t local_decrypt(local_t local, lob_t outer);
+static lob_t local_sign(local_t local, lob_t args, uint8_t *data, size_t len);
+
+static remote_t remote_new(lob_t key, uint8_t *token);
+static void remote_free(remote_t remote);
+static uint8_t remote_verify(remote_t remote, local_t local, lob_t outer);
+static lob_t remote_encrypt(remote_t remote, local_t local, lob_t inner);
+static uint8_t remote_validate(remote_t remote, lob_t args, lob_t sig, uint8_t *data, size_t len);
+
+static ephemeral_t ephemeral_new(remote_t remote, lob_t outer);
+static void ephemeral_free(ephemeral_t ephemeral);
+static lob_t ephemeral_encrypt(ephemeral_t ephemeral, lob_t inner);
+static lob_t ephemeral_decrypt(ephemeral_t ephemeral, lob_t outer);
+
+e3x_cipher_t cs4a_init(lob_t options)
+{
+  e3x_cipher_t ret = malloc(sizeof(struct e3x_cipher_struct));
+  if(!ret) return NULL;
+  memset(ret,0,sizeof (struct e3x_cipher_struct));
+
+  // identifying markers
+  ret->id = CS_4a;
+  ret->csid = 0x4a;
+  memcpy(ret->hex,"4a",3);
+
+  // which alg's we support
+  ret->alg = "HS256";
+
+  // configure our callbacks (no RNG, default to platform's)
+  ret->hash = cipher_hash;
+  ret->err = cipher_err;
+  ret->generate = cipher_generate;
+
+  // need to cast these to map our struct types to voids
+  ret->local_new = (void *(*)(lob_t, lob_t))local_new;
+  ret->local_free = (void (*)(void *))local_free;
+  ret->local_decrypt = (lob_t (*)(void *, lob_t))local_decrypt;
+  ret->local_sign = (lob_t (*)(void *, lob_t, uint8_t *, size_t))local_sign;
+  ret->remote_new = (void *(*)(lob_t, uint8_t *))remote_new;
+  ret->remote_free = (void (*)(void *))remote_free;
+  ret->remote_verify = (uint8_t (*)(void *, void *, lob_t))remote_verify;
+  ret->remote_encrypt = (lob_t (*)(void *, void *, lob_t))remote_encrypt;
+  ret->remote_validate = (uint8_t (*)(void *, lob_t, lob_t, uint8_t *, size_t))remote_validate;
+  ret->ephemeral_new = (void *(*)(void *, lob_t))ephemeral_new;
+  ret->ephemeral_free = (void (*)(void *))ephemeral_free;
+  ret->ephemeral_encrypt = (lob_t (*)(void *, lob_t))ephemeral_encrypt;
+  ret->ephemeral_decrypt = (lob_t (*)(void *, lob_t))ephemeral_decrypt;
+
+  cs = ret;
+
+  return ret;
+}
+
+uint8_t *cipher_hash(uint8_t *input, size_t len, uint8_t *output)
+{
+  sha256(input,len,output,0);
+  return output;
+}
+
+uint8_t *cipher_err(void)
+{
+  return 0;
+}
+
+// AEAD per draft-agl-tls-chacha20poly1305, the poly key is block 0 and the data starts at block 1
+// the mac is over ad || len(ad) || ciphertext || len(ciphertext), done in cache sized steps alongside the cipher
+#define AEAD_STEP 512
+
+static void aead_lens(POLY1305_CTX *ctx, uint64_t len)
+{
+  uint8_t i, le[8];
+  for(i=0;i<8;i++) le[i] = (uint8_t)(len >> (i*8));
+  poly1305_update(ctx, le, 8);
+}
+
+static void aead_start(POLY1305_CTX *ctx, uint8_t *key, uint8_t *nonce, uint8_t *ad, size_t ad_len)
+{
+  uint8_t block[64];
+  memset(block,0,64);
+  chacha20_counter(key, nonce, 0, block, block, 64);
+  poly1305_init(ctx, block);
+  memset(block,0,64);
+  poly1305_update(ctx, ad, ad_len);
+  aead_lens(ctx, ad_len);
+}
+
+static void aead_seal(uint8_t *key, uint8_t *nonce, uint8_t *ad, size_t ad_len, uint8_t *in, uint8_t *out, size_t len)
+{
+  POLY1305_CTX ctx;
+  size_t at, step;
+
+  aead_start(&ctx, key, nonce, ad, ad_len);
+  for(at=0;at<len;at+=step)
+  {
+    step = (len - at > AEAD_STEP) ? AEAD_STEP : len - at;
+    chacha20_counter(key, nonce, 1 + (at / 64), in+at, out+at, (uint32_t)step);
+    poly1305_update(&ctx, out+at, step);
+  }
+  aead_lens(&ctx, len);
+  poly1305_finish(&ctx, out+len); // tag follows the ciphertext
+}
+
+// in place, returns 0 on success and leaves the bytes untouched otherwise
+static uint8_t aead_open(uint8_t *key, uint8_t *nonce, uint8_t *ad, size_t ad_len, uint8_t *bytes, size_t len)
+{
+  POLY1305_CTX ctx;
+  uint8_t tag[TAG_BYTES];
+  size_t at, step;
+
+  aead_start(&ctx, key, nonce, ad, ad_len);
+  for(at=0;at<len;at+=step)
+  {
+    step = (len - at > AEAD_STEP) ? AEAD_STEP : len - at;
+    poly1305_update(&ctx, bytes+at, step);
+    chacha20_counter(key, nonce, 1 + (at / 64), bytes+at, bytes+at, (uint32_t)step);
+  }
+  aead_lens(&ctx, len);
+  poly1305_finish(&ctx, tag);
+
+  if(util_ct_memcmp(tag, bytes+len, TAG_BYTES) == 0) return 0;
+
+  // forged, put the ciphertext back
+  chacha20_counter(key, nonce, 1, bytes, bytes, (uint32_t)len);
+  return 1;
+}
+
+static void nonce_put(uint8_t *nonce, uint64_t seq)
+{
+  uint8_t i;
+  for(i=0;i<NONCE_BYTES;i++) nonce[i] = (uint8_t)(seq >> (i*8));
+}
+
+static uint64_t nonce_get(uint8_t *nonce)
+{
+  uint64_t seq = 0;
+  uint8_t i;
+  for(i=NONCE_BYTES;i>0;i--) seq = (seq << 8) | nonce[i-1];
+  return seq;
+}
+
+uint8_t cipher_generate(lob_t keys, lob_t secrets)
+{
+  uint8_t secret[SECRET_BYTES], key[KEY_BYTES];
+
+  e3x_rand(secret,SECRET_BYTES);
+  x25519_base(key,secret);
+  lob_set_base32(keys,"4a",key,KEY_BYTES);
+  lob_set_base32(secrets,"4a",secret,SECRET_BYTES);
+  memset(secret,0,SECRET_BYTES);
+
+  return 0;
+}
+
+local_t local_new(lob_t keys, lob_t secrets)
+{
+  local_t local = NULL;
+  lob_t key, secret;
+
+  if(!keys) keys = lob_linked(secrets); // for convenience
+  key = lob_get_base32(keys,"4a");
+  if(!key) return LOG("invalid key");
+
+  secret = lob_get_base32(secrets,"4a");
+  if(!secret)
+  {
+    lob_free(key);
+    return LOG("invalid secret");
+  }
+
+  if(key->body_len == KEY_BYTES && secret->body_len == SECRET_BYTES)
+  {
+    if((local = malloc(sizeof(struct local_struct))))
+    {
+      memset(local,0,sizeof (struct local_struct));
+
+      // copy in key/secret data
+      memcpy(local->key,key->body,KEY_BYTES);
+      memcpy(local->secret,secret->body,SECRET_BYTES);
+
+    }else{
+      LOG("OOM");
+    }
+
+  }else{
+    LOG("invalid sizes key %d=%d secret %d=%d",key->body_len,KEY_BYTES,secret->body_len,SECRET_BYTES);
+  }
+
+  lob_free(key);
+  lob_free(secret);
+
+  return local;
+}
+
+void local_free(local_t local)
+{
+  free(local);
+  return;
+}
+
+lob_t local_decrypt(local_t local, lob_t outer)
+{
+  uint8_t shared[KEY_BYTES], key[32];
+  size_t inner_len;
+  lob_t inner, tmp;
+
+//  * `KEY` - 32 bytes, the sender's ephemeral exchange public key
+//  * `NONCE` - 8 bytes, a unique value determined by the sender
+//  * `INNER` - the chacha20 encrypted inner packet ciphertext, keyed from the ephemeral/endpoint shared secret
+//  * `TAG` - 16 bytes, the poly1305 tag of KEY+NONCE and INNER
+//  * `AUTH` - 16 bytes, the poly1305 of all of the previous bytes keyed from the endpoint/endpoint shared secret
+
+  if(outer->body_len <= (KEY_BYTES+NONCE_BYTES+TAG_BYTES+TAG_BYTES)) return NULL;
+  inner_len = outer->body_len-(KEY_BYTES+NONCE_BYTES+TAG_BYTES+TAG_BYTES);
+  tmp = lob_new();
+  if(!lob_body(tmp,outer->body+KEY_BYTES+NONCE_BYTES,inner_len+TAG_BYTES)) return lob_free(tmp);
+
+  // get the shared secret to create the key for the open aead
+  if(x25519(shared, local->secret, outer->body)) return lob_free(tmp);
+  e3x_hash(shared,KEY_BYTES,key);
+  memset(shared,0,KEY_BYTES);
+
+  // decrypt the inner
+  if(aead_open(key, outer->body+KEY_BYTES, outer->body, KEY_BYTES+NONCE_BYTES, tmp->body, inner_len)) return lob_free(tmp);
+
+  // load inner packet
+  inner = lob_parse(tmp->body,inner_len);
+  lob_free(tmp);
+  return inner;
+}
+
+lob_t local_sign(local_t local, lob_t args, uint8_t *data, size_t len)
+{
+  uint8_t hash[32];
+
+  if(lob_get_cmp(args,"alg","HS256") == 0)
+  {
+    hmac_256(args->body,args->body_len,data,len,hash);
+    lob_body(args,NULL,32);
+    memcpy(args->body,hash,32);
+    return args;
+  }
+
+  return NULL;
+}
+
+remote_t remote_new(lob_t key, uint8_t *token)
+{
+  uint8_t hash[32], shared[KEY_BYTES];
+  remote_t remote;
+  if(!key || key->body_len != KEY_BYTES) return LOG("invalid key %d != %d",(key)?key->body_len:0,KEY_BYTES);
+
+  if(!(remote = malloc(sizeof(struct remote_struct)))) return NULL;
+  memset(remote,0,sizeof (struct remote_struct));
+
+  // copy in key and make ephemeral ones
+  memcpy(remote->key,key->body,KEY_BYTES);
+  e3x_rand(remote->esecret,SECRET_BYTES);
+  x25519_base(remote->ekey,remote->esecret);
+
+  // every handshake to them is keyed from the same ephemeral/endpoint secret
+  if(x25519(shared, remote->esecret, remote->key))
+  {
+    free(remote);
+    return LOG("invalid key");
+  }
+  e3x_hash(shared,KEY_BYTES,remote->open);
+  memset(shared,0,KEY_BYTES);
+  if(token)
+  {
+    cipher_hash(remote->ekey,16,hash);
+    memcpy(token,hash,16);
+  }
+
+  // generate a random seq starting point for message nonces
+  e3x_rand((uint8_t*)&(remote->seq),sizeof(remote->seq));
+
+  return remote;
+}
+
+void remote_free(remote_t remote)
+{
+  free(remote);
+}
+
+// the handshake auth key, unique per nonce and direction (sender's key then receiver's) so a mac can't be reflected back
+static uint8_t auth_key(remote_t remote, local_t local, uint8_t *nonce, uint8_t sending, uint8_t *key)
+{
+  uint8_t shared[32+KEY_BYTES+KEY_BYTES+NONCE_BYTES];
+  if(remote->authed != local)
+  {
+    if(x25519(remote->auth, local->secret, remote->key)) return 1;
+    remote->authed = local;
+  }
+  memcpy(shared,remote->auth,32);
+  memcpy(shared+32,sending ? local->key : remote->key,KEY_BYTES);
+  memcpy(shared+32+KEY_BYTES,sending ? remote->key : local->key,KEY_BYTES);
+  memcpy(shared+32+KEY_BYTES+KEY_BYTES,nonce,NONCE_BYTES);
+  e3x_hash(shared,sizeof(shared),key);
+  memset(shared,0,sizeof(shared));
+  return 0;
+}
+
+uint8_t remote_verify(remote_t remote, local_t local, lob_t outer)
+{
+  uint8_t key[32], mac[TAG_BYTES];
+
+  if(!remote || !local || !outer) return 1;
+  if(outer->head_len != 1 || outer->head[0] != 0x4a) return 2;
+  if(outer->body_len <= (KEY_BYTES+NONCE_BYTES+TAG_BYTES+TAG_BYTES)) return 2;
+
+  if(auth_key(remote, local, outer->body+KEY_BYTES, 0, key)) return 3;
+  poly1305(mac, outer->body, outer->body_len-TAG_BYTES, key);
+  if(util_ct_memcmp(mac,outer->body+(outer->body_len-TAG_BYTES),TAG_BYTES) != 0)
+  {
+    LOG("auth failed");
+    return 4;
+  }
+
+  return 0;
+}
+
+lob_t remote_encrypt(remote_t remote, local_t local, lob_t inner)
+{
+  uint8_t key[32], csid = 0x4a;
+  lob_t outer;
+  size_t inner_len;
+
+  outer = lob_new();
+  lob_head(outer,&csid,1);
+  inner_len = lob_len(inner);
+  if(!lob_body(outer,NULL,KEY_BYTES+NONCE_BYTES+inner_len+TAG_BYTES+TAG_BYTES)) return lob_free(outer);
+
+  // copy in the ephemeral public key and nonce
+  memcpy(outer->body, remote->ekey, KEY_BYTES);
+  nonce_put(outer->body+KEY_BYTES, remote->seq);
+  remote->seq++; // increment seq after every use
+
+  // encrypt the inner into the outer
+  aead_seal(remote->open, outer->body+KEY_BYTES, outer->body, KEY_BYTES+NONCE_BYTES, lob_raw(inner), outer->body+KEY_BYTES+NONCE_BYTES, inner_len);
+
+  // sign it all with the endpoint keys
+  if(auth_key(remote, local, outer->body+KEY_BYTES, 1, key)) return lob_free(outer);
+  poly1305(outer->body+(outer->body_len-TAG_BYTES), outer->body, outer->body_len-TAG_BYTES, key);
+
+  return outer;
+}
+
+uint8_t remote_validate(remote_t remote, lob_t args, lob_t sig, uint8_t *data, size_t len)
+{
+  uint8_t hash[32];
+  if(!args || !sig || !data || !len) return 1;
+
+  if(lob_get_cmp(args,"alg","HS256") == 0)
+  {
+    if(sig->body_len != 32 || !args->body_len) return 2;
+    hmac_256(args->body,args->body_len,data,len,hash);
+    return (util_ct_memcmp(sig->body,hash,32) == 0) ? 0 : 3;
+  }
+
+  return 3;
+}
+
+ephemeral_t ephemeral_new(remote_t remote, lob_t outer)
+{
+  uint8_t shared[KEY_BYTES*3], hash[32];
+  ephemeral_t ephem;
+
+  if(!remote) return NULL;
+  if(!outer || outer->body_len < KEY_BYTES) return LOG("invalid outer");
+
+  if(!(ephem = malloc(sizeof(struct ephemeral_struct)))) return NULL;
+  memset(ephem,0,sizeof (struct ephemeral_struct));
+
+  // create and copy in the exchange routing token
+  e3x_hash(outer->body,16,hash);
+  memcpy(ephem->token,hash,16);
+
+  // generate a random seq starting point for channel nonces
+  e3x_rand((uint8_t*)&(ephem->seq),sizeof(ephem->seq));
+
+  // get the shared secret of both exchange keys
+  if(x25519(shared, remote->esecret, outer->body))
+  {
+    ephemeral_free(ephem);
+    return LOG("ECDH failed");
+  }
+
+  // combine inputs to create the digest
+  memcpy(shared+KEY_BYTES,remote->ekey,KEY_BYTES);
+  memcpy(shared+KEY_BYTES*2,outer->body,KEY_BYTES);
+  e3x_hash(shared,KEY_BYTES*3,ephem->enckey);
+
+  memcpy(shared+KEY_BYTES,outer->body,KEY_BYTES);
+  memcpy(shared+KEY_BYTES*2,remote->ekey,KEY_BYTES);
+  e3x_hash(shared,KEY_BYTES*3,ephem->deckey);
+  memset(shared,0,sizeof(shared));
+
+  return ephem;
+}
+
+void ephemeral_free(ephemeral_t ephem)
+{
+  free(ephem);
+}
+
+// 0 if seq is new to the window, without changing it
+static uint8_t replay_check(replay_t *w, uint64_t seq)
+{
+  int64_t diff = (int64_t)(seq - w->top);
+  if(!w->started || diff > 0) return 0;
+  if(-diff >= REPLAY_WINDOW) return 1; // too old to tell
+  return (w->bits[(seq / 32) % (REPLAY_WINDOW/32)] >> (seq % 32)) & 1;
+}
+
+// only once the packet authenticated
+static void replay_update(replay_t *w, uint64_t seq)
+{
+  int64_t diff = (int64_t)(seq - w->top);
+  if(!w->started || diff >= REPLAY_WINDOW)
+  {
+    memset(w->bits,0,sizeof(w->bits));
+    w->started = 1;
+    w->top = seq;
+  }
+  // slide forward, clearing the slots being reused
+  while((int64_t)(seq - w->top) > 0)
+  {
+    w->top++;
+    w->bits[(w->top / 32) % (REPLAY_WINDOW/32)] &= ~((uint32_t)1 << (w->top % 32));
+  }
+  w->bits[(seq / 32) % (REPLAY_WINDOW/32)] |= ((uint32_t)1 << (seq % 32));
+}
+
+lob_t ephemeral_encrypt(ephemeral_t ephem, lob_t inner)
+{
+  lob_t outer;
+  size_t inner_len;
+
+  outer = lob_new();
+  inner_len = lob_len(inner);
+  if(!lob_body(outer,NULL,16+NONCE_BYTES+inner_len+TAG_BYTES)) return lob_free(outer);
+
+  // copy in token and nonce
+  memcpy(outer->body,ephem->token,16);
+  nonce_put(outer->body+16, ephem->seq);
+  ephem->seq++;
+
+  // token and nonce are authenticated along with the ciphertext
+  aead_seal(ephem->enckey, outer->body+16, outer->body, 16+NONCE_BYTES, lob_raw(inner), outer->body+16+NONCE_BYTES, inner_len);
+
+  return outer;
+}
+
+lob_t ephemeral_decrypt(ephemeral_t ephem, lob_t outer)
+{
+  size_t inner_len;
+  uint64_t seq;
+
+  if(!ephem || !outer || outer->body_len <= (16+NONCE_BYTES+TAG_BYTES)) return LOG("invalid outer");
+  inner_len = outer->body_len-(16+NONCE_BYTES+TAG_BYTES);
+
+  // drop anything already seen before doing any crypto
+  seq = nonce_get(outer->body+16);
+  if(replay_check(&(ephem->replay),seq))
+  {
+    if(cs) cs->replays++;
+    return LOG("replayed seq %llu",(unsigned long long)seq);
+  }
+
+  // decrypt in place
+  if(aead_open(ephem->deckey, outer->body+16, outer->body, 16+NONCE_BYTES, outer->body+16+NONCE_BYTES, inner_len)) return LOG("aead failed");
+  replay_update(&(ephem->replay),seq);
+
+  // return parse attempt
+  return lob_parse(outer->body+16+NONCE_BYTES, inner_len);
+}
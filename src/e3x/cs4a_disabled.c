@@ -0,0 +1,6 @@
+#include "telehash.h"
+
+e3x_cipher_t cs4a_init(lob_t options)
+{
+  return NULL;
+}
@@ -20,6 +20,9 @@ uint8_t e3x_init(lob_t options)
 // just check every cipher set for any error string
 uint8_t *e3x_err(void)
 {
+#ifdef E3X_ONLY_1a
+  return E3X_CALL(e3x_cipher_sets[CS_1a], err)();
+#else
   uint8_t i;
   uint8_t *err = NULL;
   for(i=0; i<CS_MAX; i++)
@@ -28,6 +31,7 @@ uint8_t *e3x_err(void)
     if(err) return err;
   }
   return err;
+#endif
 }
 
 // generate all the keypairs
@@ -47,7 +51,25 @@ lob_t e3x_generate(void)
 }
 
 
-static uint8_t (*frandom)(void) = (uint8_t (*)(void))util_sys_random;
+// let each cipher set do its idle work
+uint32_t e3x_refill(void)
+{
+#ifdef E3X_ONLY_1a
+  return E3X_CALL(e3x_cipher_sets[CS_1a], refill)();
+#else
+  uint8_t i;
+  uint32_t made = 0;
+  for(i=0; i<CS_MAX; i++)
+  {
+    if(e3x_cipher_sets[i] && e3x_cipher_sets[i]->refill) made += e3x_cipher_sets[i]->refill();
+  }
+  return made;
+#endif
+}
+
+
+// app provided byte source, otherwise the drbg below
+static uint8_t (*frandom)(void) = NULL;
 
 // set a callback for random
 void e3x_random(uint8_t (*frand)(void))
@@ -55,18 +77,101 @@ void e3x_random(uint8_t (*frand)(void))
   frandom = frand;
 }
 
+// chacha20 drbg with fast key erasure, each refill makes a new key and a buffer of output
+#define DRBG_BUF 256
+#define DRBG_RESEED (1024*1024) // bytes between mixing in fresh entropy
+
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+#include <pthread.h>
+#define DRBG_POSIX
+#define DRBG_TLS __thread
+// bumped in the child of every fork, a drbg seeded under an older count reseeds
+static volatile uint32_t _drbg_forks = 0;
+static pthread_once_t _drbg_once = PTHREAD_ONCE_INIT;
+static void drbg_child(void) { _drbg_forks++; }
+static void drbg_atfork(void) { pthread_atfork(NULL, NULL, drbg_child); }
+#define DRBG_FORKED(d) ((d)->forks != _drbg_forks)
+#define DRBG_SEEDED(d) do { pthread_once(&_drbg_once, drbg_atfork); (d)->forks = _drbg_forks; } while(0)
+#else
+#define DRBG_TLS
+#define DRBG_FORKED(d) 0
+#define DRBG_SEEDED(d)
+#endif
+
+typedef struct drbg_struct
+{
+  uint8_t key[32];
+  uint8_t buf[DRBG_BUF];
+  uint16_t at; // next unused byte in buf
+  uint32_t made; // since the last reseed
+  uint8_t seeded;
+#ifdef DRBG_POSIX
+  uint32_t forks; // _drbg_forks when last seeded
+#endif
+} drbg_t;
+
+// one per thread, so no locking
+static DRBG_TLS drbg_t _drbg;
+
+static void drbg_refill(drbg_t *d)
+{
+  uint8_t nonce[8], block[32+DRBG_BUF], fresh[32];
+  uint8_t i;
+
+  // first use, a new process after fork, or enough output to mix in more entropy
+  if(!d->seeded || DRBG_FORKED(d) || d->made >= DRBG_RESEED)
+  {
+    util_sys_entropy(fresh, 32);
+    for(i=0;i<32;i++) d->key[i] ^= fresh[i];
+    memset(fresh,0,32);
+    d->seeded = 1;
+    d->made = 0;
+    DRBG_SEEDED(d);
+  }
+
+  memset(nonce,0,8);
+  memset(block,0,sizeof(block));
+  chacha20(d->key, nonce, block, sizeof(block));
+  memcpy(d->key, block, 32);
+  memcpy(d->buf, block+32, DRBG_BUF);
+  memset(block,0,sizeof(block));
+  d->at = 0;
+  d->made += DRBG_BUF;
+}
+
 // random bytes, from a supported cipher set
 uint8_t *e3x_rand(uint8_t *bytes, size_t len)
 {
   uint8_t *x = bytes;
+  drbg_t *d = &_drbg;
+  size_t chunk;
+
   if(!bytes || !len) return bytes;
+#ifndef E3X_ONLY_1a
   if(e3x_cipher_default && e3x_cipher_default->rand) return e3x_cipher_default->rand(bytes, len);
+#endif
+
+  if(frandom)
+  {
+    while(len-- > 0)
+    {
+      *x = frandom();
+      x++;
+    }
+    return bytes;
+  }
 
-  // crypto lib didn't provide one, use platform's RNG
-  while(len-- > 0)
+  if(DRBG_FORKED(d)) d->at = DRBG_BUF;
+  while(len)
   {
-    *x = frandom();
-    x++;
+    if(!d->seeded || d->at >= DRBG_BUF) drbg_refill(d);
+    chunk = DRBG_BUF - d->at;
+    if(chunk > len) chunk = len;
+    memcpy(x, d->buf + d->at, chunk);
+    memset(d->buf + d->at, 0, chunk); // never hand out the same bytes twice
+    d->at += chunk;
+    x += chunk;
+    len -= chunk;
   }
   return bytes;
 }
@@ -81,7 +186,7 @@ uint8_t *e3x_hash(uint8_t *in, size_t len, uint8_t *out32)
     memset(out32,0,32);
     return out32;
   }
-  return e3x_cipher_default->hash(in, len, out32);
+  return E3X_CALL(e3x_cipher_default, hash)(in, len, out32);
 }
 
 
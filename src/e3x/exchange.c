@@ -17,6 +17,9 @@ e3x_exchange_t e3x_exchange_new(e3x_self_t self, uint8_t csid, lob_t key)
   if(!self || !csid || !key || !key->body_len) return LOG("bad args");
 
   // find matching csid
+#ifdef E3X_ONLY_1a
+  if(csid == 0x1a && self->locals[CS_1a]) cs = e3x_cipher_sets[CS_1a];
+#else
   for(i=0; i<CS_MAX; i++)
   {
     if(!e3x_cipher_sets[i]) continue;
@@ -25,10 +28,11 @@ e3x_exchange_t e3x_exchange_new(e3x_self_t self, uint8_t csid, lob_t key)
     cs = e3x_cipher_sets[i];
     break;
   }
+#endif
 
   if(!cs) return LOG("unsupported csid %x",csid);
-  remote = cs->remote_new(key, token);
-  if(!remote) return LOG("failed to create %x remote %s",csid,cs->err());
+  remote = E3X_CALL(cs, remote_new)(key, token);
+  if(!remote) return LOG("failed to create %x remote %s",csid,E3X_CALL(cs, err)());
 
   if(!(x = malloc(sizeof (struct e3x_exchange_struct)))) return NULL;
   memset(x,0,sizeof (struct e3x_exchange_struct));
@@ -37,6 +41,7 @@ e3x_exchange_t e3x_exchange_new(e3x_self_t self, uint8_t csid, lob_t key)
   x->remote = remote;
   x->cs = cs;
   x->self = self;
+  x->key = lob_copy(key);
   memcpy(x->token,token,16);
 
   // determine order, if we sort first, we're even
@@ -54,8 +59,9 @@ e3x_exchange_t e3x_exchange_new(e3x_self_t self, uint8_t csid, lob_t key)
 void e3x_exchange_free(e3x_exchange_t x)
 {
   if(!x) return;
-  x->cs->remote_free(x->remote);
-  x->cs->ephemeral_free(x->ephem);
+  E3X_CALL(x->cs, remote_free)(x->remote);
+  E3X_CALL(x->cs, ephemeral_free)(x->ephem);
+  lob_free(x->key);
   free(x);
 }
 
@@ -64,14 +70,14 @@ void e3x_exchange_free(e3x_exchange_t x)
 lob_t e3x_exchange_message(e3x_exchange_t x, lob_t inner)
 {
   if(!x || !inner) return LOG("bad args");
-  return x->cs->remote_encrypt(x->remote,x->self->locals[x->cs->id],inner);
+  return E3X_CALL(x->cs, remote_encrypt)(x->remote,x->self->locals[x->cs->id],inner);
 }
 
 // any handshake verify fail (lower seq), always resend handshake
 uint8_t e3x_exchange_verify(e3x_exchange_t x, lob_t outer)
 {
   if(!x || !outer) return 1;
-  return x->cs->remote_verify(x->remote,x->self->locals[x->cs->id],outer);
+  return E3X_CALL(x->cs, remote_verify)(x->remote,x->self->locals[x->cs->id],outer);
 }
 
 uint8_t e3x_exchange_validate(e3x_exchange_t x, lob_t args, lob_t sig, uint8_t *data, size_t len)
@@ -125,14 +131,26 @@ uint32_t e3x_exchange_in(e3x_exchange_t x, uint32_t at)
 // drops ephemeral state, out=0
 e3x_exchange_t e3x_exchange_down(e3x_exchange_t x)
 {
+  remote_t remote;
+  uint8_t token[16];
   if(!x) return NULL;
   x->out = 0;
   if(x->ephem)
   {
-    x->cs->ephemeral_free(x->ephem);
+    E3X_CALL(x->cs, ephemeral_free)(x->ephem);
     x->ephem = NULL;
     memset(x->eid,0,16);
     x->last = 0;
+
+    // our restarted seqs go out under a new ephemeral key so they start a new session (and replay window)
+    if((remote = E3X_CALL(x->cs, remote_new)(x->key, token)))
+    {
+      E3X_CALL(x->cs, remote_free)(x->remote);
+      x->remote = remote;
+      memcpy(x->token,token,16);
+    }else{
+      LOG("failed to make a new %x remote %s",x->csid,E3X_CALL(x->cs, err)());
+    }
   }
   return x;
 }
@@ -149,9 +167,9 @@ e3x_exchange_t e3x_exchange_sync(e3x_exchange_t x, lob_t outer)
   // if the incoming ephemeral key is different, create a new ephemeral
   if(util_ct_memcmp(outer->body,x->eid,16) != 0)
   {
-    ephem = x->cs->ephemeral_new(x->remote,outer);
-    if(!ephem) return LOG("ephemeral creation failed %s",x->cs->err());
-    x->cs->ephemeral_free(x->ephem);
+    ephem = E3X_CALL(x->cs, ephemeral_new)(x->remote,outer);
+    if(!ephem) return LOG("ephemeral creation failed %s",E3X_CALL(x->cs, err)());
+    E3X_CALL(x->cs, ephemeral_free)(x->ephem);
     x->ephem = ephem;
     memcpy(x->eid,outer->body,16);
     // reset incoming channel id validation
@@ -206,8 +224,8 @@ lob_t e3x_exchange_receive(e3x_exchange_t x, lob_t outer)
   lob_t inner;
   if(!x || !outer) return LOG("invalid args");
   if(!x->ephem) return LOG("no handshake");
-  inner = x->cs->ephemeral_decrypt(x->ephem,outer);
-  if(!inner) return LOG("decryption failed %s",x->cs->err());
+  inner = E3X_CALL(x->cs, ephemeral_decrypt)(x->ephem,outer);
+  if(!inner) return LOG("decryption failed %s",E3X_CALL(x->cs, err)());
   LOG("decrypted head %d body %d",inner->head_len,inner->body_len);
   return inner;
 }
@@ -219,8 +237,8 @@ lob_t e3x_exchange_send(e3x_exchange_t x, lob_t inner)
   if(!x || !inner) return LOG("invalid args");
   if(!x->ephem) return LOG("no handshake");
   LOG("encrypting head %d body %d",inner->head_len,inner->body_len);
-  outer = x->cs->ephemeral_encrypt(x->ephem,inner);
-  if(!outer) return LOG("encryption failed %s",x->cs->err());
+  outer = E3X_CALL(x->cs, ephemeral_encrypt)(x->ephem,inner);
+  if(!outer) return LOG("encryption failed %s",E3X_CALL(x->cs, err)());
   return outer;
 }
 
@@ -62,7 +62,7 @@ lob_t e3x_self_decrypt(e3x_self_t self, lob_t message)
   if(message->head_len != 1) return LOG("invalid message");
   cs = e3x_cipher_set(message->head[0],NULL);
   if(!cs) return LOG("no cipherset %2x",message->head[0]);
-  return cs->local_decrypt(self->locals[cs->id],message);
+  return E3X_CALL(cs, local_decrypt)(self->locals[cs->id],message);
 }
 
 // generate a signature for the data
@@ -1,10 +1,11 @@
 #include <string.h>
 #include "telehash.h"
 
-// list of active pipes and state per link
+// one outstanding ping per pipe
 typedef struct ping_struct
 {
   uint64_t at;
+  link_pipe_t pipe;
   void (*pong)(link_t link, lob_t status, void *arg);
   void *arg;
 } *ping_t;
@@ -22,6 +23,7 @@ void path_ping_handler(chan_t chan, void *arg)
     if(ping->pong)
     {
       lob_set_uint(packet,"rtt",util_since(ping->at));
+      link_pipe_rtt(chan->link, ping->pipe, lob_get_uint(packet,"rtt"));
       ping->pong(chan->link, packet, ping->arg);
       ping->pong = NULL;
     }
@@ -33,28 +35,38 @@ void path_ping_handler(chan_t chan, void *arg)
   if(chan_state(chan) == CHAN_ENDED) free(ping);
 }
 
-// send a path ping and get callback event
+// send a path ping down every pipe and get a callback event for each that answers
 link_t path_ping(link_t link, void (*pong)(link_t link, lob_t status, void *arg), void *arg)
 {
   chan_t chan;
   lob_t open;
   ping_t ping;
+  link_pipe_t pipe;
 
-  // ping tracker obj
-  if(!(ping = malloc(sizeof (struct ping_struct)))) return LOG("oom");
-  memset(ping,0,sizeof (struct ping_struct));
-  ping->pong = pong;
-  ping->arg = arg;
-  ping->at = util_at();
+  if(!link || !link->x) return LOG("bad args");
 
-  open = lob_new();
-  lob_set(open,"type","path");
-  // paths
+  for(pipe = link_pipes(link,NULL); pipe; pipe = link_pipes(link,pipe))
+  {
+    // ping tracker obj
+    if(!(ping = malloc(sizeof (struct ping_struct)))) return LOG("oom");
+    memset(ping,0,sizeof (struct ping_struct));
+    ping->pong = pong;
+    ping->arg = arg;
+    ping->pipe = pipe;
+    ping->at = util_at();
+
+    open = lob_new();
+    lob_set(open,"type","path");
+    // paths
+
+    // create new channel, set it up, then send the open on just this pipe
+    chan = link_chan(link, open);
+    chan_handle(chan, path_ping_handler, ping);
+    link_pipe_probe(link, pipe);
+    link_pipe_send(link, pipe, e3x_exchange_send(link->x, open));
+    lob_free(open);
+  }
 
-  // create new channel, set it up, then receive this open
-  chan = link_chan(link, open);
-  chan_handle(chan, path_ping_handler, ping);
-  chan_send(chan, open);
   return link;
 }
 
@@ -62,26 +74,25 @@ link_t path_ping(link_t link, void (*pong)(link_t link, lob_t status, void *arg)
 lob_t path_on_open(link_t link, lob_t open)
 {
   lob_t path, tmp;
-  pipe_t pipe;
+  link_pipe_t pipe;
   if(!link) return open;
   if(lob_get_cmp(open,"type","path")) return open;
   
   LOG("incoming path ping %s",lob_json(open));
   
   // load all incoming paths into link
-  for(tmp = path = lob_get_array(open,"paths");path;path = lob_next(path)) link_path(link,path);
+  for(tmp = path = lob_get_array(open,"paths");path;path = lob_next(path)) mesh_path(link->mesh,link,path);
   lob_freeall(tmp);
 
-  // respond on all known pipes
+  // respond on all known pipes so each can be measured
   tmp = lob_new();
   lob_set_uint(tmp,"c",lob_get_uint(open,"c"));
   for(pipe = link_pipes(link,NULL); pipe; pipe = link_pipes(link,pipe))
   {
-    if(pipe->path) lob_set_raw(tmp,"path",0,(char*)pipe->path->head,pipe->path->head_len);
-    else lob_set_raw(tmp,"path",0,"{}",0);
-    link_direct(link, lob_copy(tmp), pipe);
+    link_pipe_send(link, pipe, e3x_exchange_send(link->x, tmp));
   }
   lob_free(tmp);
+  lob_free(open);
 
   return NULL;
 }
@@ -111,6 +111,229 @@ void chacha_ivsetup (chacha_ctx *x, const u8 *iv, const u8 *counter)
 	x->input[15] = U8TO32_LITTLE(iv + 4);
 }
 
+/*
+ block-parallel kernels, each lane of a vector holds the same state word for a different block
+ 4-way for SSE2 and NEON, 8-way for AVX2 (picked at runtime), the scalar loop below does any tail
+ */
+
+static u8 chacha_level = 0, chacha_best = 0, chacha_probed = 0;
+
+#define WIDE_QUARTERROUND(a,b,c,d) \
+  a = V_ADD(a,b); d = V_ROT16(V_XOR(d,a)); \
+  c = V_ADD(c,d); b = V_ROT(V_XOR(b,c),12); \
+  a = V_ADD(a,b); d = V_ROT8(V_XOR(d,a)); \
+  c = V_ADD(c,d); b = V_ROT(V_XOR(b,c), 7);
+
+#define WIDE_ROUNDS(v) \
+  for (i = 20; i > 0; i -= 2) { \
+    WIDE_QUARTERROUND(v[0], v[4], v[8], v[12]) \
+    WIDE_QUARTERROUND(v[1], v[5], v[9], v[13]) \
+    WIDE_QUARTERROUND(v[2], v[6], v[10], v[14]) \
+    WIDE_QUARTERROUND(v[3], v[7], v[11], v[15]) \
+    WIDE_QUARTERROUND(v[0], v[5], v[10], v[15]) \
+    WIDE_QUARTERROUND(v[1], v[6], v[11], v[12]) \
+    WIDE_QUARTERROUND(v[2], v[7], v[8], v[13]) \
+    WIDE_QUARTERROUND(v[3], v[4], v[9], v[14]) \
+  }
+
+// a generic 4-way body, the V_ macros map it onto SSE2 or NEON
+#define WIDE4_BODY \
+  V s[16], v[16]; \
+  u32 lo[4], hi[4], done = 0; \
+  uint64_t ctr = ((uint64_t)x->input[13] << 32) | x->input[12]; \
+  int i, w; \
+  for (i = 0; i < 16; i++) s[i] = V_SET1(x->input[i]); \
+  while (bytes - done >= 256) { \
+    for (i = 0; i < 4; i++) { lo[i] = (u32)(ctr + i); hi[i] = (u32)((ctr + i) >> 32); } \
+    s[12] = V_LOAD4(lo); \
+    s[13] = V_LOAD4(hi); \
+    for (i = 0; i < 16; i++) v[i] = s[i]; \
+    WIDE_ROUNDS(v) \
+    for (i = 0; i < 16; i++) v[i] = V_ADD(v[i], s[i]); \
+    for (w = 0; w < 16; w += 4) V_STORE4(c + done + w*4, m + done + w*4, v[w], v[w+1], v[w+2], v[w+3]); \
+    ctr += 4; \
+    done += 256; \
+  } \
+  x->input[12] = (u32)ctr; \
+  x->input[13] = (u32)(ctr >> 32); \
+  return done;
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CHACHA_WIDE4 chacha_sse2
+
+#define V __m128i
+#define V_ADD(a,b) _mm_add_epi32(a,b)
+#define V_XOR(a,b) _mm_xor_si128(a,b)
+#define V_ROT(a,n) _mm_or_si128(_mm_slli_epi32(a,n), _mm_srli_epi32(a,32-(n)))
+#define V_ROT16(a) _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, 0xb1), 0xb1)
+#define V_ROT8(a) V_ROT(a,8)
+#define V_SET1(a) _mm_set1_epi32((int)(a))
+#define V_LOAD4(p) _mm_loadu_si128((const __m128i *)(p))
+
+// transpose four words of four blocks and xor them in, blocks are 64 bytes apart
+#define V_STORE4(out, in, a, b, c, d) do { \
+    __m128i t0 = _mm_unpacklo_epi32(a, b), t1 = _mm_unpacklo_epi32(c, d); \
+    __m128i t2 = _mm_unpackhi_epi32(a, b), t3 = _mm_unpackhi_epi32(c, d); \
+    __m128i o[4]; int k; \
+    o[0] = _mm_unpacklo_epi64(t0, t1); o[1] = _mm_unpackhi_epi64(t0, t1); \
+    o[2] = _mm_unpacklo_epi64(t2, t3); o[3] = _mm_unpackhi_epi64(t2, t3); \
+    for (k = 0; k < 4; k++) _mm_storeu_si128((__m128i *)((out) + k*64), \
+      _mm_xor_si128(o[k], _mm_loadu_si128((const __m128i *)((in) + k*64)))); \
+  } while (0)
+
+static u32 chacha_sse2(chacha_ctx *x, const u8 *m, u8 *c, u32 bytes)
+{
+  WIDE4_BODY
+}
+
+#undef V
+#undef V_ADD
+#undef V_XOR
+#undef V_ROT
+#undef V_ROT16
+#undef V_ROT8
+#undef V_SET1
+#undef V_LOAD4
+#undef V_STORE4
+
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#include <arm_neon.h>
+#define CHACHA_WIDE4 chacha_neon
+
+#define V uint32x4_t
+#define V_ADD(a,b) vaddq_u32(a,b)
+#define V_XOR(a,b) veorq_u32(a,b)
+#define V_ROT(a,n) vsriq_n_u32(vshlq_n_u32(a,n), a, 32-(n))
+#define V_ROT16(a) vreinterpretq_u32_u16(vrev32q_u16(vreinterpretq_u16_u32(a)))
+#define V_ROT8(a) V_ROT(a,8)
+#define V_SET1(a) vdupq_n_u32(a)
+#define V_LOAD4(p) vld1q_u32(p)
+
+#define V_STORE4(out, in, a, b, c, d) do { \
+    uint32x4x2_t p01 = vtrnq_u32(a, b), p23 = vtrnq_u32(c, d); \
+    uint32x4_t o[4]; int k; \
+    o[0] = vcombine_u32(vget_low_u32(p01.val[0]), vget_low_u32(p23.val[0])); \
+    o[1] = vcombine_u32(vget_low_u32(p01.val[1]), vget_low_u32(p23.val[1])); \
+    o[2] = vcombine_u32(vget_high_u32(p01.val[0]), vget_high_u32(p23.val[0])); \
+    o[3] = vcombine_u32(vget_high_u32(p01.val[1]), vget_high_u32(p23.val[1])); \
+    for (k = 0; k < 4; k++) vst1q_u8((out) + k*64, vreinterpretq_u8_u32( \
+      veorq_u32(o[k], vreinterpretq_u32_u8(vld1q_u8((in) + k*64))))); \
+  } while (0)
+
+static u32 chacha_neon(chacha_ctx *x, const u8 *m, u8 *c, u32 bytes)
+{
+  WIDE4_BODY
+}
+
+#undef V
+#undef V_ADD
+#undef V_XOR
+#undef V_ROT
+#undef V_ROT16
+#undef V_ROT8
+#undef V_SET1
+#undef V_LOAD4
+#undef V_STORE4
+
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(CHACHA_WIDE4)
+#include <immintrin.h>
+#define CHACHA_WIDE8 chacha_avx2
+
+#define V __m256i
+#define V_ADD(a,b) _mm256_add_epi32(a,b)
+#define V_XOR(a,b) _mm256_xor_si256(a,b)
+#define V_ROT(a,n) _mm256_or_si256(_mm256_slli_epi32(a,n), _mm256_srli_epi32(a,32-(n)))
+#define V_ROT16(a) _mm256_shuffle_epi8(a, rot16)
+#define V_ROT8(a) _mm256_shuffle_epi8(a, rot8)
+
+// transpose within each 128bit half like sse2, the halves are blocks 0-3 and 4-7
+#define V_T4(a, b, c, d, o) do { \
+    __m256i t0 = _mm256_unpacklo_epi32(a, b), t1 = _mm256_unpacklo_epi32(c, d); \
+    __m256i t2 = _mm256_unpackhi_epi32(a, b), t3 = _mm256_unpackhi_epi32(c, d); \
+    o[0] = _mm256_unpacklo_epi64(t0, t1); o[1] = _mm256_unpackhi_epi64(t0, t1); \
+    o[2] = _mm256_unpacklo_epi64(t2, t3); o[3] = _mm256_unpackhi_epi64(t2, t3); \
+  } while (0)
+
+#define V_XORSTORE(out, in, a) _mm256_storeu_si256((__m256i *)(out), \
+    _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i *)(in))))
+
+__attribute__((target("avx2")))
+static u32 chacha_avx2(chacha_ctx *x, const u8 *m, u8 *c, u32 bytes)
+{
+  const __m256i rot16 = _mm256_set_epi8(13,12,15,14, 9,8,11,10, 5,4,7,6, 1,0,3,2, 13,12,15,14, 9,8,11,10, 5,4,7,6, 1,0,3,2);
+  const __m256i rot8 = _mm256_set_epi8(14,13,12,15, 10,9,8,11, 6,5,4,7, 2,1,0,3, 14,13,12,15, 10,9,8,11, 6,5,4,7, 2,1,0,3);
+  V s[16], v[16], lo8[4], hi8[4];
+  u32 lo[8], hi[8], done = 0;
+  uint64_t ctr = ((uint64_t)x->input[13] << 32) | x->input[12];
+  int i, k;
+
+  for (i = 0; i < 16; i++) s[i] = _mm256_set1_epi32((int)x->input[i]);
+  while (bytes - done >= 512) {
+    for (i = 0; i < 8; i++) { lo[i] = (u32)(ctr + i); hi[i] = (u32)((ctr + i) >> 32); }
+    s[12] = _mm256_loadu_si256((const __m256i *)lo);
+    s[13] = _mm256_loadu_si256((const __m256i *)hi);
+    for (i = 0; i < 16; i++) v[i] = s[i];
+    WIDE_ROUNDS(v)
+    for (i = 0; i < 16; i++) v[i] = V_ADD(v[i], s[i]);
+
+    // words 0-7 then 8-15, each block gets 32 bytes from a pair of transposed groups
+    for (i = 0; i < 16; i += 8) {
+      V_T4(v[i], v[i+1], v[i+2], v[i+3], lo8);
+      V_T4(v[i+4], v[i+5], v[i+6], v[i+7], hi8);
+      for (k = 0; k < 4; k++) {
+        V_XORSTORE(c + done + k*64 + i*4, m + done + k*64 + i*4, _mm256_permute2x128_si256(lo8[k], hi8[k], 0x20));
+        V_XORSTORE(c + done + (k+4)*64 + i*4, m + done + (k+4)*64 + i*4, _mm256_permute2x128_si256(lo8[k], hi8[k], 0x31));
+      }
+    }
+    ctr += 8;
+    done += 512;
+  }
+  x->input[12] = (u32)ctr;
+  x->input[13] = (u32)(ctr >> 32);
+  return done;
+}
+
+#undef V
+#undef V_ADD
+#undef V_XOR
+#undef V_ROT
+#undef V_ROT16
+#undef V_ROT8
+#undef V_T4
+#undef V_XORSTORE
+
+#endif
+
+// pick the widest kernel this cpu has, once
+static void chacha_probe(void)
+{
+  if (chacha_probed) return;
+#ifdef CHACHA_WIDE4
+  chacha_best = 1;
+#endif
+#ifdef CHACHA_WIDE8
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) chacha_best = 2;
+#endif
+  chacha_level = chacha_best;
+  chacha_probed = 1;
+}
+
+static u32 chacha_wide_bytes(chacha_ctx *x, const u8 *m, u8 *c, u32 bytes)
+{
+  u32 done = 0;
+#ifdef CHACHA_WIDE8
+  if (chacha_level >= 2) done = CHACHA_WIDE8(x, m, c, bytes);
+#endif
+#ifdef CHACHA_WIDE4
+  if (chacha_level >= 1) done += CHACHA_WIDE4(x, m + done, c + done, bytes - done);
+#endif
+  return done;
+}
+
 void chacha_encrypt_bytes (chacha_ctx *x, const u8 *m, u8 *c, u32 bytes)
 {
 	u32 x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
@@ -122,6 +345,17 @@ void chacha_encrypt_bytes (chacha_ctx *x, const u8 *m, u8 *c, u32 bytes)
 	if (!bytes)
 		return;
 
+	if (!chacha_probed)
+		chacha_probe();
+	if (chacha_level && bytes >= 256) {
+		i = chacha_wide_bytes(x, m, c, bytes);
+		m += i;
+		c += i;
+		bytes -= i;
+		if (!bytes)
+			return;
+	}
+
 	j0 = x->input[0];
 	j1 = x->input[1];
 	j2 = x->input[2];
@@ -258,4 +492,26 @@ uint8_t *chacha20(uint8_t *key, uint8_t *nonce, uint8_t *bytes, uint32_t len)
   return bytes;
 }
 
+uint8_t *chacha20_counter(uint8_t *key, uint8_t *nonce, uint64_t counter, uint8_t *in, uint8_t *out, uint32_t len)
+{
+  struct chacha_ctx ctx;
+  uint8_t ctr[CHACHA_CTRLEN];
+  uint8_t i;
+  if(!len) return out;
+
+  for(i=0;i<CHACHA_CTRLEN;i++) ctr[i] = (uint8_t)(counter >> (i*8));
+  chacha_keysetup (&ctx, key, 32 * 8);
+  chacha_ivsetup (&ctx, nonce, ctr);
+
+  chacha_encrypt_bytes (&ctx, in, out, len);
+  return out;
+}
+
+uint8_t chacha20_kernel(uint8_t max)
+{
+  chacha_probe();
+  chacha_level = (max < chacha_best) ? max : chacha_best;
+  return chacha_level;
+}
+
 #undef ROTL32
@@ -0,0 +1,125 @@
+#include <string.h>
+#include "crc32c.h"
+
+// reflected castagnoli polynomial
+#define POLY 0x82f63b78
+
+static uint32_t crc_table[256];
+static uint8_t crc_level = 0, crc_best = 0, crc_probed = 0;
+
+static uint32_t crc_soft(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+  while(len--) crc = crc_table[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <nmmintrin.h>
+#define CRC_HW crc_sse42
+
+__attribute__((target("sse4.2")))
+static uint32_t crc_sse42(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+#if defined(__x86_64__)
+  uint64_t crc64 = crc, word;
+  while(len >= 8)
+  {
+    memcpy(&word, data, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+    data += 8;
+    len -= 8;
+  }
+  crc = (uint32_t)crc64;
+#endif
+  uint32_t word32;
+  while(len >= 4)
+  {
+    memcpy(&word32, data, 4);
+    crc = _mm_crc32_u32(crc, word32);
+    data += 4;
+    len -= 4;
+  }
+  while(len--) crc = _mm_crc32_u8(crc, *data++);
+  return crc;
+}
+
+static uint8_t crc_hw_probe(void)
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2") ? 1 : 0;
+}
+
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC_HW crc_armv8
+
+// only when built for a cpu that has it (-march=armv8-a+crc)
+static uint32_t crc_armv8(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+#if defined(__aarch64__)
+  uint64_t word;
+  while(len >= 8)
+  {
+    memcpy(&word, data, 8);
+    crc = __crc32cd(crc, word);
+    data += 8;
+    len -= 8;
+  }
+#endif
+  uint32_t word32;
+  while(len >= 4)
+  {
+    memcpy(&word32, data, 4);
+    crc = __crc32cw(crc, word32);
+    data += 4;
+    len -= 4;
+  }
+  while(len--) crc = __crc32cb(crc, *data++);
+  return crc;
+}
+
+static uint8_t crc_hw_probe(void)
+{
+  return 1;
+}
+
+#endif
+
+static void crc_probe(void)
+{
+  uint32_t i, j, crc;
+  if(crc_probed) return;
+  for(i = 0; i < 256; i++)
+  {
+    crc = i;
+    for(j = 0; j < 8; j++) crc = (crc & 1) ? ((crc >> 1) ^ POLY) : (crc >> 1);
+    crc_table[i] = crc;
+  }
+#ifdef CRC_HW
+  crc_best = crc_hw_probe();
+#endif
+  crc_level = crc_best;
+  crc_probed = 1;
+}
+
+uint32_t crc32c_update(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+  if(!crc_probed) crc_probe();
+  crc = ~crc;
+#ifdef CRC_HW
+  if(crc_level) return ~CRC_HW(crc, data, len);
+#endif
+  return ~crc_soft(crc, data, len);
+}
+
+uint32_t crc32c(const uint8_t *data, uint32_t len)
+{
+  return crc32c_update(0, data, len);
+}
+
+uint8_t crc32c_kernel(uint8_t max)
+{
+  crc_probe();
+  crc_level = (max < crc_best) ? max : crc_best;
+  return crc_level;
+}
@@ -86,21 +86,45 @@ size_t lob_len(lob_t p)
 }
 
 lob_t lob_parse(const uint8_t *raw, size_t len)
+{
+  uint8_t *copy;
+
+  // make sure is at least size valid
+  if(!raw || len < 2) return NULL;
+  if(!(copy = malloc(len))) return LOG("OOM");
+  memcpy(copy,raw,len);
+  return lob_adopt(copy,len);
+}
+
+lob_t lob_adopt(uint8_t *raw, size_t len)
 {
   lob_t p;
   uint16_t nlen, hlen;
   size_t jtest;
 
   // make sure is at least size valid
-  if(!raw || len < 2) return NULL;
+  if(!raw) return NULL;
+  if(len < 2)
+  {
+    free(raw);
+    return NULL;
+  }
   memcpy(&nlen,raw,2);
   hlen = util_sys_short(nlen);
-  if(hlen > len-2) return NULL;
+  if(hlen > len-2)
+  {
+    free(raw);
+    return NULL;
+  }
 
-  // copy in and update pointers
-  p = lob_new();
-  if(!(p->raw = realloc(p->raw,len))) return lob_free(p);
-  memcpy(p->raw,raw,len);
+  // take over raw and update pointers
+  if(!(p = malloc(sizeof (struct lob_struct))))
+  {
+    free(raw);
+    return LOG("OOM");
+  }
+  memset(p,0,sizeof (struct lob_struct));
+  p->raw = raw;
   p->head_len = hlen;
   p->head = p->raw+2;
   p->body_len = len-(2+p->head_len);
@@ -0,0 +1,200 @@
+#include <string.h>
+#include "poly1305.h"
+
+/*
+ based on poly1305-donna 32bit, Andrew Moon
+ Public domain.
+ */
+
+#define U8TO32(p) \
+  (((uint32_t)((p)[0])      ) | \
+   ((uint32_t)((p)[1]) <<  8) | \
+   ((uint32_t)((p)[2]) << 16) | \
+   ((uint32_t)((p)[3]) << 24))
+
+static void U32TO8(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)(v);
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+void poly1305_init(POLY1305_CTX *ctx, const uint8_t key[32])
+{
+  // r &= 0xffffffc0ffffffc0ffffffc0fffffff
+  ctx->r[0] = (U8TO32(&key[0])) & 0x3ffffff;
+  ctx->r[1] = (U8TO32(&key[3]) >> 2) & 0x3ffff03;
+  ctx->r[2] = (U8TO32(&key[6]) >> 4) & 0x3ffc0ff;
+  ctx->r[3] = (U8TO32(&key[9]) >> 6) & 0x3f03fff;
+  ctx->r[4] = (U8TO32(&key[12]) >> 8) & 0x00fffff;
+
+  memset(ctx->h,0,sizeof(ctx->h));
+
+  ctx->pad[0] = U8TO32(&key[16]);
+  ctx->pad[1] = U8TO32(&key[20]);
+  ctx->pad[2] = U8TO32(&key[24]);
+  ctx->pad[3] = U8TO32(&key[28]);
+
+  ctx->leftover = 0;
+  ctx->final = 0;
+}
+
+static void poly1305_blocks(POLY1305_CTX *ctx, const uint8_t *m, size_t bytes)
+{
+  const uint32_t hibit = (ctx->final) ? 0 : (1UL << 24); // 1 << 128
+  uint32_t r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2], r3 = ctx->r[3], r4 = ctx->r[4];
+  uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+  uint32_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2], h3 = ctx->h[3], h4 = ctx->h[4];
+  uint64_t d0, d1, d2, d3, d4;
+  uint32_t c;
+
+  while(bytes >= 16)
+  {
+    // h += m[i]
+    h0 += (U8TO32(m+0)) & 0x3ffffff;
+    h1 += (U8TO32(m+3) >> 2) & 0x3ffffff;
+    h2 += (U8TO32(m+6) >> 4) & 0x3ffffff;
+    h3 += (U8TO32(m+9) >> 6) & 0x3ffffff;
+    h4 += (U8TO32(m+12) >> 8) | hibit;
+
+    // h *= r
+    d0 = ((uint64_t)h0 * r0) + ((uint64_t)h1 * s4) + ((uint64_t)h2 * s3) + ((uint64_t)h3 * s2) + ((uint64_t)h4 * s1);
+    d1 = ((uint64_t)h0 * r1) + ((uint64_t)h1 * r0) + ((uint64_t)h2 * s4) + ((uint64_t)h3 * s3) + ((uint64_t)h4 * s2);
+    d2 = ((uint64_t)h0 * r2) + ((uint64_t)h1 * r1) + ((uint64_t)h2 * r0) + ((uint64_t)h3 * s4) + ((uint64_t)h4 * s3);
+    d3 = ((uint64_t)h0 * r3) + ((uint64_t)h1 * r2) + ((uint64_t)h2 * r1) + ((uint64_t)h3 * r0) + ((uint64_t)h4 * s4);
+    d4 = ((uint64_t)h0 * r4) + ((uint64_t)h1 * r3) + ((uint64_t)h2 * r2) + ((uint64_t)h3 * r1) + ((uint64_t)h4 * r0);
+
+    // (partial) h %= p
+    c = (uint32_t)(d0 >> 26); h0 = (uint32_t)d0 & 0x3ffffff;
+    d1 += c; c = (uint32_t)(d1 >> 26); h1 = (uint32_t)d1 & 0x3ffffff;
+    d2 += c; c = (uint32_t)(d2 >> 26); h2 = (uint32_t)d2 & 0x3ffffff;
+    d3 += c; c = (uint32_t)(d3 >> 26); h3 = (uint32_t)d3 & 0x3ffffff;
+    d4 += c; c = (uint32_t)(d4 >> 26); h4 = (uint32_t)d4 & 0x3ffffff;
+    h0 += c * 5; c = (h0 >> 26); h0 = h0 & 0x3ffffff;
+    h1 += c;
+
+    m += 16;
+    bytes -= 16;
+  }
+
+  ctx->h[0] = h0;
+  ctx->h[1] = h1;
+  ctx->h[2] = h2;
+  ctx->h[3] = h3;
+  ctx->h[4] = h4;
+}
+
+void poly1305_update(POLY1305_CTX *ctx, const uint8_t *m, size_t len)
+{
+  size_t i, want;
+
+  // handle leftover
+  if(ctx->leftover)
+  {
+    want = (16 - ctx->leftover);
+    if(want > len) want = len;
+    for(i=0;i<want;i++) ctx->buffer[ctx->leftover + i] = m[i];
+    len -= want;
+    m += want;
+    ctx->leftover += want;
+    if(ctx->leftover < 16) return;
+    poly1305_blocks(ctx, ctx->buffer, 16);
+    ctx->leftover = 0;
+  }
+
+  // process full blocks
+  if(len >= 16)
+  {
+    want = (len & ~(size_t)15);
+    poly1305_blocks(ctx, m, want);
+    m += want;
+    len -= want;
+  }
+
+  // store leftover
+  for(i=0;i<len;i++) ctx->buffer[ctx->leftover + i] = m[i];
+  ctx->leftover += len;
+}
+
+void poly1305_finish(POLY1305_CTX *ctx, uint8_t mac[16])
+{
+  uint32_t h0, h1, h2, h3, h4, c;
+  uint32_t g0, g1, g2, g3, g4;
+  uint64_t f;
+  uint32_t mask;
+
+  // process the remaining block
+  if(ctx->leftover)
+  {
+    size_t i = ctx->leftover;
+    ctx->buffer[i++] = 1;
+    for(;i<16;i++) ctx->buffer[i] = 0;
+    ctx->final = 1;
+    poly1305_blocks(ctx, ctx->buffer, 16);
+  }
+
+  // fully carry h
+  h0 = ctx->h[0];
+  h1 = ctx->h[1];
+  h2 = ctx->h[2];
+  h3 = ctx->h[3];
+  h4 = ctx->h[4];
+
+  c = h1 >> 26; h1 = h1 & 0x3ffffff;
+  h2 += c; c = h2 >> 26; h2 = h2 & 0x3ffffff;
+  h3 += c; c = h3 >> 26; h3 = h3 & 0x3ffffff;
+  h4 += c; c = h4 >> 26; h4 = h4 & 0x3ffffff;
+  h0 += c * 5; c = h0 >> 26; h0 = h0 & 0x3ffffff;
+  h1 += c;
+
+  // compute h + -p
+  g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+  g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+  g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+  g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+  g4 = h4 + c - (1UL << 26);
+
+  // select h if h < p, or h + -p if h >= p
+  mask = (g4 >> 31) - 1;
+  g0 &= mask;
+  g1 &= mask;
+  g2 &= mask;
+  g3 &= mask;
+  g4 &= mask;
+  mask = ~mask;
+  h0 = (h0 & mask) | g0;
+  h1 = (h1 & mask) | g1;
+  h2 = (h2 & mask) | g2;
+  h3 = (h3 & mask) | g3;
+  h4 = (h4 & mask) | g4;
+
+  // h = h % (2^128)
+  h0 = ((h0) | (h1 << 26));
+  h1 = ((h1 >> 6) | (h2 << 20));
+  h2 = ((h2 >> 12) | (h3 << 14));
+  h3 = ((h3 >> 18) | (h4 << 8));
+
+  // mac = (h + pad) % (2^128)
+  f = (uint64_t)h0 + ctx->pad[0]; h0 = (uint32_t)f;
+  f = (uint64_t)h1 + ctx->pad[1] + (f >> 32); h1 = (uint32_t)f;
+  f = (uint64_t)h2 + ctx->pad[2] + (f >> 32); h2 = (uint32_t)f;
+  f = (uint64_t)h3 + ctx->pad[3] + (f >> 32); h3 = (uint32_t)f;
+
+  U32TO8(mac + 0, h0);
+  U32TO8(mac + 4, h1);
+  U32TO8(mac + 8, h2);
+  U32TO8(mac + 12, h3);
+
+  // zero out the state
+  memset(ctx,0,sizeof(POLY1305_CTX));
+}
+
+uint8_t *poly1305(uint8_t mac[16], const uint8_t *m, size_t len, const uint8_t key[32])
+{
+  POLY1305_CTX ctx;
+  poly1305_init(&ctx, key);
+  poly1305_update(&ctx, m, len);
+  poly1305_finish(&ctx, mac);
+  return mac;
+}
@@ -912,6 +912,216 @@ static uECC_word_t regularize_k(const uECC_word_t * const k,
     return carry;
 }
 
+#if uECC_FIXED_BASE
+
+#include <stdlib.h>
+
+#define FIXED_WINDOWS(curve) (((curve)->num_n_bits + 3) / 4)
+#define FIXED_ENTRIES 15
+
+/* Tables built by uECC_precompute(), entry [w][d - 1] is d * 16^w * G in affine coordinates. */
+static struct {
+    uECC_Curve curve;
+    uECC_word_t *table;
+} g_fixed_base[5];
+
+/* (X1, Y1, Z1) += (x2, y2) with Z2 = 1.
+   The caller must rule out P == Q, P == -Q and P at infinity. */
+static void EccPoint_add_mixed(uECC_word_t * X1,
+                               uECC_word_t * Y1,
+                               uECC_word_t * Z1,
+                               const uECC_word_t * x2,
+                               const uECC_word_t * y2,
+                               uECC_Curve curve) {
+    uECC_word_t t1[uECC_MAX_WORDS];
+    uECC_word_t t2[uECC_MAX_WORDS];
+    uECC_word_t h[uECC_MAX_WORDS];
+    uECC_word_t r[uECC_MAX_WORDS];
+    wordcount_t num_words = curve->num_words;
+
+    uECC_vli_modSquare_fast(t1, Z1, curve);           /* t1 = z1^2 */
+    uECC_vli_modMult_fast(h, x2, t1, curve);          /* h = x2*z1^2 = u2 */
+    uECC_vli_modMult_fast(t1, t1, Z1, curve);         /* t1 = z1^3 */
+    uECC_vli_modMult_fast(r, y2, t1, curve);          /* r = y2*z1^3 = s2 */
+    uECC_vli_modSub(h, h, X1, curve->p, num_words);   /* h = u2 - x1 */
+    uECC_vli_modSub(r, r, Y1, curve->p, num_words);   /* r = s2 - y1 */
+    uECC_vli_modMult_fast(Z1, Z1, h, curve);          /* z3 = z1*h */
+    uECC_vli_modSquare_fast(t1, h, curve);            /* t1 = h^2 */
+    uECC_vli_modMult_fast(t2, t1, h, curve);          /* t2 = h^3 */
+    uECC_vli_modMult_fast(t1, t1, X1, curve);         /* t1 = x1*h^2 = v */
+    uECC_vli_modSquare_fast(X1, r, curve);            /* x3 = r^2 */
+    uECC_vli_modSub(X1, X1, t2, curve->p, num_words); /* x3 = r^2 - h^3 */
+    uECC_vli_modSub(X1, X1, t1, curve->p, num_words);
+    uECC_vli_modSub(X1, X1, t1, curve->p, num_words); /* x3 = r^2 - h^3 - 2v */
+    uECC_vli_modSub(t1, t1, X1, curve->p, num_words); /* t1 = v - x3 */
+    uECC_vli_modMult_fast(t1, t1, r, curve);          /* t1 = r*(v - x3) */
+    uECC_vli_modMult_fast(t2, t2, Y1, curve);         /* t2 = y1*h^3 */
+    uECC_vli_modSub(Y1, t1, t2, curve->p, num_words); /* y3 = r*(v - x3) - y1*h^3 */
+}
+
+/* (X1, Y1, Z1) => (x1, y1), Z1 is clobbered */
+static void EccPoint_affine(uECC_word_t * X1,
+                            uECC_word_t * Y1,
+                            uECC_word_t * Z1,
+                            uECC_Curve curve) {
+    uECC_vli_modInv(Z1, Z1, curve->p, curve->num_words);
+    apply_z(X1, Y1, Z1, curve);
+}
+
+/* Lookup only, so the tables are read-only once built and safe to share between threads. */
+static uECC_word_t *fixed_base_table(uECC_Curve curve) {
+    unsigned slot;
+    for (slot = 0; slot < sizeof(g_fixed_base) / sizeof(g_fixed_base[0]); ++slot) {
+        if (g_fixed_base[slot].curve == curve) {
+            return g_fixed_base[slot].table;
+        }
+    }
+    return 0;
+}
+
+int uECC_precompute(uECC_Curve curve) {
+    wordcount_t num_words = curve->num_words;
+    unsigned windows = FIXED_WINDOWS(curve);
+    unsigned slot, w, d;
+    uECC_word_t *table, *entry, *base;
+    uECC_word_t X[uECC_MAX_WORDS];
+    uECC_word_t Y[uECC_MAX_WORDS];
+    uECC_word_t Z[uECC_MAX_WORDS];
+
+    for (slot = 0; slot < sizeof(g_fixed_base) / sizeof(g_fixed_base[0]); ++slot) {
+        if (g_fixed_base[slot].curve == curve) {
+            return 1;
+        }
+        if (!g_fixed_base[slot].curve) {
+            break;
+        }
+    }
+    if (slot == sizeof(g_fixed_base) / sizeof(g_fixed_base[0])) {
+        return 0;
+    }
+
+    table = (uECC_word_t *)malloc(windows * FIXED_ENTRIES * 2 * num_words * sizeof(uECC_word_t));
+    if (!table) {
+        return 0;
+    }
+
+    for (w = 0; w < windows; ++w) {
+        base = table + w * FIXED_ENTRIES * 2 * num_words;
+
+        /* 16^w * G, from 2 * (8 * 16^(w-1) * G) */
+        if (w == 0) {
+            uECC_vli_set(base, curve->G, num_words * 2);
+        } else {
+            entry = base - (FIXED_ENTRIES - 7) * 2 * num_words;
+            uECC_vli_set(X, entry, num_words);
+            uECC_vli_set(Y, entry + num_words, num_words);
+            uECC_vli_clear(Z, num_words);
+            Z[0] = 1;
+            curve->double_jacobian(X, Y, Z, curve);
+            EccPoint_affine(X, Y, Z, curve);
+            uECC_vli_set(base, X, num_words);
+            uECC_vli_set(base + num_words, Y, num_words);
+        }
+
+        /* 2 * 16^w * G */
+        uECC_vli_set(X, base, num_words);
+        uECC_vli_set(Y, base + num_words, num_words);
+        uECC_vli_clear(Z, num_words);
+        Z[0] = 1;
+        curve->double_jacobian(X, Y, Z, curve);
+        EccPoint_affine(X, Y, Z, curve);
+        entry = base + 2 * num_words;
+        uECC_vli_set(entry, X, num_words);
+        uECC_vli_set(entry + num_words, Y, num_words);
+
+        /* d * 16^w * G = (d - 1) * 16^w * G + 16^w * G */
+        for (d = 3; d <= FIXED_ENTRIES; ++d) {
+            uECC_vli_set(X, entry, num_words);
+            uECC_vli_set(Y, entry + num_words, num_words);
+            uECC_vli_clear(Z, num_words);
+            Z[0] = 1;
+            EccPoint_add_mixed(X, Y, Z, base, base + num_words, curve);
+            EccPoint_affine(X, Y, Z, curve);
+            entry += 2 * num_words;
+            uECC_vli_set(entry, X, num_words);
+            uECC_vli_set(entry + num_words, Y, num_words);
+        }
+    }
+
+    g_fixed_base[slot].table = table;
+    g_fixed_base[slot].curve = curve;
+    return 1;
+}
+
+/* result = scalar * G for 0 < scalar < n, which keeps every addition away from the doubling and
+   infinity cases. The table scan, the additions and the selects do not depend on scalar bits. */
+static void EccPoint_mult_fixed(uECC_word_t * result,
+                                const uECC_word_t * scalar,
+                                const uECC_word_t * table,
+                                uECC_Curve curve) {
+    uECC_word_t X[uECC_MAX_WORDS];
+    uECC_word_t Y[uECC_MAX_WORDS];
+    uECC_word_t Z[uECC_MAX_WORDS];
+    uECC_word_t X2[uECC_MAX_WORDS];
+    uECC_word_t Y2[uECC_MAX_WORDS];
+    uECC_word_t Z2[uECC_MAX_WORDS];
+    uECC_word_t q[uECC_MAX_WORDS * 2];
+    wordcount_t num_words = curve->num_words;
+    unsigned windows = FIXED_WINDOWS(curve);
+    const uECC_word_t *entry;
+    uECC_word_t infinity = (uECC_word_t)-1;
+    uECC_word_t mask, take_sum, take_q;
+    unsigned w, d, e;
+    wordcount_t i;
+
+    uECC_vli_clear(X, num_words);
+    uECC_vli_clear(Y, num_words);
+    uECC_vli_clear(Z, num_words);
+
+    for (w = 0; w < windows; ++w) {
+        /* word sizes are multiples of 4 bits so a window never spans two words */
+        d = (unsigned)((scalar[(4 * w) >> uECC_WORD_BITS_SHIFT] >>
+                        ((4 * w) & uECC_WORD_BITS_MASK)) & 0x0F);
+
+        /* read every entry so the access pattern is the same for any digit */
+        uECC_vli_clear(q, num_words * 2);
+        entry = table + w * FIXED_ENTRIES * 2 * num_words;
+        for (e = 1; e <= FIXED_ENTRIES; ++e) {
+            mask = (uECC_word_t)0 - (uECC_word_t)(e == d);
+            for (i = 0; i < num_words * 2; ++i) {
+                q[i] |= entry[i] & mask;
+            }
+            entry += 2 * num_words;
+        }
+
+        uECC_vli_set(X2, X, num_words);
+        uECC_vli_set(Y2, Y, num_words);
+        uECC_vli_set(Z2, Z, num_words);
+        EccPoint_add_mixed(X2, Y2, Z2, q, q + num_words, curve);
+
+        /* a zero digit keeps the accumulator, the first nonzero one replaces it */
+        mask = (uECC_word_t)0 - (uECC_word_t)(d != 0);
+        take_sum = mask & ~infinity;
+        take_q = mask & infinity;
+        for (i = 0; i < num_words; ++i) {
+            X[i] = (X[i] & ~mask) | (X2[i] & take_sum) | (q[i] & take_q);
+            Y[i] = (Y[i] & ~mask) | (Y2[i] & take_sum) | (q[num_words + i] & take_q);
+            Z[i] = (Z[i] & ~mask) | (Z2[i] & take_sum) | ((uECC_word_t)(i == 0) & take_q);
+        }
+        infinity &= ~mask;
+    }
+
+    if (infinity) {
+        uECC_vli_clear(result, num_words * 2);
+        return;
+    }
+    EccPoint_affine(X, Y, Z, curve);
+    uECC_vli_set(result, X, num_words);
+    uECC_vli_set(result + num_words, Y, num_words);
+}
+
+#endif /* uECC_FIXED_BASE */
+
 static uECC_word_t EccPoint_compute_public_key(uECC_word_t *result,
                                                uECC_word_t *private,
                                                uECC_Curve curve) {
@@ -919,6 +1129,14 @@ static uECC_word_t EccPoint_compute_public_key(uECC_word_t *result,
     uECC_word_t tmp2[uECC_MAX_WORDS];
     uECC_word_t *p2[2] = {tmp1, tmp2};
     uECC_word_t carry;
+#if uECC_FIXED_BASE
+    uECC_word_t *table = fixed_base_table(curve);
+
+    if (table) {
+        EccPoint_mult_fixed(result, private, table, curve);
+        return !EccPoint_isZero(result, curve);
+    }
+#endif
 
     /* Regularize the bitcount for the private key so that attackers cannot use a side channel
        attack to learn the number of leading zeros. */
@@ -1254,8 +1472,15 @@ static int uECC_sign_with_k(const uint8_t *private_key,
         return 0;
     }
 
-    carry = regularize_k(k, tmp, s, curve);
-    EccPoint_mult(p, curve->G, k2[!carry], 0, num_n_bits + 1, curve);
+#if uECC_FIXED_BASE
+    if (fixed_base_table(curve)) {
+        EccPoint_mult_fixed(p, k, fixed_base_table(curve), curve);
+    } else
+#endif
+    {
+        carry = regularize_k(k, tmp, s, curve);
+        EccPoint_mult(p, curve->G, k2[!carry], 0, num_n_bits + 1, curve);
+    }
     if (uECC_vli_isZero(p, num_words)) {
         return 0;
     }
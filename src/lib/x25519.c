@@ -0,0 +1,403 @@
+#include <string.h>
+#include "x25519.h"
+
+// curve25519 montgomery ladder per RFC 7748, constant time
+// 64bit targets with a 128bit multiply use 5x51 bit limbs, everything else the small tweetnacl style 16x16 limbs
+
+static const uint8_t basepoint[32] = {9};
+
+#if defined(__SIZEOF_INT128__) && !defined(X25519_SMALL)
+
+typedef unsigned __int128 u128;
+typedef uint64_t fe[5];
+#define MASK51 0x7ffffffffffffULL
+
+static uint64_t load64(const uint8_t *p)
+{
+  uint64_t r = 0;
+  int i;
+  for(i=7;i>=0;i--) r = (r << 8) | p[i];
+  return r;
+}
+
+static void store64(uint8_t *p, uint64_t v)
+{
+  int i;
+  for(i=0;i<8;i++,v>>=8) p[i] = (uint8_t)v;
+}
+
+static void fe_frombytes(fe h, const uint8_t *s)
+{
+  h[0] = load64(s) & MASK51;
+  h[1] = (load64(s+6) >> 3) & MASK51;
+  h[2] = (load64(s+12) >> 6) & MASK51;
+  h[3] = (load64(s+19) >> 1) & MASK51;
+  h[4] = (load64(s+24) >> 12) & MASK51; // drops the top bit
+}
+
+static void fe_carry(fe h)
+{
+  h[1] += h[0] >> 51; h[0] &= MASK51;
+  h[2] += h[1] >> 51; h[1] &= MASK51;
+  h[3] += h[2] >> 51; h[2] &= MASK51;
+  h[4] += h[3] >> 51; h[3] &= MASK51;
+  h[0] += 19 * (h[4] >> 51); h[4] &= MASK51;
+}
+
+static void fe_tobytes(uint8_t *s, const fe f)
+{
+  fe t;
+  uint64_t q;
+  memcpy(t,f,sizeof(fe));
+  fe_carry(t);
+  fe_carry(t);
+
+  // t is now below 2^255 + small, subtract p once if it's over
+  q = (t[0] + 19) >> 51;
+  q = (t[1] + q) >> 51;
+  q = (t[2] + q) >> 51;
+  q = (t[3] + q) >> 51;
+  q = (t[4] + q) >> 51;
+  t[0] += 19 * q;
+  t[1] += t[0] >> 51; t[0] &= MASK51;
+  t[2] += t[1] >> 51; t[1] &= MASK51;
+  t[3] += t[2] >> 51; t[2] &= MASK51;
+  t[4] += t[3] >> 51; t[3] &= MASK51;
+  t[4] &= MASK51;
+
+  store64(s, t[0] | (t[1] << 51));
+  store64(s+8, (t[1] >> 13) | (t[2] << 38));
+  store64(s+16, (t[2] >> 26) | (t[3] << 25));
+  store64(s+24, (t[3] >> 39) | (t[4] << 12));
+}
+
+static void fe_add(fe h, const fe f, const fe g)
+{
+  int i;
+  for(i=0;i<5;i++) h[i] = f[i] + g[i];
+}
+
+// adds 2p first so limbs never go negative
+static void fe_sub(fe h, const fe f, const fe g)
+{
+  h[0] = (f[0] + 0xfffffffffffdaULL) - g[0];
+  h[1] = (f[1] + 0xffffffffffffeULL) - g[1];
+  h[2] = (f[2] + 0xffffffffffffeULL) - g[2];
+  h[3] = (f[3] + 0xffffffffffffeULL) - g[3];
+  h[4] = (f[4] + 0xffffffffffffeULL) - g[4];
+}
+
+static void fe_reduce(fe h, u128 r0, u128 r1, u128 r2, u128 r3, u128 r4)
+{
+  r1 += (uint64_t)(r0 >> 51); h[0] = (uint64_t)r0 & MASK51;
+  r2 += (uint64_t)(r1 >> 51); h[1] = (uint64_t)r1 & MASK51;
+  r3 += (uint64_t)(r2 >> 51); h[2] = (uint64_t)r2 & MASK51;
+  r4 += (uint64_t)(r3 >> 51); h[3] = (uint64_t)r3 & MASK51;
+  r0 = (u128)h[0] + (u128)(uint64_t)(r4 >> 51) * 19; h[4] = (uint64_t)r4 & MASK51;
+  h[1] += (uint64_t)(r0 >> 51); h[0] = (uint64_t)r0 & MASK51;
+}
+
+static void fe_mul(fe h, const fe f, const fe g)
+{
+  uint64_t g1 = 19*g[1], g2 = 19*g[2], g3 = 19*g[3], g4 = 19*g[4];
+  u128 r0, r1, r2, r3, r4;
+
+  r0 = (u128)f[0]*g[0] + (u128)f[1]*g4 + (u128)f[2]*g3 + (u128)f[3]*g2 + (u128)f[4]*g1;
+  r1 = (u128)f[0]*g[1] + (u128)f[1]*g[0] + (u128)f[2]*g4 + (u128)f[3]*g3 + (u128)f[4]*g2;
+  r2 = (u128)f[0]*g[2] + (u128)f[1]*g[1] + (u128)f[2]*g[0] + (u128)f[3]*g4 + (u128)f[4]*g3;
+  r3 = (u128)f[0]*g[3] + (u128)f[1]*g[2] + (u128)f[2]*g[1] + (u128)f[3]*g[0] + (u128)f[4]*g4;
+  r4 = (u128)f[0]*g[4] + (u128)f[1]*g[3] + (u128)f[2]*g[2] + (u128)f[3]*g[1] + (u128)f[4]*g[0];
+  fe_reduce(h, r0, r1, r2, r3, r4);
+}
+
+static void fe_sq(fe h, const fe f)
+{
+  uint64_t d0 = 2*f[0], d1 = 2*f[1], d2 = 2*f[2], d3 = 2*f[3];
+  uint64_t f3 = 19*f[3], f4 = 19*f[4];
+  u128 r0, r1, r2, r3, r4;
+
+  r0 = (u128)f[0]*f[0] + (u128)d1*f4 + (u128)d2*f3;
+  r1 = (u128)d0*f[1] + (u128)d2*f4 + (u128)f[3]*f3;
+  r2 = (u128)d0*f[2] + (u128)f[1]*f[1] + (u128)d3*f4;
+  r3 = (u128)d0*f[3] + (u128)d1*f[2] + (u128)f[4]*f4;
+  r4 = (u128)d0*f[4] + (u128)d1*f[3] + (u128)f[2]*f[2];
+  fe_reduce(h, r0, r1, r2, r3, r4);
+}
+
+static void fe_mul_small(fe h, const fe f, uint32_t n)
+{
+  fe_reduce(h, (u128)f[0]*n, (u128)f[1]*n, (u128)f[2]*n, (u128)f[3]*n, (u128)f[4]*n);
+}
+
+static void fe_cswap(fe f, fe g, uint64_t b)
+{
+  uint64_t x, mask = 0 - b;
+  int i;
+  for(i=0;i<5;i++)
+  {
+    x = mask & (f[i] ^ g[i]);
+    f[i] ^= x;
+    g[i] ^= x;
+  }
+}
+
+static void fe_sqn(fe h, const fe f, int n)
+{
+  fe_sq(h, f);
+  while(--n > 0) fe_sq(h, h);
+}
+
+// z^(p-2)
+static void fe_invert(fe out, const fe z)
+{
+  fe z2, z9, z11, z2_5_0, z2_10_0, z2_20_0, z2_50_0, z2_100_0, t;
+
+  fe_sq(z2, z);
+  fe_sqn(t, z2, 2);
+  fe_mul(z9, t, z);
+  fe_mul(z11, z9, z2);
+  fe_sq(t, z11);
+  fe_mul(z2_5_0, t, z9);
+  fe_sqn(t, z2_5_0, 5);
+  fe_mul(z2_10_0, t, z2_5_0);
+  fe_sqn(t, z2_10_0, 10);
+  fe_mul(z2_20_0, t, z2_10_0);
+  fe_sqn(t, z2_20_0, 20);
+  fe_mul(t, t, z2_20_0);
+  fe_sqn(t, t, 10);
+  fe_mul(z2_50_0, t, z2_10_0);
+  fe_sqn(t, z2_50_0, 50);
+  fe_mul(z2_100_0, t, z2_50_0);
+  fe_sqn(t, z2_100_0, 100);
+  fe_mul(t, t, z2_100_0);
+  fe_sqn(t, t, 50);
+  fe_mul(t, t, z2_50_0);
+  fe_sqn(t, t, 5);
+  fe_mul(out, t, z11);
+}
+
+static void scalarmult(uint8_t *out, const uint8_t *k, const uint8_t *u)
+{
+  fe x1, x2, z2, x3, z3, a, aa, b, bb, e, c, d, da, cb;
+  uint64_t swap = 0, bit;
+  int t;
+
+  fe_frombytes(x1, u);
+  memset(x2,0,sizeof(fe)); x2[0] = 1;
+  memset(z2,0,sizeof(fe));
+  memcpy(x3,x1,sizeof(fe));
+  memset(z3,0,sizeof(fe)); z3[0] = 1;
+
+  for(t=254;t>=0;t--)
+  {
+    bit = (k[t >> 3] >> (t & 7)) & 1;
+    swap ^= bit;
+    fe_cswap(x2, x3, swap);
+    fe_cswap(z2, z3, swap);
+    swap = bit;
+
+    fe_add(a, x2, z2);
+    fe_sq(aa, a);
+    fe_sub(b, x2, z2);
+    fe_sq(bb, b);
+    fe_sub(e, aa, bb);
+    fe_add(c, x3, z3);
+    fe_sub(d, x3, z3);
+    fe_mul(da, d, a);
+    fe_mul(cb, c, b);
+    fe_add(x3, da, cb);
+    fe_sq(x3, x3);
+    fe_sub(z3, da, cb);
+    fe_sq(z3, z3);
+    fe_mul(z3, z3, x1);
+    fe_mul(x2, aa, bb);
+    fe_mul_small(z2, e, 121665);
+    fe_add(z2, z2, aa);
+    fe_mul(z2, z2, e);
+  }
+  fe_cswap(x2, x3, swap);
+  fe_cswap(z2, z3, swap);
+
+  fe_invert(z2, z2);
+  fe_mul(x2, x2, z2);
+  fe_tobytes(out, x2);
+}
+
+#else // X25519_SMALL
+
+typedef int64_t gf[16];
+static const gf _121665 = {0xDB41,1};
+
+static void car25519(gf o)
+{
+  int i;
+  int64_t c;
+  for(i=0;i<16;i++)
+  {
+    o[i] += (1LL << 16);
+    c = o[i] >> 16;
+    o[(i+1)*(i<15)] += c-1+37*(c-1)*(i==15);
+    o[i] -= c * 65536;
+  }
+}
+
+static void sel25519(gf p, gf q, int b)
+{
+  int64_t t, c = ~(b-1);
+  int i;
+  for(i=0;i<16;i++)
+  {
+    t = c & (p[i] ^ q[i]);
+    p[i] ^= t;
+    q[i] ^= t;
+  }
+}
+
+static void pack25519(uint8_t *o, const gf n)
+{
+  int i, j, b;
+  gf m, t;
+  for(i=0;i<16;i++) t[i] = n[i];
+  car25519(t);
+  car25519(t);
+  car25519(t);
+  for(j=0;j<2;j++)
+  {
+    m[0] = t[0] - 0xffed;
+    for(i=1;i<15;i++)
+    {
+      m[i] = t[i] - 0xffff - ((m[i-1] >> 16) & 1);
+      m[i-1] &= 0xffff;
+    }
+    m[15] = t[15] - 0x7fff - ((m[14] >> 16) & 1);
+    b = (m[15] >> 16) & 1;
+    m[14] &= 0xffff;
+    sel25519(t, m, 1-b);
+  }
+  for(i=0;i<16;i++)
+  {
+    o[2*i] = t[i] & 0xff;
+    o[2*i+1] = (uint8_t)(t[i] >> 8);
+  }
+}
+
+static void unpack25519(gf o, const uint8_t *n)
+{
+  int i;
+  for(i=0;i<16;i++) o[i] = n[2*i] + ((int64_t)n[2*i+1] << 8);
+  o[15] &= 0x7fff;
+}
+
+static void A(gf o, const gf a, const gf b)
+{
+  int i;
+  for(i=0;i<16;i++) o[i] = a[i] + b[i];
+}
+
+static void Z(gf o, const gf a, const gf b)
+{
+  int i;
+  for(i=0;i<16;i++) o[i] = a[i] - b[i];
+}
+
+static void M(gf o, const gf a, const gf b)
+{
+  int64_t t[31];
+  int i, j;
+  for(i=0;i<31;i++) t[i] = 0;
+  for(i=0;i<16;i++) for(j=0;j<16;j++) t[i+j] += a[i] * b[j];
+  for(i=0;i<15;i++) t[i] += 38 * t[i+16];
+  for(i=0;i<16;i++) o[i] = t[i];
+  car25519(o);
+  car25519(o);
+}
+
+static void S(gf o, const gf a)
+{
+  M(o, a, a);
+}
+
+static void inv25519(gf o, const gf i)
+{
+  gf c;
+  int a;
+  for(a=0;a<16;a++) c[a] = i[a];
+  for(a=253;a>=0;a--)
+  {
+    S(c, c);
+    if(a != 2 && a != 4) M(c, c, i);
+  }
+  for(a=0;a<16;a++) o[a] = c[a];
+}
+
+static void scalarmult(uint8_t *out, const uint8_t *k, const uint8_t *u)
+{
+  int64_t x[80], r;
+  int i;
+  gf a, b, c, d, e, f;
+
+  unpack25519(x, u);
+  for(i=0;i<16;i++)
+  {
+    b[i] = x[i];
+    d[i] = a[i] = c[i] = 0;
+  }
+  a[0] = d[0] = 1;
+  for(i=254;i>=0;--i)
+  {
+    r = (k[i >> 3] >> (i & 7)) & 1;
+    sel25519(a, b, (int)r);
+    sel25519(c, d, (int)r);
+    A(e, a, c);
+    Z(a, a, c);
+    A(c, b, d);
+    Z(b, b, d);
+    S(d, e);
+    S(f, a);
+    M(a, c, a);
+    M(c, b, e);
+    A(e, a, c);
+    Z(a, a, c);
+    S(b, a);
+    Z(c, d, f);
+    M(a, c, _121665);
+    A(a, a, d);
+    M(c, c, a);
+    M(a, d, f);
+    M(d, b, x);
+    S(b, e);
+    sel25519(a, b, (int)r);
+    sel25519(c, d, (int)r);
+  }
+  for(i=0;i<16;i++)
+  {
+    x[i+16] = a[i];
+    x[i+32] = c[i];
+  }
+  inv25519(x+32, x+32);
+  M(x+16, x+16, x+32);
+  pack25519(out, x+16);
+}
+
+#endif // X25519_SMALL
+
+uint8_t x25519(uint8_t out[32], const uint8_t scalar[32], const uint8_t point[32])
+{
+  uint8_t k[32], zero = 0;
+  int i;
+
+  memcpy(k, scalar, 32);
+  k[0] &= 248;
+  k[31] &= 127;
+  k[31] |= 64;
+  scalarmult(out, k, point);
+  memset(k, 0, 32);
+
+  for(i=0;i<32;i++) zero |= out[i];
+  return (zero == 0) ? 1 : 0;
+}
+
+void x25519_base(uint8_t out[32], const uint8_t scalar[32])
+{
+  x25519(out, scalar, basepoint);
+}
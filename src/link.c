@@ -23,6 +23,28 @@ link_t link_new(mesh_t mesh, hashname_t id)
   return link;
 }
 
+// detach every pipe and let each know with a NULL packet
+static void link_unpipe_all(link_t link)
+{
+  link_pipe_t pipe, next;
+  pipe = link->pipes;
+  link->pipes = NULL;
+  for(;pipe;pipe = next)
+  {
+    next = pipe->next;
+    pipe->send(link, NULL, pipe->arg);
+    free(pipe);
+  }
+}
+
+// drop anything queued
+static void link_drain(link_t link)
+{
+  uint8_t p;
+  for(p = 0; p < LINK_PRIORITIES; p++) link->queue[p] = lob_freeall(link->queue[p]);
+  link->queued = link->inflight = 0;
+}
+
 void link_free(link_t link)
 {
   if(!link) return;
@@ -47,8 +69,8 @@ void link_free(link_t link)
     link->x = NULL;
   }
 
-  // notify pipe w/ NULL packet
-  if(link->send_cb) link->send_cb(link, NULL, link->send_arg);
+  // notify pipes w/ NULL packet
+  link_unpipe_all(link);
 
   // go through link->chans
   chan_t c, cnext;
@@ -58,6 +80,8 @@ void link_free(link_t link)
     chan_free(c);
   }
 
+  link_drain(link);
+  lob_free(link->handshake);
   hashname_free(link->id);
   lob_free(link->key);
   free(link);
@@ -187,16 +211,198 @@ link_t link_load(link_t link, uint8_t csid, lob_t key)
 // add a delivery pipe to this link
 link_t link_pipe(link_t link, link_t (*send)(link_t link, lob_t packet, void *arg), void *arg)
 {
+  link_pipe_t pipe;
   if(!link || !send) return NULL;
 
-  if(send == link->send_cb && arg == link->send_arg) return link; // noop
-  if(link->send_cb) LOG_INFO("replacing existing pipe on link");
+  for(pipe = link->pipes;pipe;pipe = pipe->next) if(pipe->send == send && pipe->arg == arg)
+  {
+    pipe->fails = 0; // it's being used again
+    return link; // noop
+  }
 
-  link->send_cb = send;
-  link->send_arg = arg;
+  if(!(pipe = malloc(sizeof (struct link_pipe_struct)))) return LOG("OOM");
+  memset(pipe,0,sizeof (struct link_pipe_struct));
+  pipe->send = send;
+  pipe->arg = arg;
+  pipe->next = link->pipes;
+  link->pipes = pipe;
+  if(pipe->next) LOG_INFO("adding another pipe to link %s",hashname_short(link->id));
 
-  // flush handshake
-  return link_sync(link);
+  // handshake on the new pipe (a failure is counted on it), then anything waiting
+  if(!link->x)
+  {
+    LOG("no exchange to handshake yet");
+    return link;
+  }
+  link_pipe_send(link, pipe, link_handshake(link));
+  return link_flush(link);
+}
+
+link_t link_unpipe(link_t link, link_t (*send)(link_t link, lob_t packet, void *arg), void *arg)
+{
+  link_pipe_t pipe, prev = NULL;
+  if(!link || !send) return LOG("bad args");
+
+  for(pipe = link->pipes;pipe;prev = pipe,pipe = pipe->next) if(pipe->send == send && pipe->arg == arg) break;
+  if(!pipe) return NULL;
+
+  if(prev) prev->next = pipe->next;
+  else link->pipes = pipe->next;
+  free(pipe);
+  LOG_DEBUG("removed pipe from link %s",hashname_short(link->id));
+  return link;
+}
+
+link_pipe_t link_pipes(link_t link, link_pipe_t after)
+{
+  if(!link) return NULL;
+  if(!after) return link->pipes;
+  return after->next;
+}
+
+// is this pipe still on the link
+static link_pipe_t link_pipe_valid(link_t link, link_pipe_t pipe)
+{
+  link_pipe_t cur;
+  if(!link || !pipe) return NULL;
+  for(cur = link->pipes;cur;cur = cur->next) if(cur == pipe) return pipe;
+  return NULL;
+}
+
+// lower is better, unmeasured pipes get a default so they rank after fast ones
+#define LINK_PIPE_RTT 1000
+static uint32_t link_pipe_score(link_pipe_t pipe)
+{
+  uint32_t score, lost = 0;
+  if(pipe->fails >= LINK_PIPE_FAILS) return UINT32_MAX;
+  score = (pipe->rtt) ? pipe->rtt : LINK_PIPE_RTT;
+  // allow one probe to be outstanding before counting it lost
+  if(pipe->probes > pipe->replies) lost = pipe->probes - pipe->replies - 1;
+  return score * (1 + lost);
+}
+
+link_pipe_t link_pipe_best(link_t link)
+{
+  link_pipe_t pipe, best = NULL;
+  uint32_t score, low = UINT32_MAX;
+  if(!link) return NULL;
+
+  // first (newest) wins ties
+  for(pipe = link->pipes;pipe;pipe = pipe->next)
+  {
+    score = link_pipe_score(pipe);
+    if(best && score >= low) continue;
+    best = pipe;
+    low = score;
+  }
+
+  return best;
+}
+
+// rotate bulk through pipes that are within twice the best score
+static link_pipe_t link_pipe_stripe(link_t link, link_pipe_t best)
+{
+  link_pipe_t pipe;
+  uint32_t low, count = 0, pick;
+  if(!best) return NULL;
+  low = link_pipe_score(best);
+  if(low == UINT32_MAX) return best;
+
+  for(pipe = link->pipes;pipe;pipe = pipe->next) if(link_pipe_score(pipe) <= low * 2) count++;
+  pick = link->turn++ % count;
+  for(pipe = link->pipes;pipe;pipe = pipe->next) if(link_pipe_score(pipe) <= low * 2 && !pick--) return pipe;
+  return best;
+}
+
+link_t link_pipe_send(link_t link, link_pipe_t pipe, lob_t outer)
+{
+  if(!outer) return LOG_INFO("send packet missing");
+  if(!link_pipe_valid(link, pipe))
+  {
+    lob_free(outer);
+    return LOG_WARN("invalid pipe");
+  }
+
+  if(!pipe->send(link, outer, pipe->arg))
+  {
+    pipe->fails++;
+    lob_free(outer);
+    return LOG_WARN("delivery failed");
+  }
+
+  pipe->fails = 0;
+  return link;
+}
+
+// send on the best pipe, failing over to any other healthy ones
+// any pipe that isn't failing
+static link_pipe_t link_pipe_up(link_t link)
+{
+  link_pipe_t pipe;
+  for(pipe = link->pipes;pipe;pipe = pipe->next) if(pipe->fails < LINK_PIPE_FAILS) return pipe;
+  return NULL;
+}
+
+// hands outer to a pipe, the caller still owns it if this fails
+static link_t link_deliver(link_t link, lob_t outer, uint8_t priority)
+{
+  link_pipe_t pipe, best = link_pipe_best(link);
+
+  if(priority == LINK_BULK && link->stripe) best = link_pipe_stripe(link, best);
+  if(!best) return LOG_WARN("no network");
+
+  if(best->send(link, outer, best->arg))
+  {
+    best->fails = 0;
+    return link;
+  }
+  best->fails++;
+
+  for(pipe = link->pipes;pipe;pipe = pipe->next)
+  {
+    if(pipe == best || pipe->fails >= LINK_PIPE_FAILS) continue;
+    LOG_INFO("failing over to another pipe for %s",hashname_short(link->id));
+    if(pipe->send(link, outer, pipe->arg))
+    {
+      pipe->fails = 0;
+      return link;
+    }
+    pipe->fails++;
+  }
+
+  return LOG_WARN("delivery failed");
+}
+
+link_pipe_t link_pipe_probe(link_t link, link_pipe_t pipe)
+{
+  if(!link_pipe_valid(link, pipe)) return NULL;
+  // age out old history
+  if(pipe->probes >= 16)
+  {
+    pipe->probes /= 2;
+    pipe->replies /= 2;
+  }
+  pipe->probes++;
+  return pipe;
+}
+
+link_pipe_t link_pipe_rtt(link_t link, link_pipe_t pipe, uint32_t rtt)
+{
+  if(!link_pipe_valid(link, pipe)) return NULL;
+  if(pipe->replies < pipe->probes) pipe->replies++;
+  if(!rtt) rtt = 1; // zero is unmeasured
+  // smooth like tcp does, 1/8th new
+  pipe->rtt = (pipe->rtt) ? ((pipe->rtt * 7) + rtt) / 8 : rtt;
+  if(!pipe->rtt) pipe->rtt = 1;
+  pipe->fails = 0;
+  return pipe;
+}
+
+link_t link_stripe(link_t link, uint8_t stripe)
+{
+  if(!link) return NULL;
+  link->stripe = stripe ? 1 : 0;
+  return link;
 }
 
 // is the link ready/available
@@ -234,6 +440,7 @@ link_t link_receive_handshake(link_t link, lob_t inner)
     lob_free(inner);
     return LOG("handshake verification fail: %d",err);
   }
+  link->heard = 1;
 
   in = e3x_exchange_in(link->x,0);
   out = e3x_exchange_out(link->x,0);
@@ -272,13 +479,13 @@ link_t link_receive_handshake(link_t link, lob_t inner)
 
 // forward declare
 chan_t link_process_chan(chan_t c, uint32_t now);
-// process a decrypted channel packet
-link_t link_receive(link_t link, lob_t inner)
+
+// hand one decrypted packet to its channel or the open handlers, sets sweep when a channel got it
+static link_t link_receive_one(link_t link, lob_t inner, uint8_t *sweep)
 {
   chan_t c;
 
-  if(!link || !inner) return LOG("bad args");
-
+  link->heard = 1;
   LOG("<-- %d",lob_get_int(inner,"c"));
   // see if existing channel and send there
   if((c = link_chan_get(link, lob_get_int(inner,"c"))))
@@ -286,8 +493,7 @@ link_t link_receive(link_t link, lob_t inner)
     LOG("found chan");
     // consume inner
     chan_receive(c, inner);
-    // process any changes
-    link->chans = link_process_chan(link->chans, 0);
+    *sweep = 1;
     return link;
   }
 
@@ -315,22 +521,155 @@ link_t link_receive(link_t link, lob_t inner)
   return link;
 }
 
+// process a decrypted channel packet
+link_t link_receive(link_t link, lob_t inner)
+{
+  uint8_t sweep = 0;
+
+  if(!link || !inner) return LOG("bad args");
+
+  if(!link_receive_one(link, inner, &sweep)) return NULL;
+
+  // process any changes
+  if(sweep) link->chans = link_process_chan(link->chans, 0);
+  return link;
+}
+
+// process a list of decrypted channel packets
+link_t link_receive_batch(link_t link, lob_t inners)
+{
+  lob_t inner;
+  uint8_t sweep = 0;
+
+  if(!link || !inners) return LOG("bad args");
+
+  while((inner = inners))
+  {
+    inners = lob_splice(inners, inner);
+    link_receive_one(link, inner, &sweep);
+  }
+
+  // channel handlers only run once for the whole batch
+  if(sweep) link->chans = link_process_chan(link->chans, 0);
+  return link;
+}
+
 // deliver this packet
 link_t link_send(link_t link, lob_t outer)
+{
+  return link_queue(link, outer, LINK_INTERACTIVE);
+}
+
+// queue at priority and send what the window allows
+link_t link_queue(link_t link, lob_t outer, uint8_t priority)
 {
   if(!outer) return LOG_INFO("send packet missing");
-  if(!link || !link->send_cb)
+  if(!link || !link->pipes)
   {
     lob_free(outer);
     return LOG_WARN("no network");
   }
+  if(priority >= LINK_PRIORITIES) priority = LINK_BULK;
 
-  if(!link->send_cb(link, outer, link->send_arg))
+  // handshakes are small and always go out immediately
+  if(priority == LINK_HANDSHAKE)
   {
+    if(link_deliver(link, outer, priority)) return link;
     lob_free(outer);
-    return LOG_WARN("delivery failed");
+    return NULL;
   }
 
+  link->queue[priority] = lob_push(link->queue[priority], outer);
+  link->queued += lob_len(outer);
+  link_flush(link);
+  if(!link_writable(link)) link->blocked = 1;
+
+  return link;
+}
+
+// send queued in priority order while there's window space
+link_t link_flush(link_t link)
+{
+  uint8_t p, stop = 0;
+  uint32_t len;
+  lob_t outer;
+
+  if(!link) return LOG("bad args");
+  if(!link->pipes) return LOG("no network");
+
+  // pipes that finish a send synchronously link_sent() from inside it, this loop picks up from there
+  if(link->flushing) return link;
+  link->flushing = 1;
+
+  for(p = 0; p < LINK_PRIORITIES && !stop; p++) while(link->queue[p] && !stop)
+  {
+    if(link->window && link->inflight >= link->window)
+    {
+      stop = 1;
+      continue;
+    }
+    outer = lob_shift(link->queue[p]);
+    link->queue[p] = outer->next;
+    outer->next = NULL;
+    len = lob_len(outer);
+    link->queued -= len;
+
+    // counted before the send for any link_sent() in it, taken back if no pipe took it
+    if(link->window) link->inflight += len;
+    if(link_deliver(link, outer, p)) continue;
+    if(link->window) link->inflight = (len > link->inflight) ? 0 : link->inflight - len;
+
+    // every pipe is failing, it isn't going anywhere
+    if(!link_pipe_up(link))
+    {
+      lob_free(outer);
+      continue;
+    }
+
+    // stays first in line for the next flush
+    link->queue[p] = lob_unshift(link->queue[p], outer);
+    link->queued += len;
+    stop = 1;
+  }
+  link->flushing = 0;
+
+  return link;
+}
+
+uint32_t link_window(link_t link, uint32_t window)
+{
+  if(!link) return 0;
+  if(window != link->window)
+  {
+    link->window = window;
+    if(!window) link->inflight = 0; // not tracked when unlimited
+    link_flush(link);
+  }
+  return link->window;
+}
+
+// pipe says these bytes are gone
+link_t link_sent(link_t link, uint32_t len)
+{
+  if(!link) return LOG("bad args");
+  link->inflight = (len > link->inflight) ? 0 : link->inflight - len;
+  link_flush(link);
+
+  // notify once there's space again
+  if(link->blocked && link_writable(link))
+  {
+    link->blocked = 0;
+    mesh_writable(link->mesh, link);
+  }
+
+  return link;
+}
+
+link_t link_writable(link_t link)
+{
+  if(!link || !link->pipes) return NULL;
+  if(!link->window) return link;
+  if(link->inflight + link->queued >= link->window) return NULL;
   return link;
 }
 
@@ -339,6 +678,9 @@ lob_t link_handshake(link_t link)
   if(!link) return NULL;
   if(!link->x) return LOG_DEBUG("no exchange");
 
+  // same at means the same handshake, skip the key encoding and ECDH
+  if(link->handshake && link->handshake_at == link->x->out) return lob_copy(link->handshake);
+
   LOG_DEBUG("generating a new handshake in %lu out %lu",link->x->in,link->x->out);
   lob_t handshake = lob_new();
   lob_t tmp = hashname_im(link->mesh->keys, link->csid);
@@ -349,6 +691,11 @@ lob_t link_handshake(link_t link)
   tmp = handshake;
   handshake = e3x_exchange_handshake(link->x, tmp);
   lob_free(tmp);
+  if(!handshake) return NULL;
+
+  lob_free(link->handshake);
+  link->handshake = lob_copy(handshake);
+  link->handshake_at = link->x->out;
 
   return handshake;
 }
@@ -358,9 +705,9 @@ link_t link_sync(link_t link)
 {
   if(!link) return LOG("bad args");
   if(!link->x) return LOG("no exchange");
-  if(!link->send_cb) return LOG("no network");
+  if(!link->pipes) return LOG("no network");
 
-  return link_send(link, link_handshake(link));
+  return link_queue(link, link_handshake(link), LINK_HANDSHAKE);
 }
 
 // trigger a new exchange sync
@@ -397,7 +744,7 @@ chan_t link_chan(link_t link, lob_t open)
 link_t link_direct(link_t link, lob_t inner)
 {
   if(!link || !inner) return LOG("bad args");
-  if(!link->send_cb)
+  if(!link->pipes)
   {
     LOG_WARN("no network, dropping %s",lob_json(inner));
     return NULL;
@@ -409,7 +756,7 @@ link_t link_direct(link_t link, lob_t inner)
   lob_t outer = e3x_exchange_send(link->x, inner);
   lob_free(inner);
 
-  return link_send(link, outer);
+  return link_queue(link, outer, LINK_CONTROL);
 }
 
 // force link down, end channels and generate all events
@@ -435,13 +782,14 @@ link_t link_down(link_t link)
     chan_process(c, 0);
   }
 
-  // remove pipe
-  if(link->send_cb)
-  {
-    link->send_cb(link, NULL, link->send_arg); // notify jic
-    link->send_cb = NULL;
-    link->send_arg = NULL;
-  }
+  // anything queued was encrypted for the old session
+  link_drain(link);
+  link->handshake = lob_free(link->handshake);
+  link->seen = link->probed = 0;
+  link->heard = 0;
+
+  // remove pipes, notifying jic
+  link_unpipe_all(link);
 
   return NULL;
 }
@@ -456,10 +804,80 @@ chan_t link_process_chan(chan_t c, uint32_t now)
   return c;
 }
 
+// probe quiet links and take silent ones down
+static link_t link_keepalive(link_t link, uint32_t now)
+{
+  mesh_t mesh = link->mesh;
+
+  if(link->heard)
+  {
+    link->seen = now;
+    link->heard = 0;
+  }
+
+  if(!mesh->keepalive && !mesh->timeout) return link;
+  if(!link_up(link)) return link;
+
+  // start timing from the first check
+  if(!link->seen) link->seen = now;
+
+  if(mesh->timeout && now - link->seen >= mesh->timeout)
+  {
+    LOG_INFO("link %s silent for %lu, taking it down",hashname_short(link->id),now - link->seen);
+    return link_down(link);
+  }
+
+  // busy links never get probed
+  if(!mesh->keepalive || now - link->seen < mesh->keepalive) return link;
+  if(link->probed && now - link->probed < mesh->keepalive) return link;
+
+  // a new at costs the peer no ephemeral work but always gets a handshake back
+  LOG_DEBUG("keepalive probe to %s",hashname_short(link->id));
+  link->probed = now;
+  link_resync(link);
+  return link;
+}
+
+// the earlier of two deadlines where 0 is none
+#define DEADLINE(a,b) ((!(a) || ((b) && (b) < (a))) ? (b) : (a))
+
+uint32_t link_deadline(link_t link, uint32_t now)
+{
+  mesh_t mesh;
+  chan_t c;
+  uint32_t at = 0, probe;
+  if(!link || !now) return 0;
+  mesh = link->mesh;
+
+  // flagged to remove or needs seen stamped
+  if(!link->csid || link->heard) return now;
+
+  // chan_process errors once now passes the timeout
+  for(c = link->chans; c; c = chan_next(c))
+  {
+    if(c->state == CHAN_ENDED) return now;
+    if(c->timeout) at = DEADLINE(at, c->timeout + 1);
+  }
+
+  if(!link_up(link) || (!mesh->keepalive && !mesh->timeout)) return (at && at < now) ? now : at;
+  if(!link->seen) return now;
+
+  if(mesh->timeout) at = DEADLINE(at, link->seen + mesh->timeout);
+  if(mesh->keepalive)
+  {
+    probe = link->seen + mesh->keepalive;
+    if(link->probed && link->probed + mesh->keepalive > probe) probe = link->probed + mesh->keepalive;
+    at = DEADLINE(at, probe);
+  }
+
+  return (at && at < now) ? now : at;
+}
+
 // process any channel timeouts based on the current/given time
 link_t link_process(link_t link, uint32_t now)
 {
   if(!link || !now) return LOG("bad args");
+  link_keepalive(link, now);
   link->chans = link_process_chan(link->chans, now);
   if(link->csid) return link;
 
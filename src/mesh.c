@@ -14,12 +14,76 @@ typedef struct on_struct
   link_t (*path)(link_t link, lob_t path); // convert path->pipe
   lob_t (*open)(link_t link, lob_t open); // incoming channel requests
   link_t (*discover)(mesh_t mesh, lob_t discovered); // incoming unknown hashnames
+  void (*writable)(link_t link); // link send window opened
+  lob_t (*handshake)(mesh_t mesh, lob_t outer); // encrypted handshakes, NULL when taken
   
   struct on_struct *next;
 } *on_t;
 on_t on_get(mesh_t mesh, char *id);
 on_t on_free(on_t on);
 
+// a handshake body (key + intermediates) we've already hashed
+typedef struct seen_struct
+{
+  uint8_t *raw; // copy of the handshake body
+  size_t len;
+  size_t key_at; // where the key body starts in raw
+  uint8_t csid;
+  uint8_t hashname[32];
+  uint32_t used;
+} *seen_t;
+
+typedef struct seen_cache_struct
+{
+  struct seen_struct entries[MESH_KEY_CACHE ? MESH_KEY_CACHE : 1];
+  uint32_t tick;
+} *seen_cache_t;
+
+static void seen_free(mesh_t mesh)
+{
+  seen_cache_t cache = (seen_cache_t)mesh->keys_seen;
+  uint32_t i;
+  if(!cache) return;
+  for(i=0;i<MESH_KEY_CACHE;i++) if(cache->entries[i].raw) free(cache->entries[i].raw);
+  free(cache);
+  mesh->keys_seen = NULL;
+}
+
+// find this handshake body, or the slot to replace with it
+static seen_t seen_get(mesh_t mesh, uint8_t csid, lob_t handshake, uint8_t *hit)
+{
+  seen_cache_t cache;
+  seen_t lru = NULL;
+  uint32_t i;
+
+  *hit = 0;
+  if(!MESH_KEY_CACHE) return NULL;
+  if(!mesh->keys_seen)
+  {
+    if(!(mesh->keys_seen = malloc(sizeof (struct seen_cache_struct)))) return NULL;
+    memset(mesh->keys_seen,0,sizeof (struct seen_cache_struct));
+  }
+  cache = (seen_cache_t)mesh->keys_seen;
+  cache->tick++;
+
+  for(i=0;i<MESH_KEY_CACHE;i++)
+  {
+    seen_t seen = &(cache->entries[i]);
+    if(seen->raw && seen->csid == csid && seen->len == handshake->body_len && memcmp(seen->raw,handshake->body,seen->len) == 0)
+    {
+      seen->used = cache->tick;
+      *hit = 1;
+      return seen;
+    }
+    if(!lru || seen->used < lru->used) lru = seen;
+  }
+
+  if(lru->raw) free(lru->raw);
+  memset(lru,0,sizeof (struct seen_struct));
+  lru->used = cache->tick;
+  return lru;
+}
+
 mesh_t mesh_new(void)
 {
   mesh_t mesh;
@@ -58,6 +122,8 @@ mesh_t mesh_free(mesh_t mesh)
     free(on);
   }
 
+  if(mesh->admission) free(mesh->admission);
+  seen_free(mesh);
   lob_free(mesh->keys);
   lob_free(mesh->paths);
   hashname_free(mesh->id);
@@ -142,10 +208,190 @@ mesh_t mesh_process(mesh_t mesh, uint32_t now)
     next = link->next;
     link_process(link, now);
   }
+  if(mesh->admission) mesh->admission->now = now;
+
+  // idle time, have ephemeral keys ready for the next handshakes
+  e3x_refill();
   
   return mesh;
 }
 
+uint32_t mesh_deadline(mesh_t mesh, uint32_t now)
+{
+  link_t link;
+  uint32_t at = 0, next;
+  if(!mesh || !now) return 0;
+
+  // admission buckets refill from the last process time
+  if(mesh->admission) at = now + 1;
+
+  for(link = mesh->links;link;link = link->next)
+  {
+    if(!(next = link_deadline(link, now))) continue;
+    if(next == now) return now;
+    if(!at || next < at) at = next;
+  }
+
+  return at;
+}
+
+mesh_t mesh_admission(mesh_t mesh, uint32_t rate, uint32_t burst)
+{
+  if(!mesh) return LOG("bad args");
+
+  if(!rate)
+  {
+    if(mesh->admission) free(mesh->admission);
+    mesh->admission = NULL;
+    return mesh;
+  }
+
+  if(!mesh->admission)
+  {
+    if(!(mesh->admission = malloc(sizeof (struct mesh_admission_struct)))) return LOG("OOM");
+    memset(mesh->admission,0,sizeof (struct mesh_admission_struct));
+    e3x_rand(mesh->admission->secret,32);
+  }
+  mesh->admission->rate = rate;
+  mesh->admission->burst = burst ? burst : rate;
+
+  return mesh;
+}
+
+// cookie is a mac of the source for the given epoch
+static void mesh_cookie_mac(mesh_admission_t a, uint8_t *from, size_t len, uint32_t epoch, uint8_t *cookie)
+{
+  uint8_t mac[32];
+  uint8_t *buf;
+  if(!(buf = malloc(len+4))) return;
+  memcpy(buf,&epoch,4);
+  memcpy(buf+4,from,len);
+  hmac_256(a->secret,32,buf,len+4,mac);
+  free(buf);
+  memcpy(cookie,mac,16);
+}
+
+// fresh cookie for them to echo
+static lob_t mesh_challenge(mesh_admission_t a, uint8_t *from, size_t len, uint32_t epoch)
+{
+  uint8_t cookie[16];
+  lob_t challenge;
+  mesh_cookie_mac(a, from, len, epoch, cookie);
+  challenge = lob_new();
+  lob_set(challenge,"type","cookie");
+  lob_set_base32(challenge,"cookie",cookie,16);
+  a->challenged++;
+  return challenge;
+}
+
+lob_t mesh_admit(mesh_t mesh, lob_t packet, uint8_t *from, size_t len, lob_t *challenge)
+{
+  mesh_admission_t a;
+  uint32_t epoch, slot;
+  uint8_t cookie[16];
+  lob_t echo, inner;
+
+  if(challenge) *challenge = NULL;
+  if(!mesh || !packet) return NULL;
+  if(!(a = mesh->admission) || !from || !len) return packet;
+
+  // only handshakes cost us curve math, plain or wrapped in a cookie
+  if(packet->head_len != 1 && !(packet->head_len > 1 && lob_get(packet,"cookie"))) return packet;
+
+  epoch = a->now / MESH_COOKIE_EPOCH;
+  slot = murmur4(from,(uint32_t)len) % MESH_ADMISSION_BUCKETS;
+  if(!a->buckets[slot].at)
+  {
+    a->buckets[slot].tokens = a->burst;
+    a->buckets[slot].cookies = a->burst * MESH_COOKIE_SCALE;
+    a->buckets[slot].at = a->now ? a->now : 1;
+  }else if(a->now > a->buckets[slot].at){
+    a->buckets[slot].tokens += (a->now - a->buckets[slot].at) * a->rate;
+    if(a->buckets[slot].tokens > a->burst) a->buckets[slot].tokens = a->burst;
+    a->buckets[slot].cookies += (a->now - a->buckets[slot].at) * a->rate * MESH_COOKIE_SCALE;
+    if(a->buckets[slot].cookies > a->burst * MESH_COOKIE_SCALE) a->buckets[slot].cookies = a->burst * MESH_COOKIE_SCALE;
+    a->buckets[slot].at = a->now;
+  }
+
+  // an echoed cookie is cheap to check and proves they hear us at that address
+  if(packet->head_len > 1)
+  {
+    echo = lob_get_base32(packet,"cookie");
+    inner = NULL;
+    if(echo && echo->body_len == 16)
+    {
+      mesh_cookie_mac(a, from, len, epoch, cookie);
+      if(util_ct_memcmp(echo->body,cookie,16) == 0) inner = lob_parse(packet->body,packet->body_len);
+      else if(epoch){
+        mesh_cookie_mac(a, from, len, epoch-1, cookie);
+        if(util_ct_memcmp(echo->body,cookie,16) == 0) inner = lob_parse(packet->body,packet->body_len);
+      }
+    }
+    lob_free(echo);
+    lob_free(packet);
+    if(!inner || inner->head_len != 1)
+    {
+      // stale or forged, give them a current one so a sender holding an old cookie isn't locked out
+      a->dropped++;
+      lob_free(inner);
+      if(challenge) *challenge = mesh_challenge(a, from, len, epoch);
+      return LOG_DEBUG("bad cookie");
+    }
+    if(!a->buckets[slot].cookies)
+    {
+      a->dropped++;
+      lob_free(inner);
+      return LOG_DEBUG("cookied handshake over budget");
+    }
+    a->buckets[slot].cookies--;
+    a->cookied++;
+    return inner;
+  }
+
+  if(a->buckets[slot].tokens)
+  {
+    a->buckets[slot].tokens--;
+    a->admitted++;
+    return packet;
+  }
+
+  // over budget, they have to echo a cookie before we do any work
+  lob_free(packet);
+  if(!challenge)
+  {
+    a->dropped++;
+    return LOG_DEBUG("handshake over budget");
+  }
+  *challenge = mesh_challenge(a, from, len, epoch);
+  return NULL;
+}
+
+lob_t mesh_cookie(lob_t handshake, char *cookie)
+{
+  lob_t wrap;
+  if(!handshake || !cookie) return handshake;
+  wrap = lob_new();
+  lob_set(wrap,"cookie",cookie);
+  lob_body(wrap,lob_raw(handshake),lob_len(handshake));
+  lob_free(handshake);
+  return wrap;
+}
+
+size_t mesh_cookie_len(lob_t handshake, char *cookie)
+{
+  if(!handshake || !cookie) return lob_len(handshake);
+  // {"cookie":"..."} as the head and all of it as the body
+  return 2 + 13 + strlen(cookie) + lob_len(handshake);
+}
+
+mesh_t mesh_keepalive(mesh_t mesh, uint32_t keepalive, uint32_t timeout)
+{
+  if(!mesh) return LOG("bad args");
+  mesh->keepalive = keepalive;
+  mesh->timeout = timeout;
+  return mesh;
+}
+
 link_t mesh_add(mesh_t mesh, lob_t json)
 {
   link_t link;
@@ -255,6 +501,18 @@ void mesh_link(mesh_t mesh, link_t link)
   for(on = mesh->on; on; on = on->next) if(on->link) on->link(link);
 }
 
+void mesh_on_writable(mesh_t mesh, char *id, void (*writable)(link_t link))
+{
+  on_t on = on_get(mesh, id);
+  if(on) on->writable = writable;
+}
+
+void mesh_writable(mesh_t mesh, link_t link)
+{
+  on_t on;
+  for(on = mesh->on; on; on = on->next) if(on->writable) on->writable(link);
+}
+
 void mesh_on_open(mesh_t mesh, char *id, lob_t (*open)(link_t link, lob_t open))
 {
   on_t on = on_get(mesh, id);
@@ -268,6 +526,19 @@ lob_t mesh_open(mesh_t mesh, link_t link, lob_t open)
   return open;
 }
 
+void mesh_on_handshake(mesh_t mesh, char *id, lob_t (*handshake)(mesh_t mesh, lob_t outer))
+{
+  on_t on = on_get(mesh, id);
+  if(on) on->handshake = handshake;
+}
+
+lob_t mesh_handshake(mesh_t mesh, lob_t outer)
+{
+  on_t on;
+  for(on = mesh->on; outer && on; on = on->next) if(on->handshake) outer = on->handshake(mesh, outer);
+  return outer;
+}
+
 void mesh_on_discover(mesh_t mesh, char *id, link_t (*discover)(mesh_t mesh, lob_t discovered))
 {
   on_t on = on_get(mesh, id);
@@ -287,8 +558,18 @@ link_t mesh_receive_handshake(mesh_t mesh, lob_t handshake)
   uint32_t now;
   hashname_t from = NULL;
   link_t link;
+  lob_t outer;
+  char token[17] = {0};
 
   if(!mesh || !handshake) return LOG("bad args");
+
+  // decrypted ones are identified by some of the first 16 (routing token) bytes in the body
+  if(!lob_get(handshake,"id") && (outer = lob_linked(handshake)) && outer->body_len >= 10)
+  {
+    base32_encode(outer->body,10,token,17);
+    lob_set(handshake,"id",token);
+  }
+
   if(!lob_get(handshake,"id"))
   {
     LOG("bad handshake, no id: %s",lob_json(handshake));
@@ -308,7 +589,6 @@ link_t mesh_receive_handshake(mesh_t mesh, lob_t handshake)
   {
     // get the csid
     uint8_t csid = 0;
-    lob_t outer;
     if((outer = lob_linked(handshake)))
     {
       csid = outer->head[0];
@@ -324,9 +604,20 @@ link_t mesh_receive_handshake(mesh_t mesh, lob_t handshake)
     char hexid[3] = {0};
     util_hex(&csid, 1, hexid);
       
-    // get attached hashname
-    lob_t tmp = lob_parse(handshake->body, handshake->body_len);
-    from = hashname_vkey(tmp, csid);
+    // get attached hashname, repeat contacts skip the parse and hashing
+    uint8_t hit;
+    lob_t tmp = NULL;
+    seen_t seen = seen_get(mesh, csid, handshake, &hit);
+    if(hit)
+    {
+      from = hashname_vbin(seen->hashname);
+      mesh->keys_hit++;
+      LOG("cached key for %s",hashname_short(from));
+    }else{
+      mesh->keys_parsed++;
+      tmp = lob_parse(handshake->body, handshake->body_len);
+      from = hashname_vkey(tmp, csid);
+    }
     if(!from)
     {
       LOG("bad link handshake, no hashname: %s",lob_json(handshake));
@@ -334,10 +625,20 @@ link_t mesh_receive_handshake(mesh_t mesh, lob_t handshake)
       lob_free(handshake);
       return NULL;
     }
+    if(seen && !hit && (seen->raw = malloc(handshake->body_len)))
+    {
+      memcpy(seen->raw,handshake->body,handshake->body_len);
+      seen->len = handshake->body_len;
+      seen->key_at = handshake->body_len - tmp->body_len; // key body is the tail
+      seen->csid = csid;
+      memcpy(seen->hashname,hashname_bin(from),32);
+    }
     lob_set(handshake,"csid",hexid);
     lob_set(handshake,"hashname",hashname_char(from));
     lob_set_raw(handshake,hexid,2,"true",4); // intermediate format
-    lob_body(handshake, tmp->body, tmp->body_len); // re-attach as raw key
+    // re-attach as raw key
+    if(hit) lob_body(handshake, seen->raw + seen->key_at, seen->len - seen->key_at);
+    else lob_body(handshake, tmp->body, tmp->body_len);
     lob_free(tmp);
 
     // short-cut, if it's a key from an existing link, pass it on
@@ -363,7 +664,6 @@ link_t mesh_receive(mesh_t mesh, lob_t outer)
 {
   lob_t inner = NULL;
   link_t link = NULL;
-  char token[17] = {0};
   hashname_t id;
 
   if(!mesh || !outer) return LOG("bad args");
@@ -392,6 +692,9 @@ link_t mesh_receive(mesh_t mesh, lob_t outer)
   // process handshakes
   if(outer->head_len == 1)
   {
+    // anyone may take it to decrypt elsewhere, they finish with mesh_receive_handshake
+    if(!(outer = mesh_handshake(mesh, outer))) return NULL;
+
     inner = e3x_self_decrypt(mesh->self, outer);
     if(!inner)
     {
@@ -403,10 +706,6 @@ link_t mesh_receive(mesh_t mesh, lob_t outer)
     // couple the two together, inner->outer
     lob_link(inner,outer);
 
-    // set the unique id string based on some of the first 16 (routing token) bytes in the body
-    base32_encode(outer->body,10,token,17);
-    lob_set(inner,"id",token);
-
     // process the handshake
     return mesh_receive_handshake(mesh, inner);
   }
@@ -459,3 +758,66 @@ link_t mesh_receive(mesh_t mesh, lob_t outer)
 
   return link;
 }
+
+link_t mesh_receive_batch(mesh_t mesh, lob_t outers)
+{
+  lob_t outer, inner, inners = NULL, group;
+  link_t link = NULL, last = NULL;
+
+  if(!mesh) return LOG("bad args");
+
+  // decrypt all the channel packets first, anything else goes through in order
+  while((outer = outers))
+  {
+    outers = lob_splice(outers, outer);
+
+    if(outer->head_len != 0 || outer->body_len < 16)
+    {
+      if((link = mesh_receive(mesh, outer))) last = link;
+      continue;
+    }
+
+    // consecutive packets are usually from the same link
+    if(!link || !link->x || memcmp(link->x->token,outer->body,8) != 0)
+    {
+      for(link = mesh->links;link;link = link->next) if(link->x && memcmp(link->x->token,outer->body,8) == 0) break;
+    }
+
+    if(!link)
+    {
+      LOG("no link found for token %s",util_hex(outer->body,8,NULL));
+      lob_free(outer);
+      continue;
+    }
+
+    inner = e3x_exchange_receive(link->x, outer);
+    lob_free(outer);
+    if(!inner)
+    {
+      LOG("channel decryption fail for link %s %s",hashname_short(link->id),e3x_err());
+      continue;
+    }
+
+    inner->arg = link;
+    inners = lob_push(inners, inner);
+  }
+
+  // hand each link all of its packets at once, keeping their order
+  while(inners)
+  {
+    link = inners->arg;
+    group = NULL;
+    for(inner = inners;inner;inner = outer)
+    {
+      outer = inner->next;
+      if(inner->arg != link) continue;
+      inners = lob_splice(inners, inner);
+      inner->arg = NULL;
+      group = lob_push(group, inner);
+    }
+    LOG("channel batch from %s",hashname_short(link->id));
+    if(link_receive_batch(link, group)) last = link;
+  }
+
+  return last;
+}
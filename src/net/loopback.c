@@ -4,11 +4,16 @@
 link_t pair_send(link_t link, lob_t packet, void *arg)
 {
   net_loopback_t pair = (net_loopback_t)arg;
+  uint32_t len;
   if(!pair || !packet || !link) return link;
   LOG("pair pipe from %s",hashname_short(link->id));
+  len = lob_len(packet);
   if(link->mesh == pair->a) mesh_receive(pair->b,packet);
   else if(link->mesh == pair->b) mesh_receive(pair->a,packet);
   else lob_free(packet);
+
+  // delivered as soon as it's handed over, frees up any window
+  link_sent(link, len);
   return link;
 }
 
@@ -0,0 +1,791 @@
+#ifdef __linux__
+
+// memfd_create, struct ucred
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "net_shm.h"
+
+#define SHM_MAGIC 0x68736874 // "thsh"
+#define SHM_PAD 0xffffffff // rest of the ring is unused, continue at the start
+#define SHM_ALIGN(x) (((x) + 7) & ~((uint32_t)7))
+#define SHM_SEALS (F_SEAL_SHRINK|F_SEAL_GROW|F_SEAL_SEAL) // an offered memfd must have all of these
+
+// each side's index on its own cache line, the producer and consumer never write the same one
+struct shm_ring
+{
+  uint32_t head; // consumer, next byte to read
+  uint8_t pad1[60];
+  uint32_t tail; // producer, next byte to write
+  uint8_t pad2[60];
+  uint32_t sleeping; // consumer wants a doorbell for new data
+  uint32_t full; // producer wants a doorbell for space
+  uint8_t pad3[56];
+};
+
+// the memfd, followed by ring[0] data then ring[1] data
+struct shm_map
+{
+  uint32_t magic;
+  uint32_t size;
+  uint8_t pad[56];
+  struct shm_ring ring[2]; // 0 is connector to acceptor
+};
+
+// one peer
+typedef struct pipe_struct
+{
+  link_t link;
+  lob_t out; // packets the ring had no room for yet
+  net_shm_t net;
+  struct pipe_struct *next;
+  struct shm_map *map; // NULL until an accepted peer sends it
+  struct shm_ring *tx, *rx;
+  uint8_t *txd, *rxd;
+  uint32_t size;
+  char *path; // only known for ones we connected to
+  int sock; // handed over the memfd, now only watched for closing
+  int bell; // ours, rung when we have data or space
+  int peer; // theirs
+  uid_t uid; // of the process at the other end, from the kernel
+  pid_t pid;
+  char cookie[32]; // last admission cookie they challenged us with
+  uint8_t connecting:1; // their listener had no room yet, connect is retried
+  uint8_t dead:1; // closed or failed, freed on the next pass
+} *pipe_t;
+
+// overall server
+struct net_shm_struct
+{
+  mesh_t mesh;
+  pipe_t pipes;
+  char *path;
+  int server;
+  uint32_t ring; // size we offer when connecting
+  uint8_t any; // accept peers running as any user
+  uint32_t window; // link send window to apply, 0 for unlimited
+  struct net_shm_struct *next;
+};
+
+// path callbacks only get the link, find our transport from its mesh
+static net_shm_t shm_all = NULL;
+
+static size_t shm_maplen(uint32_t size)
+{
+  return sizeof(struct shm_map) + 2 * (size_t)size;
+}
+
+// ordered with the other side's loads of the same, so a doorbell is never missed
+static uint32_t shm_load(uint32_t *at)
+{
+  return __atomic_load_n(at, __ATOMIC_SEQ_CST);
+}
+
+static void shm_store(uint32_t *at, uint32_t val)
+{
+  __atomic_store_n(at, val, __ATOMIC_SEQ_CST);
+}
+
+static void shm_ring(pipe_t pipe)
+{
+  uint64_t one = 1;
+  if(write(pipe->peer, &one, sizeof(one)) < 0 && errno != EAGAIN) LOG_WARN("doorbell failed %s",strerror(errno));
+}
+
+// who's at the other end, refuse it unless it's us or root
+static int shm_trust(net_shm_t net, int sock, uid_t *uid, pid_t *pid)
+{
+  struct ucred cred;
+  socklen_t len = sizeof(cred);
+  if(getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+  {
+    LOG_WARN("no peer credentials %s",strerror(errno));
+    return 0;
+  }
+  *uid = cred.uid;
+  *pid = cred.pid;
+  if(net->any || *uid == 0 || *uid == geteuid()) return 1;
+  LOG_WARN("refusing peer uid %u pid %d",(unsigned)*uid,(int)*pid);
+  return 0;
+}
+
+// a connecting one is only trusted once it's through
+static pipe_t pipe_new(net_shm_t net, int sock, uint8_t connecting)
+{
+  pipe_t pipe;
+  if(!(pipe = malloc(sizeof (struct pipe_struct)))) return LOG("OOM");
+  memset(pipe,0,sizeof (struct pipe_struct));
+  if(!connecting && !shm_trust(net, sock, &(pipe->uid), &(pipe->pid)))
+  {
+    free(pipe);
+    return NULL;
+  }
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+  pipe->net = net;
+  pipe->sock = sock;
+  pipe->connecting = connecting;
+  pipe->bell = pipe->peer = -1;
+  pipe->next = net->pipes;
+  net->pipes = pipe;
+  return pipe;
+}
+
+static pipe_t pipe_free(pipe_t pipe)
+{
+  pipe_t *at;
+  if(!pipe) return NULL;
+  LOG_DEBUG("dropping pipe to pid %d %s",(int)pipe->pid,pipe->path?pipe->path:"");
+  for(at = &(pipe->net->pipes); *at; at = &((*at)->next)) if(*at == pipe)
+  {
+    *at = pipe->next;
+    break;
+  }
+  if(pipe->map) munmap(pipe->map, shm_maplen(pipe->size));
+  if(pipe->sock >= 0) close(pipe->sock);
+  if(pipe->bell >= 0) close(pipe->bell);
+  if(pipe->peer >= 0) close(pipe->peer);
+  lob_freeall(pipe->out);
+  free(pipe->path);
+  free(pipe);
+  return NULL;
+}
+
+// point at our halves of the map, the connector sends on ring 0
+static pipe_t shm_attach(pipe_t pipe, struct shm_map *map, uint32_t size, uint8_t connector)
+{
+  uint8_t *data = (uint8_t*)map + sizeof(struct shm_map);
+  pipe->map = map;
+  pipe->size = size;
+  pipe->tx = &(map->ring[connector ? 0 : 1]);
+  pipe->rx = &(map->ring[connector ? 1 : 0]);
+  pipe->txd = connector ? data : data + size;
+  pipe->rxd = connector ? data + size : data;
+  return pipe;
+}
+
+link_t shm_send(link_t link, lob_t packet, void *arg);
+
+// free dead pipes, their fds get marked closed for the loop
+static net_shm_t shm_reap(net_shm_t net, struct pollfd *fds, int count)
+{
+  pipe_t pipe, next;
+  int i;
+  for(pipe = net->pipes; pipe; pipe = next)
+  {
+    next = pipe->next;
+    if(!pipe->dead) continue;
+    for(i = 0; fds && i < count; i++) if(fds[i].fd == pipe->sock || fds[i].fd == pipe->bell) fds[i].fd = -1;
+    if(pipe->link) link_unpipe(pipe->link, shm_send, pipe);
+    pipe_free(pipe);
+  }
+  return net;
+}
+
+// copy one packet into the ring, 0 if there isn't room
+static int shm_put(pipe_t pipe, lob_t packet)
+{
+  uint32_t len = (uint32_t)lob_len(packet);
+  uint32_t need = SHM_ALIGN(4 + len);
+  uint32_t mask = pipe->size - 1;
+  uint32_t tail = pipe->tx->tail;
+  uint32_t head = shm_load(&(pipe->tx->head));
+  uint32_t pos = tail & mask;
+  uint32_t skip = (need > pipe->size - pos) ? pipe->size - pos : 0;
+  uint32_t pad = SHM_PAD;
+
+  if(skip + need > pipe->size - (tail - head)) return 0;
+  if(skip)
+  {
+    memcpy(pipe->txd + pos, &pad, 4);
+    tail += skip;
+    pos = 0;
+  }
+  memcpy(pipe->txd + pos, &len, 4);
+  memcpy(pipe->txd + pos + 4, lob_raw(packet), len);
+  shm_store(&(pipe->tx->tail), tail + need);
+  return 1;
+}
+
+// move the backlog into the ring, waking them once
+static pipe_t shm_flush(pipe_t pipe)
+{
+  lob_t packet;
+  uint32_t sent = 0;
+
+  if(!pipe->map || pipe->dead) return pipe;
+  while((packet = pipe->out))
+  {
+    if(!shm_put(pipe, packet))
+    {
+      // ask for a doorbell once there's room, and look again in case it already went by
+      shm_store(&(pipe->tx->full), 1);
+      if(!shm_put(pipe, packet)) break;
+    }
+    sent += (uint32_t)lob_len(packet);
+    pipe->out = lob_splice(pipe->out, packet);
+    lob_free(packet);
+  }
+  if(!sent) return pipe;
+  if(__atomic_exchange_n(&(pipe->tx->sleeping), 0, __ATOMIC_SEQ_CST)) shm_ring(pipe);
+
+  // let the link know so it can send more
+  if(pipe->link) link_sent(pipe->link, sent);
+  return pipe;
+}
+
+link_t shm_send(link_t link, lob_t packet, void *arg)
+{
+  pipe_t pipe = (pipe_t)arg;
+  if(!pipe || !link) return NULL;
+
+  // request to drop, the link already forgot us, only the owning link closes the pipe
+  if(!packet)
+  {
+    if(pipe->link != link) return link;
+    pipe->link = NULL;
+    pipe->dead = 1;
+    return link;
+  }
+
+  // not taken, the link still owns it and can try another pipe
+  char *cookie = (packet->head_len == 1 && pipe->cookie[0]) ? pipe->cookie : NULL;
+  if(pipe->dead) return NULL;
+
+  // anything up to half the ring always fits once it's drained, a connecting one will offer ours
+  uint32_t size = (pipe->map) ? pipe->size : pipe->net->ring;
+  if(SHM_ALIGN(4 + mesh_cookie_len(packet, cookie)) > size / 2)
+  {
+    LOG_WARN("packet too large for the ring %lu",(unsigned long)mesh_cookie_len(packet, cookie));
+    return NULL;
+  }
+
+  LOG_CRAZY("send to %s at pid %d",hashname_short(link->id),(int)pipe->pid);
+  packet = mesh_cookie(packet, cookie);
+  pipe->out = lob_push(pipe->out, packet);
+  shm_flush(pipe);
+  return link;
+}
+
+// take every waiting packet (up to a batch) out of the ring and deliver them together
+static pipe_t shm_drain(pipe_t pipe)
+{
+  net_shm_t net = pipe->net;
+  lob_t packet, packets = NULL, challenge;
+  uint32_t mask, head, tail, pos, len;
+  int count = 0;
+
+  if(!pipe->map || pipe->dead) return pipe;
+  mask = pipe->size - 1;
+  head = pipe->rx->head;
+  tail = shm_load(&(pipe->rx->tail));
+  if(tail - head > pipe->size)
+  {
+    LOG_WARN("corrupt ring from pid %d",(int)pipe->pid);
+    pipe->dead = 1;
+    return NULL;
+  }
+
+  while(head != tail && count < NET_SHM_BATCH)
+  {
+    pos = head & mask;
+    memcpy(&len, pipe->rxd + pos, 4);
+    if(len == SHM_PAD)
+    {
+      head += pipe->size - pos;
+      continue;
+    }
+    // it's their memory, only trust what was checked
+    if(len > pipe->size - pos - 4 || SHM_ALIGN(4 + len) > tail - head)
+    {
+      LOG_WARN("corrupt ring from pid %d",(int)pipe->pid);
+      pipe->dead = 1;
+      break;
+    }
+    packet = lob_parse(pipe->rxd + pos + 4, len);
+    head += SHM_ALIGN(4 + len);
+    count++;
+    if(!packet)
+    {
+      LOG_WARN("unparseable packet from pid %d",(int)pipe->pid);
+      continue;
+    }
+
+    // they want our handshakes to echo this
+    if(lob_get_cmp(packet,"type","cookie") == 0 && lob_get(packet,"cookie"))
+    {
+      snprintf(pipe->cookie,sizeof(pipe->cookie),"%s",lob_get(packet,"cookie"));
+      lob_free(packet);
+      if(pipe->link) link_sync(pipe->link);
+      continue;
+    }
+    if((packet = mesh_admit(net->mesh, packet, (uint8_t*)&(pipe->pid), sizeof(pipe->pid), &challenge))) packets = lob_push(packets, packet);
+    if(challenge) pipe->out = lob_push(pipe->out, challenge);
+  }
+
+  // hand the space back, waking them if they're waiting on it
+  shm_store(&(pipe->rx->head), head);
+  if(__atomic_exchange_n(&(pipe->rx->full), 0, __ATOMIC_SEQ_CST)) shm_ring(pipe);
+
+  link_t link = (packets) ? mesh_receive_batch(net->mesh, packets) : NULL;
+  if(link && link != pipe->link && !pipe->dead)
+  {
+    LOG_DEBUG("adding new link to pipe for %s",hashname_short(link->id));
+    // a pipe carries one link, the previous one lets go of it first
+    if(pipe->link) link_unpipe(pipe->link, shm_send, pipe);
+    pipe->link = link;
+    if(net->window) link_window(link,net->window);
+    link_pipe(link,shm_send,pipe);
+  }
+
+  return pipe;
+}
+
+// the connector creates the map and doorbells and hands them over
+static pipe_t shm_offer(pipe_t pipe, uint32_t size)
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union { char buf[CMSG_SPACE(3 * sizeof(int))]; struct cmsghdr align; } control;
+  struct shm_map *map;
+  int fds[3], mem;
+
+  // sealed at its size so they can't shrink it out from under our mapping
+  if((mem = memfd_create("telehash", MFD_CLOEXEC|MFD_ALLOW_SEALING)) < 0) return LOG_WARN("memfd failed %s",strerror(errno));
+  if(ftruncate(mem, (off_t)shm_maplen(size)) < 0 || fcntl(mem, F_ADD_SEALS, SHM_SEALS) < 0 || (map = mmap(NULL, shm_maplen(size), PROT_READ|PROT_WRITE, MAP_SHARED, mem, 0)) == MAP_FAILED)
+  {
+    close(mem);
+    return LOG_WARN("map failed %s",strerror(errno));
+  }
+  map->magic = SHM_MAGIC;
+  map->size = size;
+  map->ring[0].sleeping = map->ring[1].sleeping = 1;
+  shm_attach(pipe, map, size, 1);
+
+  if((pipe->bell = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC)) < 0 || (pipe->peer = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC)) < 0)
+  {
+    close(mem);
+    return LOG_WARN("eventfd failed %s",strerror(errno));
+  }
+
+  // their bell is our peer and the other way around
+  fds[0] = mem;
+  fds[1] = pipe->peer;
+  fds[2] = pipe->bell;
+  memset(&msg,0,sizeof(msg));
+  memset(&control,0,sizeof(control));
+  iov.iov_base = &size;
+  iov.iov_len = sizeof(size);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  if(sendmsg(pipe->sock, &msg, MSG_NOSIGNAL) < 0)
+  {
+    close(mem);
+    return LOG_WARN("offer failed %s",strerror(errno));
+  }
+
+  // the mapping outlives the fd
+  close(mem);
+  return pipe;
+}
+
+// the acceptor maps what the connector sent, returns NULL on anything else
+static pipe_t shm_accept(pipe_t pipe)
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union { char buf[CMSG_SPACE(3 * sizeof(int))]; struct cmsghdr align; } control;
+  struct shm_map *map;
+  struct stat st;
+  uint32_t size = 0;
+  int fds[3] = {-1,-1,-1}, seals;
+  ssize_t len;
+
+  memset(&msg,0,sizeof(msg));
+  iov.iov_base = &size;
+  iov.iov_len = sizeof(size);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  if((len = recvmsg(pipe->sock, &msg, MSG_CMSG_CLOEXEC)) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return pipe;
+  for(cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+  {
+    if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(fds))) memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+  }
+
+  map = MAP_FAILED;
+  if(len == (ssize_t)sizeof(size) && fds[0] >= 0 && size >= 4096 && size <= (1u << 30) && !(size & (size - 1))
+    && fstat(fds[0], &st) == 0 && (size_t)st.st_size == shm_maplen(size)
+    && (seals = fcntl(fds[0], F_GET_SEALS)) >= 0 && (seals & SHM_SEALS) == SHM_SEALS)
+  {
+    map = mmap(NULL, shm_maplen(size), PROT_READ|PROT_WRITE, MAP_SHARED, fds[0], 0);
+  }
+  if(fds[0] >= 0) close(fds[0]);
+  if(map == MAP_FAILED || map->magic != SHM_MAGIC || map->size != size)
+  {
+    if(map != MAP_FAILED) munmap(map, shm_maplen(size));
+    if(fds[1] >= 0) close(fds[1]);
+    if(fds[2] >= 0) close(fds[2]);
+    pipe->dead = 1;
+    return LOG_WARN("bad offer from pid %d",(int)pipe->pid);
+  }
+  shm_attach(pipe, map, size, 0);
+  pipe->bell = fds[1];
+  pipe->peer = fds[2];
+  LOG_DEBUG("mapped %u byte rings from pid %d",size,(int)pipe->pid);
+  return pipe;
+}
+
+// 0 if the path doesn't fit
+static int shm_addr(struct sockaddr_un *sa, char *path)
+{
+  memset(sa,0,sizeof(struct sockaddr_un));
+  sa->sun_family = AF_UNIX;
+  if(strlen(path) >= sizeof(sa->sun_path)) return 0;
+  strcpy(sa->sun_path, path);
+  return 1;
+}
+
+// try a pending connect again, once through the map is offered
+static pipe_t shm_finish(pipe_t pipe)
+{
+  struct sockaddr_un sa;
+  shm_addr(&sa, pipe->path);
+  if(connect(pipe->sock, (struct sockaddr *)&sa, sizeof(sa)) < 0 && errno != EISCONN)
+  {
+    if(errno == EAGAIN || errno == EINPROGRESS || errno == EALREADY || errno == EINTR) return pipe;
+    LOG_WARN("connect failed to %s: %s",pipe->path,strerror(errno));
+    pipe->dead = 1;
+    return NULL;
+  }
+  pipe->connecting = 0;
+  if(!shm_trust(pipe->net, pipe->sock, &(pipe->uid), &(pipe->pid)) || !shm_offer(pipe, pipe->net->ring))
+  {
+    pipe->dead = 1;
+    return NULL;
+  }
+  LOG_DEBUG("connected to %s",pipe->path);
+  return shm_flush(pipe);
+}
+
+// reuse any live pipe to this path not carrying another link, else make a new one
+static pipe_t shm_connect(net_shm_t net, char *path, link_t link)
+{
+  struct sockaddr_un sa;
+  pipe_t pipe;
+  int sock;
+  uint8_t connecting = 0;
+
+  for(pipe = net->pipes; pipe; pipe = pipe->next)
+  {
+    if(pipe->dead || (pipe->link && pipe->link != link)) continue;
+    if(pipe->path && strcmp(pipe->path, path) == 0) return pipe;
+  }
+
+  if(!shm_addr(&sa, path)) return LOG_WARN("path too long %s",path);
+
+  LOG("new connection to %s",path);
+  if((sock = socket(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC|SOCK_NONBLOCK, 0)) < 0) return LOG_WARN("socket failed %s",strerror(errno));
+
+  // local connects nearly always complete right away, a full backlog is retried from the loop
+  if(connect(sock, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+  {
+    if(errno != EAGAIN && errno != EINPROGRESS && errno != EINTR)
+    {
+      LOG_WARN("connect failed to %s: %s",path,strerror(errno));
+      close(sock);
+      return NULL;
+    }
+    connecting = 1;
+  }
+  if(!(pipe = pipe_new(net, sock, connecting)))
+  {
+    close(sock);
+    return NULL;
+  }
+  if(!(pipe->path = strdup(path)))
+  {
+    pipe_free(pipe);
+    return LOG("OOM");
+  }
+  if(!connecting && !shm_offer(pipe, net->ring))
+  {
+    pipe_free(pipe);
+    return NULL;
+  }
+  return pipe;
+}
+
+static link_t shm_path(link_t link, lob_t path)
+{
+  net_shm_t net;
+  pipe_t pipe;
+  char *file;
+
+  if(!link || !path) return NULL;
+  if(util_cmp("shm",lob_get(path,"type"))) return NULL;
+  for(net = shm_all; net && net->mesh != link->mesh; net = net->next);
+  if(!net) return NULL;
+  if(!(file = lob_get(path,"path"))) return LOG("missing path");
+
+  // one pipe per peer, either direction
+  for(pipe = net->pipes; pipe; pipe = pipe->next) if(!pipe->dead && pipe->link == link) return link;
+
+  if(!(pipe = shm_connect(net, file, link))) return NULL;
+  pipe->link = link;
+  if(net->window) link_window(link,net->window);
+  link_pipe(link,shm_send,pipe);
+  return link;
+}
+
+net_shm_t net_shm_new(mesh_t mesh, lob_t options)
+{
+  int sock;
+  net_shm_t net;
+  struct sockaddr_un sa;
+  char *path = lob_get(options,"path");
+  uint32_t ring = lob_get_uint(options,"ring");
+
+  if(!mesh || !path) return LOG_ERROR("bad args");
+  if(!shm_addr(&sa, path)) return LOG_ERROR("path too long %s",path);
+  if(!ring) ring = NET_SHM_RING;
+  if(ring < 4096 || ring > (1u << 30) || (ring & (ring - 1))) return LOG_ERROR("ring must be a power of two from 4096 %u",ring);
+
+  // never take over anything but a leftover socket
+  if(util_sock_unlink(path) < 0) return LOG_ERROR("can't listen at %s",path);
+  if((sock = socket(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC, 0)) < 0) return LOG_ERROR("failed to create socket %s",strerror(errno));
+  if(bind(sock, (struct sockaddr*)&sa, sizeof(sa)) < 0 || listen(sock, 128) < 0)
+  {
+    close(sock);
+    return LOG_ERROR("bind/listen failed %s",strerror(errno));
+  }
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+  if(!(net = malloc(sizeof (struct net_shm_struct))))
+  {
+    close(sock);
+    unlink(path);
+    return LOG_ERROR("OOM");
+  }
+  memset(net,0,sizeof (struct net_shm_struct));
+  if(!(net->path = strdup(path)))
+  {
+    close(sock);
+    unlink(path);
+    free(net);
+    return LOG_ERROR("OOM");
+  }
+  net->mesh = mesh;
+  net->server = sock;
+  net->ring = ring;
+  net->any = lob_get_cmp(options,"any","true") == 0;
+  net->window = lob_get_uint(options,"window");
+
+  // connect us to this mesh
+  net->next = shm_all;
+  shm_all = net;
+  mesh_on_path(mesh, "net_shm", shm_path);
+
+  return net;
+}
+
+// any links still using it are told the pipes are gone
+net_shm_t net_shm_free(net_shm_t net)
+{
+  net_shm_t *at;
+  pipe_t pipe;
+  if(!net) return NULL;
+  LOG_DEBUG("closing shm transport on %s",net->path);
+  for(at = &shm_all; *at; at = &((*at)->next)) if(*at == net)
+  {
+    *at = net->next;
+    break;
+  }
+  for(pipe = net->pipes; pipe; pipe = pipe->next) pipe->dead = 1;
+  shm_reap(net, NULL, 0);
+  close(net->server);
+  unlink(net->path);
+  free(net->path);
+  free(net);
+  return NULL;
+}
+
+lob_t net_shm_path(net_shm_t net)
+{
+  lob_t path;
+  if(!net) return NULL;
+  path = lob_new();
+  lob_set(path,"type","shm");
+  lob_set(path,"path",net->path);
+  return path;
+}
+
+net_shm_t net_shm_peer(net_shm_t net, link_t link, uid_t *uid, pid_t *pid)
+{
+  pipe_t pipe;
+  if(!net || !link) return NULL;
+  for(pipe = net->pipes; pipe && (pipe->dead || pipe->connecting || pipe->link != link); pipe = pipe->next);
+  if(!pipe) return NULL;
+  if(uid) *uid = pipe->uid;
+  if(pid) *pid = pipe->pid;
+  return net;
+}
+
+static net_shm_t shm_listen(net_shm_t net)
+{
+  int sock;
+
+  while((sock = accept4(net->server, NULL, NULL, SOCK_CLOEXEC)) >= 0)
+  {
+    if(!pipe_new(net, sock, 0))
+    {
+      close(sock);
+      continue;
+    }
+    LOG("incoming connection from pid %d",(int)net->pipes->pid);
+  }
+  if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED) LOG_WARN("accept failed %s",strerror(errno));
+  return net;
+}
+
+// nothing is sent on the socket after the offer, so a read is only ever them going away
+static pipe_t shm_watch(pipe_t pipe)
+{
+  uint8_t byte;
+  ssize_t len;
+  if(!pipe->map) return shm_accept(pipe);
+  while((len = recv(pipe->sock, &byte, 1, 0)) > 0);
+  if(len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return pipe;
+  LOG_DEBUG("pid %d went away",(int)pipe->pid);
+  pipe->dead = 1;
+  return NULL;
+}
+
+int net_shm_fds(net_shm_t net, struct pollfd *fds, int max, int *ms)
+{
+  pipe_t pipe;
+  int count = 0;
+  if(!net || !fds || max < 1) return 0;
+  fds[count].fd = net->server;
+  fds[count].events = POLLIN;
+  fds[count++].revents = 0;
+  for(pipe = net->pipes; pipe; pipe = pipe->next)
+  {
+    // dead ones are left out so the loop lets go of them before they're closed
+    if(pipe->dead)
+    {
+      if(ms) *ms = 0;
+      continue;
+    }
+
+    // not connected yet, there's nothing to wait on but the retry
+    if(pipe->connecting)
+    {
+      if(ms && (*ms < 0 || *ms > NET_SHM_RETRY)) *ms = NET_SHM_RETRY;
+      continue;
+    }
+    if(count + 2 > max) break;
+    fds[count].fd = pipe->sock;
+    fds[count].events = POLLIN;
+    fds[count++].revents = 0;
+    if(!pipe->map) continue;
+    fds[count].fd = pipe->bell;
+    fds[count].events = POLLIN;
+    fds[count++].revents = 0;
+
+    // we're about to sleep, have them ring first, unless they already wrote
+    shm_store(&(pipe->rx->sleeping), 1);
+    if(ms && shm_load(&(pipe->rx->tail)) != pipe->rx->head) *ms = 0;
+  }
+  return count;
+}
+
+net_shm_t net_shm_ready(net_shm_t net, struct pollfd *fds, int count)
+{
+  pipe_t pipe;
+  uint64_t rung;
+  int i;
+  if(!net) return LOG_WARN("bad args");
+
+  for(pipe = net->pipes; pipe; pipe = pipe->next) if(pipe->connecting && !pipe->dead) shm_finish(pipe);
+
+  for(i = 0; fds && i < count; i++)
+  {
+    if(fds[i].fd == net->server)
+    {
+      if(fds[i].revents & POLLIN) shm_listen(net);
+      continue;
+    }
+    for(pipe = net->pipes; pipe && pipe->sock != fds[i].fd && pipe->bell != fds[i].fd; pipe = pipe->next);
+    if(!pipe)
+    {
+      fds[i].fd = -1; // closed since it was reported
+      continue;
+    }
+    if(pipe->dead) continue;
+    if(fds[i].fd == pipe->sock)
+    {
+      if(fds[i].revents) shm_watch(pipe);
+      continue;
+    }
+    if(fds[i].revents & POLLIN) while(read(pipe->bell, &rung, sizeof(rung)) < 0 && errno == EINTR);
+  }
+
+  // rings are cheap to look at, so every pipe is checked rather than only rung ones
+  for(pipe = net->pipes; pipe; pipe = pipe->next)
+  {
+    shm_drain(pipe);
+    shm_flush(pipe);
+  }
+
+  return shm_reap(net, fds, count);
+}
+
+net_shm_t net_shm_process(net_shm_t net)
+{
+  struct pollfd fds[UTIL_LOOP_FDS];
+  int count;
+  if(!net) return LOG_WARN("bad args");
+  count = net_shm_fds(net, fds, UTIL_LOOP_FDS, NULL);
+  if(poll(fds, (nfds_t)count, 0) < 0 && errno != EINTR) return LOG_WARN("poll failed %s",strerror(errno));
+  return net_shm_ready(net, fds, count);
+}
+
+static int shm_loop_fds(void *net, struct pollfd *fds, int max, int *ms)
+{
+  return net_shm_fds((net_shm_t)net, fds, max, ms);
+}
+
+static void *shm_loop_ready(void *net, struct pollfd *fds, int count)
+{
+  return net_shm_ready((net_shm_t)net, fds, count);
+}
+
+net_shm_t net_shm_loop(net_shm_t net, util_loop_t loop)
+{
+  if(!net || !loop) return LOG_WARN("bad args");
+  if(!util_loop_add(loop, net, shm_loop_fds, shm_loop_ready)) return NULL;
+  return net;
+}
+
+#endif // __linux__
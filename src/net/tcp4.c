@@ -3,6 +3,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,264 +13,493 @@
 #include <fcntl.h>
 #include "net_tcp4.h"
 
+// a closed peer must not SIGPIPE us
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
 
-// this is just a minimal tcp4 transport backing for testing, it should only serve as an example for using a real socket event lib
-
-// individual pipe local info
-typedef struct pipe_tcp4_struct
+// one connection, every packet on it is varint length framed (util_chunks stream mode)
+typedef struct pipe_struct
 {
-  struct sockaddr_in sa;
-  int client;
-  net_tcp4_t net;
+  link_t link;
   util_chunks_t chunks;
-} *pipe_tcp4_t;
+  net_tcp4_t net;
+  struct pipe_struct *next;
+  struct sockaddr_in sa; // who we connected to or accepted from
+  int sock;
+  char cookie[32]; // last admission cookie they challenged us with
+  uint8_t connecting:1; // waiting on a non-blocking connect
+  uint8_t dead:1; // closed or failed, freed on the next pass
+} *pipe_t;
+
+// overall server
+struct net_tcp4_struct
+{
+  mesh_t mesh;
+  pipe_t pipes;
+  int server;
+  uint16_t port;
+  uint32_t window; // link send window to apply, 0 for unlimited
+  uint8_t *buf; // NET_TCP4_READ, shared by every read
+  struct net_tcp4_struct *next;
+};
+
+// path callbacks only get the link, find our transport from its mesh
+static net_tcp4_t tcp4_all = NULL;
+
+static int tcp4_setup(int sock)
+{
+  int opt = 1;
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+#ifdef SO_NOSIGPIPE
+  setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, &opt, sizeof(opt));
+#endif
+  return sock;
+}
 
-// just make sure it's connected
-pipe_tcp4_t tcp4_to(pipe_t pipe)
+static pipe_t pipe_new(net_tcp4_t net, struct sockaddr_in *sa, int sock)
 {
-  struct sockaddr_in addr;
-  int ret;
-  pipe_tcp4_t to;
-  if(!pipe || !pipe->arg) return NULL;
-  to = (pipe_tcp4_t)pipe->arg;
-  if(to->client > 0) return to;
-  
-  // no socket yet, connect one
-  if((to->client = socket(AF_INET, SOCK_STREAM, 0)) <= 0) return LOG("client socket faied %s, will retry next send",strerror(errno));
-
-  // try to bind to our server port for some reflection
-  memset(&addr, 0, sizeof(struct sockaddr_in));
-  addr.sin_family = AF_INET;
-  addr.sin_port = htons(to->net->port);
-  addr.sin_addr.s_addr = htonl(INADDR_ANY);
-  bind(to->client, (struct sockaddr *)&addr, sizeof(struct sockaddr)); // optional, ignore fail
-
-  fcntl(to->client, F_SETFL, O_NONBLOCK);
-  ret = connect(to->client, (struct sockaddr *)&(to->sa), sizeof(struct sockaddr));
-  if(ret < 0 && errno != EWOULDBLOCK && errno != EINPROGRESS)
+  pipe_t pipe;
+  if(!(pipe = malloc(sizeof (struct pipe_struct)))) return LOG("OOM");
+  memset(pipe,0,sizeof (struct pipe_struct));
+  if(!(pipe->chunks = util_chunks_stream(util_chunks_new(0),1)))
   {
-    LOG("client socket connect faied to %s: %s, will retry next send",pipe->id,strerror(errno));
-    close(to->client);
-    to->client = 0;
-    return NULL;
+    free(pipe);
+    return LOG("OOM");
   }
-
-  LOG("connected to %s",pipe->id);
-  return to;
+  pipe->net = net;
+  pipe->sa = *sa;
+  pipe->sock = sock;
+  pipe->next = net->pipes;
+  net->pipes = pipe;
+  return pipe;
 }
 
-// do all chunk/socket stuff
-pipe_t tcp4_flush(pipe_t pipe)
+static pipe_t pipe_free(pipe_t pipe)
 {
-  ssize_t len;
-  lob_t packet;
-  uint8_t buf[256];
-  pipe_tcp4_t to = tcp4_to(pipe);
-  if(!to) return NULL;
-
-  if(util_chunks_len(to->chunks))
+  pipe_t *at;
+  if(!pipe) return NULL;
+  LOG_DEBUG("dropping pipe %s:%u",inet_ntoa(pipe->sa.sin_addr), ntohs(pipe->sa.sin_port));
+  for(at = &(pipe->net->pipes); *at; at = &((*at)->next)) if(*at == pipe)
   {
-    while((len = write(to->client, util_chunks_write(to->chunks), util_chunks_len(to->chunks))) > 0)
-    {
-      LOG("wrote %d bytes to %s",len,pipe->id);
-      util_chunks_written(to->chunks, (size_t)len);
-      LOG("writeat %d written %d",to->chunks->writeat,to->chunks->writing);
-    }
+    *at = pipe->next;
+    break;
   }
+  if(pipe->sock >= 0) close(pipe->sock);
+  util_chunks_free(pipe->chunks);
+  free(pipe);
+  return NULL;
+}
 
-  while((len = read(to->client, buf, 256)) > 0)
+link_t tcp4_send(link_t link, lob_t packet, void *arg);
+
+// free dead pipes, their fds get marked closed for the loop
+static net_tcp4_t tcp4_reap(net_tcp4_t net, struct pollfd *fds, int count)
+{
+  pipe_t pipe, next;
+  int i;
+  for(pipe = net->pipes; pipe; pipe = next)
   {
-    LOG("reading %d bytes from %s",len,pipe->id);
-    util_chunks_read(to->chunks, buf, (size_t)len);
+    next = pipe->next;
+    if(!pipe->dead) continue;
+    for(i = 0; fds && i < count; i++) if(fds[i].fd == pipe->sock) fds[i].fd = -1;
+    if(pipe->link) link_unpipe(pipe->link, tcp4_send, pipe);
+    pipe_free(pipe);
   }
+  return net;
+}
 
-  // any incoming full packets can be received
-  while((packet = util_chunks_receive(to->chunks))) mesh_receive(to->net->mesh, packet, pipe);
+// gather write everything queued until the socket is full
+static pipe_t tcp4_flush(pipe_t pipe)
+{
+  struct iovec iov[UTIL_CHUNKS_IOV];
+  struct msghdr msg;
+  ssize_t len;
+  uint32_t before;
+  int count;
 
-  if(len < 0 && errno != EWOULDBLOCK && errno != EINPROGRESS)
+  if(pipe->connecting || pipe->dead) return pipe;
+  before = util_chunks_writing(pipe->chunks);
+  while((count = util_chunks_iov(pipe->chunks, iov, UTIL_CHUNKS_IOV)) > 0)
   {
-    LOG("socket error to %s: %s",pipe->id,strerror(errno));
-    close(to->client);
-    to->client = 0;
+    memset(&msg,0,sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = (size_t)count;
+    if((len = sendmsg(pipe->sock, &msg, MSG_NOSIGNAL)) < 0)
+    {
+      if(errno == EINTR) continue;
+      if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+      LOG_WARN("send failed to %s:%u: %s",inet_ntoa(pipe->sa.sin_addr), ntohs(pipe->sa.sin_port),strerror(errno));
+      pipe->dead = 1;
+      return NULL;
+    }
+    util_chunks_written(pipe->chunks, (size_t)len);
   }
 
+  // let the link know how much left so it can send more
+  if(pipe->link && before > util_chunks_writing(pipe->chunks)) link_sent(pipe->link, before - util_chunks_writing(pipe->chunks));
   return pipe;
 }
 
-// chunkize a packet
-void tcp4_send(pipe_t pipe, lob_t packet, link_t link)
+link_t tcp4_send(link_t link, lob_t packet, void *arg)
 {
-  pipe_tcp4_t to = tcp4_to(pipe);
-  if(!to || !packet || !link) return;
+  pipe_t pipe = (pipe_t)arg;
+  if(!pipe || !link) return NULL;
 
-  util_chunks_send(to->chunks, packet);
-  tcp4_flush(pipe);
-}
+  // request to drop, the link already forgot us, only the owning link closes the pipe
+  if(!packet)
+  {
+    if(pipe->link != link) return link;
+    pipe->link = NULL;
+    pipe->dead = 1;
+    return link;
+  }
 
-pipe_t tcp4_free(pipe_t pipe)
-{
-  pipe_tcp4_t to;
-  if(!pipe) return NULL;
-  to = (pipe_tcp4_t)pipe->arg;
-  if(!to) return LOG("internal error, invalid pipe, leaking it");
-
-  xht_set(to->net->pipes,pipe->id,NULL);
-  pipe_free(pipe);
-  if(to->client > 0) close(to->client);
-  util_chunks_free(to->chunks);
-  free(to);
-  return NULL;
+  // not taken, the link still owns it and can try another pipe
+  if(pipe->dead) return NULL;
+
+  LOG_CRAZY("send to %s at %s:%u",hashname_short(link->id),inet_ntoa(pipe->sa.sin_addr), ntohs(pipe->sa.sin_port));
+  if(packet->head_len == 1 && pipe->cookie[0]) packet = mesh_cookie(packet, pipe->cookie);
+  util_chunks_send(pipe->chunks, packet);
+
+  // most sends fit in the socket buffer right away, the loop gets the rest
+  // the queue owns it now either way, a failed flush marks the pipe dead to be reaped
+  tcp4_flush(pipe);
+  return link;
 }
 
-// internal, get or create a pipe
-pipe_t tcp4_pipe(net_tcp4_t net, char *ip, int port)
+// reuse any live connection to this address not carrying another link (any for a NULL link), else start a new one
+static pipe_t tcp4_connect(net_tcp4_t net, struct sockaddr_in *sa, link_t link)
 {
   pipe_t pipe;
-  pipe_tcp4_t to;
-  char id[23];
-
-  snprintf(id,23,"%s:%d",ip,port);
-  pipe = xht_get(net->pipes,id);
-  if(pipe) return pipe;
-
-  // create new tcp4 pipe
-  if(!(pipe = pipe_new("tcp4"))) return NULL;
-  if(!(pipe->arg = to = malloc(sizeof (struct pipe_tcp4_struct)))) return pipe_free(pipe);
-  memset(to,0,sizeof (struct pipe_tcp4_struct));
-  to->net = net;
-  to->sa.sin_family = AF_INET;
-  inet_aton(ip, &(to->sa.sin_addr));
-  to->sa.sin_port = htons(port);
-  if(!(to->chunks = util_chunks_new(0))) return tcp4_free(pipe);
-
-  // set up pipe
-  pipe->id = strdup(id);
-  xht_set(net->pipes,pipe->id,pipe);
-  pipe->send = tcp4_send;
+  int sock;
 
+  for(pipe = net->pipes; pipe; pipe = pipe->next)
+  {
+    if(pipe->dead || (link && pipe->link && pipe->link != link)) continue;
+    if(pipe->sa.sin_addr.s_addr == sa->sin_addr.s_addr && pipe->sa.sin_port == sa->sin_port) return pipe;
+  }
+
+  LOG("new connection to %s:%u",inet_ntoa(sa->sin_addr), ntohs(sa->sin_port));
+  if((sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0) return LOG_WARN("socket failed %s",strerror(errno));
+  tcp4_setup(sock);
+  if(connect(sock, (struct sockaddr *)sa, sizeof(struct sockaddr_in)) < 0 && errno != EINPROGRESS)
+  {
+    LOG_WARN("connect failed to %s:%u: %s",inet_ntoa(sa->sin_addr), ntohs(sa->sin_port),strerror(errno));
+    close(sock);
+    return NULL;
+  }
+  if(!(pipe = pipe_new(net, sa, sock)))
+  {
+    close(sock);
+    return NULL;
+  }
+  pipe->connecting = 1;
   return pipe;
 }
 
-
-pipe_t tcp4_path(link_t link, lob_t path)
+static link_t tcp4_path(link_t link, lob_t path)
 {
   net_tcp4_t net;
+  pipe_t pipe;
+  struct sockaddr_in sa;
   char *ip;
   int port;
 
-  // just sanity check the path first
   if(!link || !path) return NULL;
-  if(!(net = xht_get(link->mesh->index, "net_tcp4"))) return NULL;
   if(util_cmp("tcp4",lob_get(path,"type"))) return NULL;
+  for(net = tcp4_all; net && net->mesh != link->mesh; net = net->next);
+  if(!net) return NULL;
   if(!(ip = lob_get(path,"ip"))) return LOG("missing ip");
-  if((port = lob_get_int(path,"port")) <= 0) return LOG("missing port");
-  return tcp4_pipe(net, ip, port);
+  if((port = lob_get_int(path,"port")) <= 0 || port > 65535) return LOG("missing port");
+
+  // one connection per peer, either direction
+  for(pipe = net->pipes; pipe; pipe = pipe->next) if(!pipe->dead && pipe->link == link) return link;
+
+  memset(&sa,0,sizeof(sa));
+  sa.sin_family = AF_INET;
+  if(!inet_aton(ip, &(sa.sin_addr))) return LOG("bad ip %s",ip);
+  sa.sin_port = htons((uint16_t)port);
+  if(!(pipe = tcp4_connect(net, &sa, link))) return NULL;
+  pipe->link = link;
+  if(net->window) link_window(link,net->window);
+  link_pipe(link,tcp4_send,pipe);
+  return link;
 }
 
 net_tcp4_t net_tcp4_new(mesh_t mesh, lob_t options)
 {
   int port, sock, opt = 1;
-  unsigned int pipes;
   net_tcp4_t net;
   struct sockaddr_in sa;
   socklen_t size = sizeof(struct sockaddr_in);
-  
+
   port = lob_get_int(options,"port");
-  pipes = lob_get_uint(options,"pipes");
-  if(!pipes) pipes = 11; // hashtable for active pipes
 
-  // create a udp socket
-  if((sock = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP) ) < 0 ) return LOG("failed to create socket %s",strerror(errno));
+  if((sock = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0) return LOG_ERROR("failed to create socket %s",strerror(errno));
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const void *)&opt, sizeof(int));
 
   memset(&sa,0,sizeof(sa));
   sa.sin_family = AF_INET;
   sa.sin_port = htons(port);
   sa.sin_addr.s_addr = htonl(INADDR_ANY);
-  if(bind(sock, (struct sockaddr*)&sa, size) < 0)
+  if(bind(sock, (struct sockaddr*)&sa, size) < 0 || listen(sock, 128) < 0)
   {
     close(sock);
-    return LOG("bind failed %s",strerror(errno));
+    return LOG_ERROR("bind/listen failed %s",strerror(errno));
   }
   getsockname(sock, (struct sockaddr*)&sa, &size);
-  if(listen(sock, 10) < 0)
-  {
-    close(sock);
-    return LOG("listen failed %s",strerror(errno));
-  }
-  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const void *)&opt , sizeof(int));
-  fcntl(sock, F_SETFL, O_NONBLOCK);
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
 
   if(!(net = malloc(sizeof (struct net_tcp4_struct))))
   {
     close(sock);
-    return LOG("OOM");
+    return LOG_ERROR("OOM");
   }
   memset(net,0,sizeof (struct net_tcp4_struct));
+  if(!(net->buf = malloc(NET_TCP4_READ)))
+  {
+    close(sock);
+    free(net);
+    return LOG_ERROR("OOM");
+  }
+  net->mesh = mesh;
   net->server = sock;
   net->port = ntohs(sa.sin_port);
-  net->pipes = xht_new(pipes);
+  net->window = lob_get_uint(options,"window");
 
   // connect us to this mesh
-  net->mesh = mesh;
-  xht_set(mesh->index, "net_tcp4", net);
+  net->next = tcp4_all;
+  tcp4_all = net;
   mesh_on_path(mesh, "net_tcp4", tcp4_path);
-  
-  // convenience
-  net->path = lob_new();
-  lob_set(net->path,"type","tcp4");
-  lob_set(net->path,"ip","127.0.0.1");
-  lob_set_int(net->path,"port",net->port);
-  mesh->paths = lob_push(mesh->paths, net->path);
 
   return net;
 }
 
-void net_tcp4_free(net_tcp4_t net)
+// any links still using it are told the pipes are gone
+net_tcp4_t net_tcp4_free(net_tcp4_t net)
 {
-  if(!net) return;
+  net_tcp4_t *at;
+  pipe_t pipe;
+  if(!net) return NULL;
+  LOG_DEBUG("closing tcp4 transport on %u",net->port);
+  for(at = &tcp4_all; *at; at = &((*at)->next)) if(*at == net)
+  {
+    *at = net->next;
+    break;
+  }
+  for(pipe = net->pipes; pipe; pipe = pipe->next) pipe->dead = 1;
+  tcp4_reap(net, NULL, 0);
   close(net->server);
-  xht_free(net->pipes);
-//  lob_free(net->path); // managed by mesh->paths
+  free(net->buf);
   free(net);
-  return;
+  return NULL;
+}
+
+static net_tcp4_t tcp4_accept(net_tcp4_t net)
+{
+  struct sockaddr_in sa;
+  socklen_t size = sizeof(sa);
+  int sock;
+
+  while((sock = accept(net->server, (struct sockaddr *)&sa, &size)) >= 0)
+  {
+    LOG("incoming connection from %s:%u",inet_ntoa(sa.sin_addr), ntohs(sa.sin_port));
+    tcp4_setup(sock);
+    if(!pipe_new(net, &sa, sock)) close(sock);
+    size = sizeof(sa);
+  }
+  if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED) LOG_WARN("accept failed %s",strerror(errno));
+  return net;
+}
+
+// read everything available and deliver any whole packets
+static pipe_t tcp4_read(pipe_t pipe)
+{
+  net_tcp4_t net = pipe->net;
+  ssize_t len;
+
+  while(1)
+  {
+    len = read(pipe->sock, net->buf, NET_TCP4_READ);
+    if(len > 0)
+    {
+      if(util_chunks_read(pipe->chunks, net->buf, (size_t)len)) continue;
+      LOG_WARN("bad framing from %s:%u",inet_ntoa(pipe->sa.sin_addr), ntohs(pipe->sa.sin_port));
+    }else if(len < 0 && errno == EINTR){
+      continue;
+    }else if(len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+      break;
+    }else if(len < 0){
+      LOG_DEBUG("read failed from %s:%u: %s",inet_ntoa(pipe->sa.sin_addr), ntohs(pipe->sa.sin_port),strerror(errno));
+    }
+    pipe->dead = 1;
+    break;
+  }
+
+  // process received full packets together
+  lob_t packet = NULL, packets = NULL, challenge;
+  uint8_t from[6];
+  memcpy(from,&(pipe->sa.sin_addr),4);
+  memcpy(from+4,&(pipe->sa.sin_port),2);
+  while((packet = util_chunks_receive(pipe->chunks)))
+  {
+    // they want our handshakes to echo this
+    if(lob_get_cmp(packet,"type","cookie") == 0 && lob_get(packet,"cookie"))
+    {
+      snprintf(pipe->cookie,sizeof(pipe->cookie),"%s",lob_get(packet,"cookie"));
+      lob_free(packet);
+      if(pipe->link) link_sync(pipe->link);
+      continue;
+    }
+    if((packet = mesh_admit(net->mesh, packet, from, sizeof(from), &challenge))) packets = lob_push(packets, packet);
+    if(challenge) util_chunks_send(pipe->chunks, challenge);
+  }
+  link_t link = (packets) ? mesh_receive_batch(net->mesh, packets) : NULL;
+  if(link && link != pipe->link && !pipe->dead)
+  {
+    LOG_DEBUG("adding new link to pipe for %s",hashname_short(link->id));
+    // a pipe carries one link, the previous one lets go of it first
+    if(pipe->link) link_unpipe(pipe->link, tcp4_send, pipe);
+    pipe->link = link;
+    if(net->window) link_window(link,net->window);
+    link_pipe(link,tcp4_send,pipe);
+  }
+
+  return pipe;
 }
 
-// process any new incoming connections
-void net_tcp4_accept(net_tcp4_t net)
+int net_tcp4_fds(net_tcp4_t net, struct pollfd *fds, int max, int *ms)
 {
-  struct sockaddr_in addr;
-  int client;
   pipe_t pipe;
-  pipe_tcp4_t to;
-  socklen_t size = sizeof(struct sockaddr_in);
+  int count = 0;
+  if(!net || !fds || max < 1) return 0;
+  fds[count].fd = net->server;
+  fds[count].events = POLLIN;
+  fds[count++].revents = 0;
+  for(pipe = net->pipes; pipe; pipe = pipe->next)
+  {
+    // dead ones are left out so the loop lets go of them before they're closed
+    if(pipe->dead)
+    {
+      if(ms) *ms = 0;
+      continue;
+    }
+    if(count == max) break;
+    fds[count].fd = pipe->sock;
+    fds[count].events = POLLIN;
+    if(pipe->connecting || util_chunks_len(pipe->chunks)) fds[count].events |= POLLOUT;
+    fds[count++].revents = 0;
+  }
+  return count;
+}
+
+net_tcp4_t net_tcp4_ready(net_tcp4_t net, struct pollfd *fds, int count)
+{
+  pipe_t pipe;
+  int i, err;
+  socklen_t errlen;
+  if(!net) return LOG_WARN("bad args");
 
-  while((client = accept(net->server, (struct sockaddr *)&addr,&size)) > 0)
+  for(i = 0; fds && i < count; i++)
   {
-    fcntl(client, F_SETFL, O_NONBLOCK);
-    if(!(pipe = tcp4_pipe(net, inet_ntoa(addr.sin_addr), ntohs(addr.sin_port))))
+    if(fds[i].fd == net->server)
     {
-      close(client);
+      if(fds[i].revents & POLLIN) tcp4_accept(net);
       continue;
     }
-    LOG("incoming connection from %s",pipe->id);
-    to = (pipe_tcp4_t)pipe->arg;
-    if(to->client > 0) close(to->client);
-    to->client = client;
+    for(pipe = net->pipes; pipe && pipe->sock != fds[i].fd; pipe = pipe->next);
+    if(!pipe)
+    {
+      fds[i].fd = -1; // closed since it was reported
+      continue;
+    }
+    if(!fds[i].revents || pipe->dead) continue;
+
+    if(pipe->connecting)
+    {
+      err = 0;
+      errlen = sizeof(err);
+      getsockopt(pipe->sock, SOL_SOCKET, SO_ERROR, &err, &errlen);
+      if(err)
+      {
+        LOG_WARN("connect failed to %s:%u: %s",inet_ntoa(pipe->sa.sin_addr), ntohs(pipe->sa.sin_port),strerror(err));
+        pipe->dead = 1;
+        continue;
+      }
+      if(!(fds[i].revents & (POLLOUT|POLLIN))) continue;
+      pipe->connecting = 0;
+    }
+
+    if(fds[i].revents & (POLLIN|POLLHUP|POLLERR)) tcp4_read(pipe);
+    tcp4_flush(pipe);
   }
 
+  return tcp4_reap(net, fds, count);
+}
+
+net_tcp4_t net_tcp4_process(net_tcp4_t net)
+{
+  struct pollfd fds[UTIL_LOOP_FDS];
+  int count;
+  if(!net) return LOG_WARN("bad args");
+  count = net_tcp4_fds(net, fds, UTIL_LOOP_FDS, NULL);
+  if(poll(fds, (nfds_t)count, 0) < 0 && errno != EINTR) return LOG_WARN("poll failed %s",strerror(errno));
+  return net_tcp4_ready(net, fds, count);
+}
+
+static int tcp4_loop_fds(void *net, struct pollfd *fds, int max, int *ms)
+{
+  return net_tcp4_fds((net_tcp4_t)net, fds, max, ms);
 }
 
-// check a single pipe's socket for any read/write activity
-static void _walkflush(xht_t h, const char *key, void *val, void *arg)
+static void *tcp4_loop_ready(void *net, struct pollfd *fds, int count)
 {
-  tcp4_flush((pipe_t)val);
+  return net_tcp4_ready((net_tcp4_t)net, fds, count);
 }
 
-net_tcp4_t net_tcp4_loop(net_tcp4_t net)
+net_tcp4_t net_tcp4_loop(net_tcp4_t net, util_loop_t loop)
 {
-  net_tcp4_accept(net);
-  xht_walk(net->pipes, _walkflush, NULL);
+  if(!net || !loop) return LOG_WARN("bad args");
+  if(!util_loop_add(loop, net, tcp4_loop_fds, tcp4_loop_ready)) return NULL;
   return net;
 }
 
-#endif
+int net_tcp4_socket(net_tcp4_t net)
+{
+  if(!net) return -1;
+  return net->server;
+}
+
+uint16_t net_tcp4_port(net_tcp4_t net)
+{
+  if(!net) return 0;
+  return net->port;
+}
+
+net_tcp4_t net_tcp4_direct(net_tcp4_t net, lob_t packet, char *ip, uint16_t port)
+{
+  struct sockaddr_in sa;
+  pipe_t pipe;
+  if(!net || !packet || !ip || !port)
+  {
+    lob_free(packet);
+    return LOG_WARN("bad args");
+  }
+
+  memset(&sa,0,sizeof(sa));
+  sa.sin_family = AF_INET;
+  inet_aton(ip, &(sa.sin_addr));
+  sa.sin_port = htons(port);
+  if(!(pipe = tcp4_connect(net, &sa, NULL)))
+  {
+    lob_free(packet);
+    return LOG_WARN("direct pipe failed to %s:%u",ip,port);
+  }
+  util_chunks_send(pipe->chunks,packet);
+  tcp4_flush(pipe);
+  return net;
+}
+
+#endif // POSIX
@@ -1,6 +1,7 @@
 #if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
 
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
 #include "net_udp4.h"
@@ -13,6 +14,7 @@ typedef struct pipe_struct
   net_udp4_t net;
   struct pipe_struct *next;
   struct sockaddr_in sa;
+  char cookie[32]; // last admission cookie they challenged us with
 } *pipe_t;
 
 // overall server
@@ -22,6 +24,8 @@ struct net_udp4_struct
   pipe_t pipes;
   int server;
   uint16_t port;
+  uint32_t window; // link send window to apply, 0 for unlimited
+  uint8_t crc, frames, fec; // util_frames modes for every pipe, both sides must match
 };
 
 static pipe_t pipe_free(pipe_t pipe)
@@ -57,11 +61,21 @@ link_t udp4_send(link_t link, lob_t packet, void *arg)
   }
 
   LOG_CRAZY("send to %s at %s:%u",hashname_short(link->id),inet_ntoa(pipe->sa.sin_addr), ntohs(pipe->sa.sin_port));
+  if(packet->head_len == 1 && pipe->cookie[0]) packet = mesh_cookie(packet, pipe->cookie);
   util_frames_send(pipe->frames,packet);
 
   return link;
 }
 
+// frames in the modes this net was created with
+static util_frames_t udp4_frames(net_udp4_t net)
+{
+  util_frames_t frames = util_frames_new(128);
+  if(!frames) return LOG("OOM");
+  if(!util_frames_crc(frames, net->crc) || !util_frames_window(frames, net->frames) || !util_frames_fec(frames, net->fec)) return util_frames_free(frames);
+  return frames;
+}
+
 // internal, get or create a pipe
 pipe_t udp4_pipe(net_udp4_t net, struct sockaddr_in *from)
 {
@@ -79,8 +93,12 @@ pipe_t udp4_pipe(net_udp4_t net, struct sockaddr_in *from)
   to->sa.sin_family = AF_INET;
   to->sa.sin_addr = from->sin_addr;
   to->sa.sin_port = from->sin_port;
-  to->frames = util_frames_new(128);
-  
+  if(!(to->frames = udp4_frames(net)))
+  {
+    free(to);
+    return LOG("frames failed");
+  }
+
   // link into list
   to->next = net->pipes;
   net->pipes = to;
@@ -101,8 +119,8 @@ net_udp4_t net_udp4_new(mesh_t mesh, lob_t options)
   // create a udp socket
   if((sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP) ) < 0 ) return LOG_ERROR("failed to create socket %s",strerror(errno));
 
-  // TODO this needs to be modified for app usage
-  util_sock_timeout(sock,1);
+  // never blocks, drive it from an event loop w/ net_udp4_loop() or net_udp4_fds()
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
 
   memset(&sa,0,sizeof(sa));
   sa.sin_family = AF_INET;
@@ -124,6 +142,20 @@ net_udp4_t net_udp4_new(mesh_t mesh, lob_t options)
   net->mesh = mesh;
   net->server = sock;
   net->port = ntohs(sa.sin_port);
+  net->window = lob_get_uint(options,"window");
+  net->crc = lob_get_int(options,"crc") ? 1 : 0;
+  net->frames = (uint8_t)lob_get_uint(options,"frames");
+  net->fec = (uint8_t)lob_get_uint(options,"fec");
+
+  // catch bad frame modes here rather than on every new pipe
+  util_frames_t frames = udp4_frames(net);
+  if(!frames)
+  {
+    close(sock);
+    free(net);
+    return LOG_ERROR("invalid frames %u or fec %u",lob_get_uint(options,"frames"),lob_get_uint(options,"fec"));
+  }
+  util_frames_free(frames);
   if(!mesh->port_local) mesh->port_local = (uint16_t)net->port; // use ours as the default if no others
 
   return net;
@@ -138,7 +170,8 @@ net_udp4_t net_udp4_free(net_udp4_t net)
   return NULL;
 }
 
-net_udp4_t net_udp4_process(net_udp4_t net)
+// read anything waiting if readable, then send pending frames and nudge busy pipes w/ a meta frame
+static net_udp4_t udp4_service(net_udp4_t net, uint8_t readable, uint8_t nudge)
 {
   if(!net) return LOG_WARN("bad args");
 
@@ -149,7 +182,7 @@ net_udp4_t net_udp4_process(net_udp4_t net)
   
   // try receiving anything waiting
   pipe_t pipe = NULL;
-  while(1)
+  while(readable)
   {
     ssize_t len = recvfrom(net->server, frame, sizeof(frame), 0, (struct sockaddr *)&sa, (socklen_t *)&salen);
     if(len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
@@ -170,21 +203,36 @@ net_udp4_t net_udp4_process(net_udp4_t net)
   {
     next = pipe->next;
     
-    // process received full packets
-    lob_t packet = NULL;
+    // process received full packets together
+    lob_t packet = NULL, packets = NULL, challenge;
+    uint8_t from[6];
+    memcpy(from,&(pipe->sa.sin_addr),4);
+    memcpy(from+4,&(pipe->sa.sin_port),2);
     while((packet = util_frames_receive(pipe->frames)))
     {
-      link_t link = mesh_receive(net->mesh, packet);
-      if(!link) continue;
-      if(link != pipe->link)
+      // they want our handshakes to echo this
+      if(lob_get_cmp(packet,"type","cookie") == 0 && lob_get(packet,"cookie"))
       {
-        LOG_DEBUG("adding new link to pipe for %s",hashname_short(link->id));
-        pipe->link = link;
-        link_pipe(link,udp4_send,pipe);
+        snprintf(pipe->cookie,sizeof(pipe->cookie),"%s",lob_get(packet,"cookie"));
+        lob_free(packet);
+        if(pipe->link) link_sync(pipe->link);
+        continue;
       }
+      if((packet = mesh_admit(net->mesh, packet, from, sizeof(from), &challenge))) packets = lob_push(packets, packet);
+      if(challenge) util_frames_send(pipe->frames, challenge);
+    }
+    link_t link = (packets) ? mesh_receive_batch(net->mesh, packets) : NULL;
+    if(link && link != pipe->link)
+    {
+      LOG_DEBUG("adding new link to pipe for %s",hashname_short(link->id));
+      pipe->link = link;
+      if(net->window) link_window(link,net->window);
+      link_pipe(link,udp4_send,pipe);
     }
     
-    // send all/any waiting frames
+    // send all/any waiting frames, an idle pipe stays quiet so two peers don't ping-pong meta frames
+    size_t outlen = util_frames_outlen(pipe->frames);
+    if(!util_frames_pending(pipe->frames) && !(nudge && util_frames_busy(pipe->frames))) continue;
     while(util_frames_outbox(pipe->frames,frame,NULL))
     {
       if(sendto(net->server, frame, sizeof(frame), 0, (struct sockaddr *)&(pipe->sa), sizeof(struct sockaddr_in)) < 0)
@@ -195,11 +243,59 @@ net_udp4_t net_udp4_process(net_udp4_t net)
       // only continue if sent says there's more
       if(!util_frames_sent(pipe->frames)) break;
     }
+
+    // let the link know how much left so it can send more
+    if(pipe->link && outlen > util_frames_outlen(pipe->frames)) link_sent(pipe->link, outlen - util_frames_outlen(pipe->frames));
   }
   
   return net;
 }
 
+net_udp4_t net_udp4_process(net_udp4_t net)
+{
+  return udp4_service(net, 1, 1);
+}
+
+int net_udp4_fds(net_udp4_t net, struct pollfd *fds, int max, int *ms)
+{
+  pipe_t pipe;
+  if(!net || !fds || max < 1) return 0;
+  fds->fd = net->server;
+  fds->events = POLLIN;
+  fds->revents = 0;
+  for(pipe = net->pipes; pipe; pipe = pipe->next)
+  {
+    if(util_frames_pending(pipe->frames)) fds->events |= POLLOUT;
+    else if(ms && util_frames_busy(pipe->frames) && (*ms < 0 || *ms > NET_UDP4_NUDGE)) *ms = NET_UDP4_NUDGE;
+  }
+  return 1;
+}
+
+net_udp4_t net_udp4_ready(net_udp4_t net, struct pollfd *fds, int count)
+{
+  if(!net) return LOG_WARN("bad args");
+  // a timer wake is the only time to nudge, otherwise the other side's answer would wake us right back
+  if(count < 1 || !fds->revents) return udp4_service(net, 0, 1);
+  return udp4_service(net, (fds->revents & (POLLIN|POLLERR)) ? 1 : 0, 0);
+}
+
+static int udp4_loop_fds(void *net, struct pollfd *fds, int max, int *ms)
+{
+  return net_udp4_fds((net_udp4_t)net, fds, max, ms);
+}
+
+static void *udp4_loop_ready(void *net, struct pollfd *fds, int count)
+{
+  return net_udp4_ready((net_udp4_t)net, fds, count);
+}
+
+net_udp4_t net_udp4_loop(net_udp4_t net, util_loop_t loop)
+{
+  if(!net || !loop) return LOG_WARN("bad args");
+  if(!util_loop_add(loop, net, udp4_loop_fds, udp4_loop_ready)) return NULL;
+  return net;
+}
+
 int net_udp4_socket(net_udp4_t net)
 {
   if(!net) return -1;
@@ -221,7 +317,7 @@ net_udp4_t net_udp4_direct(net_udp4_t net, lob_t packet, char *ip, uint16_t port
   inet_aton(ip, &(sa.sin_addr));
   sa.sin_port = htons(port);
   pipe_t pipe = udp4_pipe(net, &sa);
-  if(!port)
+  if(!pipe)
   {
     lob_free(packet);
     return LOG_WARN("direct pipe failed to %s:%u",ip,port);
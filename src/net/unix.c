@@ -0,0 +1,562 @@
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+
+// struct ucred
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "net_unix.h"
+
+// a closed peer must not SIGPIPE us
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// one connection, every message on it is one whole packet
+typedef struct pipe_struct
+{
+  link_t link;
+  lob_t out; // packets the socket had no room for yet
+  net_unix_t net;
+  struct pipe_struct *next;
+  char *path; // only known for ones we connected to
+  int sock;
+  uid_t uid; // of the process at the other end, from the kernel
+  pid_t pid;
+  char cookie[32]; // last admission cookie they challenged us with
+  uint8_t connecting:1; // their listener had no room yet, connect is retried
+  uint8_t dead:1; // closed or failed, freed on the next pass
+} *pipe_t;
+
+// overall server
+struct net_unix_struct
+{
+  mesh_t mesh;
+  pipe_t pipes;
+  char *path;
+  int server;
+  uint8_t any; // accept peers running as any user
+  uint32_t window; // link send window to apply, 0 for unlimited
+  uint8_t *buf; // NET_UNIX_MAX, shared by every read
+  struct net_unix_struct *next;
+};
+
+// path callbacks only get the link, find our transport from its mesh
+static net_unix_t unix_all = NULL;
+
+// who's at the other end, refuse it unless it's us or root
+static int unix_trust(net_unix_t net, int sock, uid_t *uid, pid_t *pid)
+{
+#if defined(SO_PEERCRED)
+  struct ucred cred;
+  socklen_t len = sizeof(cred);
+  if(getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+  {
+    LOG_WARN("no peer credentials %s",strerror(errno));
+    return 0;
+  }
+  *uid = cred.uid;
+  *pid = cred.pid;
+#else
+  gid_t gid;
+  if(getpeereid(sock, uid, &gid) < 0)
+  {
+    LOG_WARN("no peer credentials %s",strerror(errno));
+    return 0;
+  }
+  *pid = 0;
+#endif
+  if(net->any || *uid == 0 || *uid == geteuid()) return 1;
+  LOG_WARN("refusing peer uid %u pid %d",(unsigned)*uid,(int)*pid);
+  return 0;
+}
+
+// a connecting one is only trusted once it's through
+static pipe_t pipe_new(net_unix_t net, int sock, uint8_t connecting)
+{
+  pipe_t pipe;
+  if(!(pipe = malloc(sizeof (struct pipe_struct)))) return LOG("OOM");
+  memset(pipe,0,sizeof (struct pipe_struct));
+  if(!connecting && !unix_trust(net, sock, &(pipe->uid), &(pipe->pid)))
+  {
+    free(pipe);
+    return NULL;
+  }
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+  pipe->net = net;
+  pipe->sock = sock;
+  pipe->connecting = connecting;
+  pipe->next = net->pipes;
+  net->pipes = pipe;
+  return pipe;
+}
+
+static pipe_t pipe_free(pipe_t pipe)
+{
+  pipe_t *at;
+  if(!pipe) return NULL;
+  LOG_DEBUG("dropping pipe to pid %d %s",(int)pipe->pid,pipe->path?pipe->path:"");
+  for(at = &(pipe->net->pipes); *at; at = &((*at)->next)) if(*at == pipe)
+  {
+    *at = pipe->next;
+    break;
+  }
+  if(pipe->sock >= 0) close(pipe->sock);
+  lob_freeall(pipe->out);
+  free(pipe->path);
+  free(pipe);
+  return NULL;
+}
+
+link_t unix_send(link_t link, lob_t packet, void *arg);
+
+// free dead pipes, their fds get marked closed for the loop
+static net_unix_t unix_reap(net_unix_t net, struct pollfd *fds, int count)
+{
+  pipe_t pipe, next;
+  int i;
+  for(pipe = net->pipes; pipe; pipe = next)
+  {
+    next = pipe->next;
+    if(!pipe->dead) continue;
+    for(i = 0; fds && i < count; i++) if(fds[i].fd == pipe->sock) fds[i].fd = -1;
+    if(pipe->link) link_unpipe(pipe->link, unix_send, pipe);
+    pipe_free(pipe);
+  }
+  return net;
+}
+
+// send queued packets until the socket is full, one message each
+static pipe_t unix_flush(pipe_t pipe)
+{
+  lob_t packet;
+  ssize_t len;
+  uint32_t sent = 0;
+
+  if(pipe->connecting) return pipe;
+  while(!pipe->dead && (packet = pipe->out))
+  {
+    if((len = send(pipe->sock, lob_raw(packet), lob_len(packet), MSG_NOSIGNAL)) < 0)
+    {
+      if(errno == EINTR) continue;
+      if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+      LOG_WARN("send failed to pid %d: %s",(int)pipe->pid,strerror(errno));
+      pipe->dead = 1;
+      return NULL;
+    }
+    sent += (uint32_t)len;
+    pipe->out = lob_splice(pipe->out, packet);
+    lob_free(packet);
+  }
+
+  // let the link know so it can send more
+  if(pipe->link && sent) link_sent(pipe->link, sent);
+  return pipe;
+}
+
+link_t unix_send(link_t link, lob_t packet, void *arg)
+{
+  pipe_t pipe = (pipe_t)arg;
+  if(!pipe || !link) return NULL;
+
+  // request to drop, the link already forgot us, only the owning link closes the pipe
+  if(!packet)
+  {
+    if(pipe->link != link) return link;
+    pipe->link = NULL;
+    pipe->dead = 1;
+    return link;
+  }
+
+  // not taken, the link still owns it and can try another pipe
+  char *cookie = (packet->head_len == 1 && pipe->cookie[0]) ? pipe->cookie : NULL;
+  if(pipe->dead) return NULL;
+  if(mesh_cookie_len(packet, cookie) > NET_UNIX_MAX)
+  {
+    LOG_WARN("packet too large for a message %lu",(unsigned long)mesh_cookie_len(packet, cookie));
+    return NULL;
+  }
+
+  LOG_CRAZY("send to %s at pid %d",hashname_short(link->id),(int)pipe->pid);
+  packet = mesh_cookie(packet, cookie);
+  pipe->out = lob_push(pipe->out, packet);
+
+  // nearly always straight into the socket, the loop gets any backlog
+  // queued either way, a failed send marks the pipe dead to be reaped
+  unix_flush(pipe);
+  return link;
+}
+
+// 0 if the path doesn't fit
+static int unix_addr(struct sockaddr_un *sa, char *path)
+{
+  memset(sa,0,sizeof(struct sockaddr_un));
+  sa->sun_family = AF_UNIX;
+  if(strlen(path) >= sizeof(sa->sun_path)) return 0;
+  strcpy(sa->sun_path, path);
+  return 1;
+}
+
+// try a pending connect again, it's through once it connects or says it already is
+static pipe_t unix_finish(pipe_t pipe)
+{
+  struct sockaddr_un sa;
+  unix_addr(&sa, pipe->path);
+  if(connect(pipe->sock, (struct sockaddr *)&sa, sizeof(sa)) < 0 && errno != EISCONN)
+  {
+    if(errno == EAGAIN || errno == EINPROGRESS || errno == EALREADY || errno == EINTR) return pipe;
+    LOG_WARN("connect failed to %s: %s",pipe->path,strerror(errno));
+    pipe->dead = 1;
+    return NULL;
+  }
+  if(!unix_trust(pipe->net, pipe->sock, &(pipe->uid), &(pipe->pid)))
+  {
+    pipe->dead = 1;
+    return NULL;
+  }
+  LOG_DEBUG("connected to %s",pipe->path);
+  pipe->connecting = 0;
+  return unix_flush(pipe);
+}
+
+// reuse any live connection to this path not carrying another link, else make a new one
+static pipe_t unix_connect(net_unix_t net, char *path, link_t link)
+{
+  struct sockaddr_un sa;
+  pipe_t pipe;
+  int sock;
+  uint8_t connecting = 0;
+
+  for(pipe = net->pipes; pipe; pipe = pipe->next)
+  {
+    if(pipe->dead || (pipe->link && pipe->link != link)) continue;
+    if(pipe->path && strcmp(pipe->path, path) == 0) return pipe;
+  }
+
+  if(!unix_addr(&sa, path)) return LOG_WARN("path too long %s",path);
+
+  LOG("new connection to %s",path);
+  if((sock = socket(AF_UNIX, SOCK_SEQPACKET, 0)) < 0) return LOG_WARN("socket failed %s",strerror(errno));
+#ifdef SO_NOSIGPIPE
+  int opt = 1;
+  setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, &opt, sizeof(opt));
+#endif
+  // local connects nearly always complete right away, a full backlog is retried from the loop
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+  if(connect(sock, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+  {
+    if(errno != EAGAIN && errno != EINPROGRESS && errno != EINTR)
+    {
+      LOG_WARN("connect failed to %s: %s",path,strerror(errno));
+      close(sock);
+      return NULL;
+    }
+    connecting = 1;
+  }
+  if(!(pipe = pipe_new(net, sock, connecting)))
+  {
+    close(sock);
+    return NULL;
+  }
+  if(!(pipe->path = strdup(path)))
+  {
+    pipe_free(pipe);
+    return LOG("OOM");
+  }
+  return pipe;
+}
+
+static link_t unix_path(link_t link, lob_t path)
+{
+  net_unix_t net;
+  pipe_t pipe;
+  char *file;
+
+  if(!link || !path) return NULL;
+  if(util_cmp("unix",lob_get(path,"type"))) return NULL;
+  for(net = unix_all; net && net->mesh != link->mesh; net = net->next);
+  if(!net) return NULL;
+  if(!(file = lob_get(path,"path"))) return LOG("missing path");
+
+  // one connection per peer, either direction
+  for(pipe = net->pipes; pipe; pipe = pipe->next) if(!pipe->dead && pipe->link == link) return link;
+
+  if(!(pipe = unix_connect(net, file, link))) return NULL;
+  pipe->link = link;
+  if(net->window) link_window(link,net->window);
+  link_pipe(link,unix_send,pipe);
+  return link;
+}
+
+net_unix_t net_unix_new(mesh_t mesh, lob_t options)
+{
+  int sock;
+  net_unix_t net;
+  struct sockaddr_un sa;
+  char *path = lob_get(options,"path");
+
+  if(!mesh || !path) return LOG_ERROR("bad args");
+  if(!unix_addr(&sa, path)) return LOG_ERROR("path too long %s",path);
+
+  // never take over anything but a leftover socket
+  if(util_sock_unlink(path) < 0) return LOG_ERROR("can't listen at %s",path);
+  if((sock = socket(AF_UNIX, SOCK_SEQPACKET, 0)) < 0) return LOG_ERROR("failed to create socket %s",strerror(errno));
+  if(bind(sock, (struct sockaddr*)&sa, sizeof(sa)) < 0 || listen(sock, 128) < 0)
+  {
+    close(sock);
+    return LOG_ERROR("bind/listen failed %s",strerror(errno));
+  }
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+  if(!(net = malloc(sizeof (struct net_unix_struct))))
+  {
+    close(sock);
+    unlink(path);
+    return LOG_ERROR("OOM");
+  }
+  memset(net,0,sizeof (struct net_unix_struct));
+  if(!(net->buf = malloc(NET_UNIX_MAX)) || !(net->path = strdup(path)))
+  {
+    close(sock);
+    unlink(path);
+    free(net->buf);
+    free(net);
+    return LOG_ERROR("OOM");
+  }
+  net->mesh = mesh;
+  net->server = sock;
+  net->any = lob_get_cmp(options,"any","true") == 0;
+  net->window = lob_get_uint(options,"window");
+
+  // connect us to this mesh
+  net->next = unix_all;
+  unix_all = net;
+  mesh_on_path(mesh, "net_unix", unix_path);
+
+  return net;
+}
+
+// any links still using it are told the pipes are gone
+net_unix_t net_unix_free(net_unix_t net)
+{
+  net_unix_t *at;
+  pipe_t pipe;
+  if(!net) return NULL;
+  LOG_DEBUG("closing unix transport on %s",net->path);
+  for(at = &unix_all; *at; at = &((*at)->next)) if(*at == net)
+  {
+    *at = net->next;
+    break;
+  }
+  for(pipe = net->pipes; pipe; pipe = pipe->next) pipe->dead = 1;
+  unix_reap(net, NULL, 0);
+  close(net->server);
+  unlink(net->path);
+  free(net->path);
+  free(net->buf);
+  free(net);
+  return NULL;
+}
+
+lob_t net_unix_path(net_unix_t net)
+{
+  lob_t path;
+  if(!net) return NULL;
+  path = lob_new();
+  lob_set(path,"type","unix");
+  lob_set(path,"path",net->path);
+  return path;
+}
+
+net_unix_t net_unix_peer(net_unix_t net, link_t link, uid_t *uid, pid_t *pid)
+{
+  pipe_t pipe;
+  if(!net || !link) return NULL;
+  for(pipe = net->pipes; pipe && (pipe->dead || pipe->connecting || pipe->link != link); pipe = pipe->next);
+  if(!pipe) return NULL;
+  if(uid) *uid = pipe->uid;
+  if(pid) *pid = pipe->pid;
+  return net;
+}
+
+static net_unix_t unix_accept(net_unix_t net)
+{
+  int sock;
+
+  while((sock = accept(net->server, NULL, NULL)) >= 0)
+  {
+#ifdef SO_NOSIGPIPE
+    int opt = 1;
+    setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, &opt, sizeof(opt));
+#endif
+    if(!pipe_new(net, sock, 0))
+    {
+      close(sock);
+      continue;
+    }
+    LOG("incoming connection from pid %d",(int)net->pipes->pid);
+  }
+  if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED) LOG_WARN("accept failed %s",strerror(errno));
+  return net;
+}
+
+// read every waiting message and deliver them together
+static pipe_t unix_read(pipe_t pipe)
+{
+  net_unix_t net = pipe->net;
+  lob_t packet, packets = NULL, challenge;
+  struct iovec iov;
+  struct msghdr msg;
+  ssize_t len;
+
+  while(1)
+  {
+    memset(&msg,0,sizeof(msg));
+    iov.iov_base = net->buf;
+    iov.iov_len = NET_UNIX_MAX;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    len = recvmsg(pipe->sock, &msg, 0);
+    if(len < 0 && errno == EINTR) continue;
+    if(len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    if(len <= 0)
+    {
+      if(len < 0) LOG_DEBUG("read failed from pid %d: %s",(int)pipe->pid,strerror(errno));
+      pipe->dead = 1;
+      break;
+    }
+    if(msg.msg_flags & MSG_TRUNC)
+    {
+      LOG_WARN("dropping oversized message from pid %d",(int)pipe->pid);
+      continue;
+    }
+    if(!(packet = lob_parse(net->buf, (size_t)len)))
+    {
+      LOG_WARN("unparseable message from pid %d",(int)pipe->pid);
+      continue;
+    }
+
+    // they want our handshakes to echo this
+    if(lob_get_cmp(packet,"type","cookie") == 0 && lob_get(packet,"cookie"))
+    {
+      snprintf(pipe->cookie,sizeof(pipe->cookie),"%s",lob_get(packet,"cookie"));
+      lob_free(packet);
+      if(pipe->link) link_sync(pipe->link);
+      continue;
+    }
+    if((packet = mesh_admit(net->mesh, packet, (uint8_t*)&(pipe->pid), sizeof(pipe->pid), &challenge))) packets = lob_push(packets, packet);
+    if(challenge) pipe->out = lob_push(pipe->out, challenge);
+  }
+
+  link_t link = (packets) ? mesh_receive_batch(net->mesh, packets) : NULL;
+  if(link && link != pipe->link && !pipe->dead)
+  {
+    LOG_DEBUG("adding new link to pipe for %s",hashname_short(link->id));
+    // a pipe carries one link, the previous one lets go of it first
+    if(pipe->link) link_unpipe(pipe->link, unix_send, pipe);
+    pipe->link = link;
+    if(net->window) link_window(link,net->window);
+    link_pipe(link,unix_send,pipe);
+  }
+
+  return pipe;
+}
+
+int net_unix_fds(net_unix_t net, struct pollfd *fds, int max, int *ms)
+{
+  pipe_t pipe;
+  int count = 0;
+  if(!net || !fds || max < 1) return 0;
+  fds[count].fd = net->server;
+  fds[count].events = POLLIN;
+  fds[count++].revents = 0;
+  for(pipe = net->pipes; pipe; pipe = pipe->next)
+  {
+    // dead ones are left out so the loop lets go of them before they're closed
+    if(pipe->dead)
+    {
+      if(ms) *ms = 0;
+      continue;
+    }
+
+    // not connected yet, there's nothing to wait on but the retry
+    if(pipe->connecting)
+    {
+      if(ms && (*ms < 0 || *ms > NET_UNIX_RETRY)) *ms = NET_UNIX_RETRY;
+      continue;
+    }
+    if(count == max) break;
+    fds[count].fd = pipe->sock;
+    fds[count].events = POLLIN;
+    if(pipe->out) fds[count].events |= POLLOUT;
+    fds[count++].revents = 0;
+  }
+  return count;
+}
+
+net_unix_t net_unix_ready(net_unix_t net, struct pollfd *fds, int count)
+{
+  pipe_t pipe;
+  int i;
+  if(!net) return LOG_WARN("bad args");
+
+  for(pipe = net->pipes; pipe; pipe = pipe->next) if(pipe->connecting && !pipe->dead) unix_finish(pipe);
+
+  for(i = 0; fds && i < count; i++)
+  {
+    if(fds[i].fd == net->server)
+    {
+      if(fds[i].revents & POLLIN) unix_accept(net);
+      continue;
+    }
+    for(pipe = net->pipes; pipe && pipe->sock != fds[i].fd; pipe = pipe->next);
+    if(!pipe)
+    {
+      fds[i].fd = -1; // closed since it was reported
+      continue;
+    }
+    if(!fds[i].revents || pipe->dead) continue;
+    if(fds[i].revents & (POLLIN|POLLHUP|POLLERR)) unix_read(pipe);
+    unix_flush(pipe);
+  }
+
+  return unix_reap(net, fds, count);
+}
+
+net_unix_t net_unix_process(net_unix_t net)
+{
+  struct pollfd fds[UTIL_LOOP_FDS];
+  int count;
+  if(!net) return LOG_WARN("bad args");
+  count = net_unix_fds(net, fds, UTIL_LOOP_FDS, NULL);
+  if(poll(fds, (nfds_t)count, 0) < 0 && errno != EINTR) return LOG_WARN("poll failed %s",strerror(errno));
+  return net_unix_ready(net, fds, count);
+}
+
+static int unix_loop_fds(void *net, struct pollfd *fds, int max, int *ms)
+{
+  return net_unix_fds((net_unix_t)net, fds, max, ms);
+}
+
+static void *unix_loop_ready(void *net, struct pollfd *fds, int count)
+{
+  return net_unix_ready((net_unix_t)net, fds, count);
+}
+
+net_unix_t net_unix_loop(net_unix_t net, util_loop_t loop)
+{
+  if(!net || !loop) return LOG_WARN("bad args");
+  if(!util_loop_add(loop, net, unix_loop_fds, unix_loop_ready)) return NULL;
+  return net;
+}
+
+#endif // POSIX
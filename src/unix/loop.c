@@ -0,0 +1,285 @@
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+#include "telehash.h"
+#include "util_loop.h"
+
+typedef struct loop_net_struct
+{
+  void *net;
+  util_loop_fds_t fds;
+  util_loop_ready_t ready;
+  int at, count; // its fds this pass
+  unsigned long long due; // when its own timer wants it, 0 is none
+  uint8_t woke;
+} *loop_net_t;
+
+struct util_loop_struct
+{
+  mesh_t mesh;
+  loop_net_t nets;
+  struct pollfd *fds; // UTIL_LOOP_FDS per net, refilled every pass
+  int netlen, fdlen;
+#ifdef __linux__
+  int epoll;
+  struct epoll_event *events;
+  // interest currently registered w/ epoll, indexed by fd
+  struct loop_watch { uint32_t pass; int slot; short events; uint8_t on; } *watch;
+  int watchlen;
+  int *armed, armedlen; // fd in each slot after the last pass
+  uint32_t pass;
+#endif
+  uint8_t stop:1;
+};
+
+util_loop_t util_loop_new(mesh_t mesh)
+{
+  util_loop_t loop;
+  if(!mesh) return LOG("bad args");
+  if(!(loop = malloc(sizeof(struct util_loop_struct)))) return LOG("OOM");
+  memset(loop,0,sizeof(struct util_loop_struct));
+  loop->mesh = mesh;
+#ifdef __linux__
+  if((loop->epoll = epoll_create1(EPOLL_CLOEXEC)) < 0)
+  {
+    free(loop);
+    return LOG_ERROR("epoll_create1 failed %s",strerror(errno));
+  }
+#endif
+  return loop;
+}
+
+util_loop_t util_loop_free(util_loop_t loop)
+{
+  if(!loop) return NULL;
+#ifdef __linux__
+  close(loop->epoll);
+  free(loop->events);
+  free(loop->watch);
+  free(loop->armed);
+#endif
+  free(loop->nets);
+  free(loop->fds);
+  free(loop);
+  return NULL;
+}
+
+util_loop_t util_loop_add(util_loop_t loop, void *net, util_loop_fds_t fds, util_loop_ready_t ready)
+{
+  loop_net_t nets;
+  struct pollfd *all;
+  if(!loop || !net || !fds || !ready) return LOG("bad args");
+  util_loop_remove(loop, net);
+
+  if(!(nets = realloc(loop->nets, sizeof(struct loop_net_struct) * (loop->netlen + 1)))) return LOG("OOM");
+  loop->nets = nets;
+  if(!(all = realloc(loop->fds, sizeof(struct pollfd) * UTIL_LOOP_FDS * (loop->netlen + 1)))) return LOG("OOM");
+  loop->fds = all;
+#ifdef __linux__
+  struct epoll_event *events;
+  if(!(events = realloc(loop->events, sizeof(struct epoll_event) * UTIL_LOOP_FDS * (loop->netlen + 1)))) return LOG("OOM");
+  loop->events = events;
+#endif
+
+  memset(&(nets[loop->netlen]),0,sizeof(struct loop_net_struct));
+  nets[loop->netlen].net = net;
+  nets[loop->netlen].fds = fds;
+  nets[loop->netlen].ready = ready;
+  loop->netlen++;
+  return loop;
+}
+
+util_loop_t util_loop_remove(util_loop_t loop, void *net)
+{
+  int i;
+  if(!loop || !net) return LOG("bad args");
+  for(i = 0; i < loop->netlen; i++) if(loop->nets[i].net == net)
+  {
+    // stale epoll interest is dropped by the next pass
+    memmove(&(loop->nets[i]),&(loop->nets[i+1]),sizeof(struct loop_net_struct) * (loop->netlen - i - 1));
+    loop->netlen--;
+    break;
+  }
+  return loop;
+}
+
+#ifdef __linux__
+// bring epoll in line w/ what the transports reported this pass
+static util_loop_t loop_arm(util_loop_t loop)
+{
+  int i, fd, op;
+  struct epoll_event ev;
+
+  loop->pass++;
+  for(i = 0; i < loop->fdlen; i++)
+  {
+    fd = loop->fds[i].fd;
+    if(fd < 0) continue;
+    if(fd >= loop->watchlen)
+    {
+      int len = fd + 64;
+      struct loop_watch *watch;
+      if(!(watch = realloc(loop->watch, sizeof(struct loop_watch) * len))) return LOG("OOM");
+      memset(watch + loop->watchlen, 0, sizeof(struct loop_watch) * (len - loop->watchlen));
+      loop->watch = watch;
+      loop->watchlen = len;
+    }
+    loop->watch[fd].pass = loop->pass;
+    loop->watch[fd].slot = i;
+    if(loop->watch[fd].on && loop->watch[fd].events == loop->fds[i].events) continue;
+
+    memset(&ev,0,sizeof(ev));
+    ev.data.fd = fd;
+    if(loop->fds[i].events & POLLIN) ev.events |= EPOLLIN;
+    if(loop->fds[i].events & POLLOUT) ev.events |= EPOLLOUT;
+    op = loop->watch[fd].on ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    // fd numbers get reused after a close, so retry the other way
+    if(epoll_ctl(loop->epoll, op, fd, &ev) < 0 && epoll_ctl(loop->epoll, (op == EPOLL_CTL_ADD) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev) < 0)
+    {
+      LOG_WARN("epoll_ctl failed on %d: %s",fd,strerror(errno));
+      continue;
+    }
+    loop->watch[fd].events = loop->fds[i].events;
+    loop->watch[fd].on = 1;
+  }
+
+  // whatever wasn't reported this time is done
+  for(i = 0; i < loop->armedlen; i++)
+  {
+    fd = loop->armed[i];
+    if(fd < 0 || fd >= loop->watchlen || loop->watch[fd].pass == loop->pass || !loop->watch[fd].on) continue;
+    epoll_ctl(loop->epoll, EPOLL_CTL_DEL, fd, NULL);
+    loop->watch[fd].on = 0;
+  }
+
+  if(loop->fdlen > loop->armedlen)
+  {
+    int *armed;
+    if(!(armed = realloc(loop->armed, sizeof(int) * loop->fdlen))) return LOG("OOM");
+    loop->armed = armed;
+  }
+  for(i = 0; i < loop->fdlen; i++) loop->armed[i] = loop->fds[i].fd;
+  loop->armedlen = loop->fdlen;
+
+  return loop;
+}
+#endif
+
+// which net reported this fd slot
+static loop_net_t loop_owner(util_loop_t loop, int slot)
+{
+  int i;
+  for(i = 0; i < loop->netlen; i++) if(slot >= loop->nets[i].at && slot < loop->nets[i].at + loop->nets[i].count) return &(loop->nets[i]);
+  return NULL;
+}
+
+util_loop_t util_loop_once(util_loop_t loop, int ms)
+{
+  int i, ready, netms;
+  uint32_t now, at;
+  unsigned long long nowms;
+  loop_net_t net;
+  if(!loop) return LOG("bad args");
+
+  // gather everyone's interest and when each wants its timer
+  loop->fdlen = 0;
+  nowms = util_sys_ms(0);
+  for(i = 0; i < loop->netlen; i++)
+  {
+    net = &(loop->nets[i]);
+    net->at = loop->fdlen;
+    netms = -1;
+    net->count = net->fds(net->net, loop->fds + net->at, UTIL_LOOP_FDS, &netms);
+    if(net->count < 0) net->count = 0;
+    if(net->count > UTIL_LOOP_FDS) net->count = UTIL_LOOP_FDS;
+    net->woke = 0;
+    loop->fdlen += net->count;
+
+    // keep the earliest deadline until it's serviced, busy neighbors can't keep pushing it back
+    if(netms < 0) net->due = 0;
+    else if(!net->due || nowms + (unsigned long long)netms < net->due) net->due = nowms + (unsigned long long)netms;
+    if(!net->due) continue;
+    netms = (net->due > nowms) ? (int)(net->due - nowms) : 0;
+    if(ms < 0 || netms < ms) ms = netms;
+  }
+
+  // sleep no later than the mesh needs, seconds come from the same clock as ms since time() may lag behind it
+  now = (uint32_t)(nowms / 1000);
+  if((at = mesh_deadline(loop->mesh, now)))
+  {
+    nowms = ((unsigned long long)at * 1000 > nowms) ? (unsigned long long)at * 1000 - nowms : 0;
+    if(ms < 0 || nowms < (unsigned long long)ms) ms = (int)nowms;
+  }
+
+#ifdef __linux__
+  if(!loop_arm(loop)) return NULL;
+  for(i = 0; i < loop->fdlen; i++) loop->fds[i].revents = 0;
+  ready = epoll_wait(loop->epoll, loop->events, (loop->fdlen) ? loop->fdlen : 1, ms);
+  if(ready < 0 && errno != EINTR) return LOG_ERROR("epoll_wait failed %s",strerror(errno));
+  for(i = 0; i < ready; i++)
+  {
+    int fd = loop->events[i].data.fd;
+    struct pollfd *pfd;
+    if(fd < 0 || fd >= loop->watchlen || loop->watch[fd].pass != loop->pass) continue;
+    pfd = &(loop->fds[loop->watch[fd].slot]);
+    if(loop->events[i].events & EPOLLIN) pfd->revents |= POLLIN;
+    if(loop->events[i].events & EPOLLOUT) pfd->revents |= POLLOUT;
+    if(loop->events[i].events & EPOLLERR) pfd->revents |= POLLERR;
+    if(loop->events[i].events & EPOLLHUP) pfd->revents |= POLLHUP;
+    if((net = loop_owner(loop, loop->watch[fd].slot))) net->woke = 1;
+  }
+#else
+  ready = poll(loop->fds, (nfds_t)loop->fdlen, ms);
+  if(ready < 0 && errno != EINTR) return LOG_ERROR("poll failed %s",strerror(errno));
+  for(i = 0; ready > 0 && i < loop->fdlen; i++) if(loop->fds[i].revents && (net = loop_owner(loop, i))) net->woke = 1;
+#endif
+
+  // mesh timers first so anything they send goes out below
+  nowms = util_sys_ms(0);
+  now = (uint32_t)(nowms / 1000);
+  if((at = mesh_deadline(loop->mesh, now)) && at <= now) mesh_process(loop->mesh, now);
+
+  // a timer wake services everyone, otherwise those w/ events or whose own timer is due even when others were busy
+  for(i = 0; i < loop->netlen; i++)
+  {
+    net = &(loop->nets[i]);
+    if(ready > 0 && !net->woke && !(net->due && net->due <= nowms)) continue;
+    net->due = 0;
+    if(!net->ready(net->net, loop->fds + net->at, net->count)) return LOG_WARN("transport failed");
+#ifdef __linux__
+    // closing takes it out of epoll, forget it so a reused number gets added again
+    int slot;
+    for(slot = net->at; slot < net->at + net->count; slot++)
+    {
+      if(loop->fds[slot].fd >= 0 || loop->armed[slot] < 0 || loop->armed[slot] >= loop->watchlen) continue;
+      loop->watch[loop->armed[slot]].on = 0;
+      loop->armed[slot] = -1;
+    }
+#endif
+  }
+
+  return loop;
+}
+
+util_loop_t util_loop_run(util_loop_t loop)
+{
+  if(!loop) return LOG("bad args");
+  loop->stop = 0;
+  while(!loop->stop) if(!util_loop_once(loop, -1)) return NULL;
+  loop->stop = 0;
+  return loop;
+}
+
+util_loop_t util_loop_stop(util_loop_t loop)
+{
+  if(!loop) return LOG("bad args");
+  loop->stop = 1;
+  return loop;
+}
+
+#endif // POSIX
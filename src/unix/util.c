@@ -3,10 +3,13 @@
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <sys/time.h>
 #include <time.h>
 #include <errno.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "telehash.h"
 
 #include "telehash.h"
@@ -75,4 +78,35 @@ int util_sock_timeout(int sock, uint32_t ms)
   return sock;
 }
 
+int util_sock_unlink(char *path)
+{
+  struct stat st;
+  struct sockaddr_un sa;
+  int sock, stale;
+
+  if(!path) return -1;
+  if(lstat(path, &st) < 0) return (errno == ENOENT) ? 0 : -1;
+  if(!S_ISSOCK(st.st_mode))
+  {
+    LOG("not a socket, leaving %s",path);
+    return -1;
+  }
+  memset(&sa,0,sizeof(sa));
+  sa.sun_family = AF_UNIX;
+  if(strlen(path) >= sizeof(sa.sun_path)) return -1;
+  strcpy(sa.sun_path, path);
+
+  // only a refused connect says it's left over, a live listener of any type answers something else
+  if((sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) return -1;
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+  stale = (connect(sock, (struct sockaddr *)&sa, sizeof(sa)) < 0 && errno == ECONNREFUSED);
+  close(sock);
+  if(!stale)
+  {
+    LOG("still in use %s",path);
+    return -1;
+  }
+  return unlink(path);
+}
+
 #endif
@@ -7,6 +7,11 @@
 #include <sys/time.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 #include "telehash.h"
 
@@ -50,6 +55,45 @@ long util_sys_random(void)
   return random();
 }
 
+void util_sys_entropy(uint8_t *bytes, size_t len)
+{
+  size_t got = 0;
+  long ret;
+  int fd;
+
+#if defined(__APPLE__)
+  arc4random_buf(bytes, len);
+  return;
+#endif
+
+#ifdef SYS_getrandom
+  while(got < len)
+  {
+    ret = syscall(SYS_getrandom, bytes+got, len-got, 0);
+    if(ret < 0 && errno == EINTR) continue;
+    if(ret <= 0) break;
+    got += (size_t)ret;
+  }
+#endif
+
+  // older kernels
+  if(got < len && (fd = open("/dev/urandom", O_RDONLY)) >= 0)
+  {
+    while(got < len)
+    {
+      ret = read(fd, bytes+got, len-got);
+      if(ret < 0 && errno == EINTR) continue;
+      if(ret <= 0) break;
+      got += (size_t)ret;
+    }
+    close(fd);
+  }
+
+  if(got == len) return;
+  LOG_WARN("no system entropy, falling back to random()");
+  while(got < len) bytes[got++] = (uint8_t)random();
+}
+
 #ifdef DEBUG
 static int _logging = 1;
 #else
@@ -0,0 +1,192 @@
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+
+#include <pthread.h>
+#include <string.h>
+#include "telehash.h"
+#include "util_workers.h"
+
+struct util_workers_struct
+{
+  mesh_t mesh;
+  pthread_t *threads;
+  uint8_t count;
+  uint8_t stop;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  lob_t todo; // encrypted outers
+  lob_t done; // decrypted inners, linked to their outer
+  uint32_t pending;
+  struct util_workers_struct *next;
+};
+
+// the mesh callback only gets the mesh, find our pool from it
+static util_workers_t workers_all = NULL;
+static pthread_mutex_t workers_all_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *workers_run(void *arg)
+{
+  util_workers_t w = (util_workers_t)arg;
+  lob_t outer, inner;
+  uint8_t csid;
+
+  pthread_mutex_lock(&w->lock);
+  while(!w->stop)
+  {
+    if(!(outer = w->todo))
+    {
+      pthread_cond_wait(&w->wake, &w->lock);
+      continue;
+    }
+    w->todo = lob_splice(w->todo, outer);
+    pthread_mutex_unlock(&w->lock);
+
+    // the curve math, self is read-only once loaded
+    csid = outer->head[0];
+    if((inner = e3x_self_decrypt(w->mesh->self, outer))) lob_link(inner, outer);
+    else lob_free(outer);
+
+    pthread_mutex_lock(&w->lock);
+    if(inner) w->done = lob_push(w->done, inner);
+    else{
+      LOG_WARN("%02x handshake failed %s",csid,e3x_err());
+      w->pending--;
+    }
+  }
+  pthread_mutex_unlock(&w->lock);
+
+  return NULL;
+}
+
+static lob_t workers_handshake(mesh_t mesh, lob_t outer)
+{
+  util_workers_t w;
+
+  pthread_mutex_lock(&workers_all_lock);
+  for(w = workers_all; w && w->mesh != mesh; w = w->next);
+  pthread_mutex_unlock(&workers_all_lock);
+  if(!w) return outer;
+
+  pthread_mutex_lock(&w->lock);
+  if(w->pending >= UTIL_WORKERS_QUEUE)
+  {
+    pthread_mutex_unlock(&w->lock);
+    LOG_WARN("handshake queue full, dropping");
+    lob_free(outer);
+    return NULL;
+  }
+  w->todo = lob_push(w->todo, outer);
+  w->pending++;
+  pthread_cond_signal(&w->wake);
+  pthread_mutex_unlock(&w->lock);
+
+  return NULL;
+}
+
+util_workers_t util_workers_new(mesh_t mesh, uint8_t threads)
+{
+  util_workers_t w;
+  uint8_t i;
+
+  if(!mesh || !mesh->self || !threads) return LOG("bad args");
+
+  if(!(w = malloc(sizeof (struct util_workers_struct)))) return LOG("OOM");
+  memset(w,0,sizeof (struct util_workers_struct));
+  if(!(w->threads = malloc(threads * sizeof (pthread_t))))
+  {
+    free(w);
+    return LOG("OOM");
+  }
+  w->mesh = mesh;
+  pthread_mutex_init(&w->lock, NULL);
+  pthread_cond_init(&w->wake, NULL);
+
+  for(i = 0; i < threads; i++)
+  {
+    if(pthread_create(&w->threads[i], NULL, workers_run, w) != 0) break;
+    w->count++;
+  }
+  if(!w->count)
+  {
+    LOG_WARN("no worker threads started");
+    return util_workers_free(w);
+  }
+
+  pthread_mutex_lock(&workers_all_lock);
+  w->next = workers_all;
+  workers_all = w;
+  pthread_mutex_unlock(&workers_all_lock);
+
+  mesh_on_handshake(mesh, "util_workers", workers_handshake);
+  LOG_INFO("started %u handshake workers",w->count);
+
+  return w;
+}
+
+util_workers_t util_workers_free(util_workers_t w)
+{
+  util_workers_t *prev;
+  uint8_t i;
+
+  if(!w) return NULL;
+
+  pthread_mutex_lock(&workers_all_lock);
+  for(prev = &workers_all; *prev; prev = &((*prev)->next)) if(*prev == w)
+  {
+    *prev = w->next;
+    break;
+  }
+  pthread_mutex_unlock(&workers_all_lock);
+
+  pthread_mutex_lock(&w->lock);
+  w->stop = 1;
+  pthread_cond_broadcast(&w->wake);
+  pthread_mutex_unlock(&w->lock);
+  for(i = 0; i < w->count; i++) pthread_join(w->threads[i], NULL);
+
+  lob_freeall(w->todo);
+  lob_freeall(w->done);
+  pthread_cond_destroy(&w->wake);
+  pthread_mutex_destroy(&w->lock);
+  free(w->threads);
+  free(w);
+  return NULL;
+}
+
+uint32_t util_workers_process(util_workers_t w)
+{
+  lob_t done, inner;
+  uint32_t count = 0;
+
+  if(!w) return 0;
+
+  pthread_mutex_lock(&w->lock);
+  done = w->done;
+  w->done = NULL;
+  pthread_mutex_unlock(&w->lock);
+
+  // link state is only ever touched here on the mesh thread
+  while((inner = done))
+  {
+    done = lob_splice(done, inner);
+    mesh_receive_handshake(w->mesh, inner);
+    count++;
+  }
+
+  pthread_mutex_lock(&w->lock);
+  w->pending -= count;
+  pthread_mutex_unlock(&w->lock);
+
+  return count;
+}
+
+uint32_t util_workers_pending(util_workers_t w)
+{
+  uint32_t pending;
+  if(!w) return 0;
+  pthread_mutex_lock(&w->lock);
+  pending = w->pending;
+  pthread_mutex_unlock(&w->lock);
+  return pending;
+}
+
+#endif // POSIX
@@ -54,12 +54,82 @@ util_chunks_t util_chunks_new(uint8_t size)
 util_chunks_t util_chunks_free(util_chunks_t chunks)
 {
   if(!chunks) return NULL;
-  if(chunks->writing) lob_free(chunks->writing);
+  if(chunks->writing) lob_freeall(chunks->writing);
   util_chunk_free(chunks->reading);
+  lob_freeall(chunks->ready);
+  free(chunks->readbuf);
   free(chunks);
   return NULL;
 }
 
+util_chunks_t util_chunks_stream(util_chunks_t chunks, uint8_t stream)
+{
+  if(!chunks) return LOG("bad args");
+  if(chunks->writing || chunks->reading || chunks->readbuf) return LOG("can't switch modes w/ data in progress");
+  chunks->stream = (stream) ? 1 : 0;
+  chunks->blocked = 0;
+  return chunks;
+}
+
+// parse as much of the block as possible, each packet is allocated once its length is known and filled in place
+static util_chunks_t stream_read(util_chunks_t chunks, uint8_t *block, size_t len)
+{
+  // once framing is lost nothing after it can be trusted
+  if(chunks->err) return LOG("stream framing error");
+  while(len)
+  {
+    // varint length first
+    if(!chunks->readbuf)
+    {
+      uint8_t byte = *block++;
+      len--;
+      // only 4 of 32 bits are left for a 5th byte, and it has to be the last
+      if(chunks->readbits >= 28 && byte > 0x0f)
+      {
+        chunks->err = 1;
+        return LOG("varint too long");
+      }
+      chunks->readlen |= (uint32_t)(byte & 0x7f) << chunks->readbits;
+      chunks->readbits += 7;
+      if(byte & 0x80) continue;
+
+      chunks->readbits = 0;
+      if(!chunks->readlen) continue; // empty keepalive
+      if(chunks->readlen > UTIL_CHUNKS_STREAM_MAX)
+      {
+        chunks->err = 1;
+        return LOG("packet too large %lu",chunks->readlen);
+      }
+      if(!(chunks->readbuf = malloc(chunks->readlen)))
+      {
+        chunks->err = 1;
+        return LOG("OOM");
+      }
+      chunks->readgot = 0;
+      continue;
+    }
+
+    size_t want = chunks->readlen - chunks->readgot;
+    if(want > len) want = len;
+    memcpy(chunks->readbuf+chunks->readgot,block,want);
+    chunks->readgot += want;
+    block += want;
+    len -= want;
+    if(chunks->readgot < chunks->readlen) break;
+
+    lob_t packet = lob_adopt(chunks->readbuf,chunks->readlen);
+    chunks->readbuf = NULL;
+    chunks->readlen = chunks->readgot = 0;
+    if(!packet)
+    {
+      chunks->err = 1;
+      return LOG("packet parsing failed");
+    }
+    chunks->ready = lob_push(chunks->ready,packet);
+  }
+  return chunks;
+}
+
 uint32_t util_chunks_writing(util_chunks_t chunks)
 {
   lob_t cur;
@@ -86,6 +156,15 @@ lob_t util_chunks_receive(util_chunks_t chunks)
   util_chunk_t chunk, flush;
   size_t len = 0;
 
+  if(chunks && chunks->stream)
+  {
+    if(!chunks->ready) return NULL;
+    lob_t packet = lob_shift(chunks->ready);
+    chunks->ready = packet->next;
+    packet->next = NULL;
+    return packet;
+  }
+
   if(!chunks || !chunks->reading) return NULL;
   
   // add up total length of any sequence
@@ -180,6 +259,23 @@ uint32_t util_chunks_len(util_chunks_t chunks)
 {
   if(!chunks || chunks->blocked) return 0;
 
+  // stream mode writes the varint header then the whole raw packet
+  if(chunks->stream)
+  {
+    if(!chunks->writing) return 0;
+    if(!chunks->headlen)
+    {
+      uint32_t len = lob_len(chunks->writing);
+      do {
+        chunks->head[chunks->headlen] = (len & 0x7f) | ((len > 0x7f) ? 0x80 : 0);
+        chunks->headlen++;
+        len >>= 7;
+      }while(len);
+    }
+    if(chunks->headat < chunks->headlen) return chunks->headlen - chunks->headat;
+    return lob_len(chunks->writing) - chunks->writeat;
+  }
+
   // when no packet, only send an ack
   if(!chunks->writing) return (chunks->ack) ? 1 : 0;
 
@@ -201,6 +297,12 @@ uint8_t *util_chunks_write(util_chunks_t chunks)
 {
   // ensures consistency
   if(!util_chunks_len(chunks)) return NULL;
+
+  if(chunks->stream)
+  {
+    if(chunks->headat < chunks->headlen) return chunks->head+chunks->headat;
+    return lob_raw(chunks->writing)+chunks->writeat;
+  }
   
   // always write the chunk size byte first, is also the ack/flush
   if(!chunks->waitat) return &chunks->waiting;
@@ -209,11 +311,27 @@ uint8_t *util_chunks_write(util_chunks_t chunks)
   return lob_raw(chunks->writing)+chunks->writeat+(chunks->waitat-1);
 }
 
-// advance the write pointer this far
-util_chunks_t util_chunks_written(util_chunks_t chunks, size_t len)
+// advance the write pointer within the current span
+static util_chunks_t chunks_written(util_chunks_t chunks, size_t len)
 {
-  if(!chunks || !len) return chunks;
-  if(len > util_chunks_len(chunks)) return LOG("len too big %d > %d",len,util_chunks_len(chunks));
+
+  if(chunks->stream)
+  {
+    if(chunks->headat < chunks->headlen)
+    {
+      chunks->headat += len;
+      return chunks;
+    }
+    chunks->writeat += len;
+    if(chunks->writeat < lob_len(chunks->writing)) return chunks;
+    lob_t old = lob_shift(chunks->writing);
+    chunks->writing = old->next;
+    old->next = NULL;
+    lob_free(old);
+    chunks->writeat = 0;
+    chunks->headlen = chunks->headat = 0;
+    return chunks;
+  }
   chunks->waitat += len;
   chunks->ack = 0; // any write is an ack
 
@@ -223,6 +341,7 @@ util_chunks_t util_chunks_written(util_chunks_t chunks, size_t len)
   if(chunks->waitat > chunks->waiting)
   {
     // confirm we wrote the chunk data and size
+    uint8_t size = chunks->waiting;
     chunks->writeat += chunks->waiting;
     chunks->waiting = chunks->waitat = 0;
 
@@ -230,7 +349,7 @@ util_chunks_t util_chunks_written(util_chunks_t chunks, size_t len)
     if(chunks->waiting == chunks->cap) chunks->blocked = chunks->blocking;
 
     // only advance packet after we wrote a flushing 0
-    if(len == 1 && chunks->writing && chunks->writeat == lob_len(chunks->writing))
+    if(!size && chunks->writing && chunks->writeat == lob_len(chunks->writing))
     {
       lob_t old = lob_shift(chunks->writing);
       chunks->writing = old->next;
@@ -245,9 +364,109 @@ util_chunks_t util_chunks_written(util_chunks_t chunks, size_t len)
   return chunks;
 }
 
+// advance the write pointer this far, across spans
+util_chunks_t util_chunks_written(util_chunks_t chunks, size_t len)
+{
+  uint32_t span;
+  if(!chunks || !len) return chunks;
+  while(len)
+  {
+    if(!(span = util_chunks_len(chunks))) return LOG("len too big, %d more than pending",len);
+    if(span > len) span = len;
+    if(!chunks_written(chunks, span)) return NULL;
+    len -= span;
+  }
+  return chunks;
+}
+
+#ifdef UTIL_CHUNKS_IOV
+int util_chunks_iov(util_chunks_t chunks, struct iovec *iov, int max)
+{
+  int n = 0, h = 0;
+  uint32_t len, at, size;
+  lob_t cur;
+
+  if(!chunks || !iov || max < 1 || !util_chunks_len(chunks)) return 0;
+  if(max > UTIL_CHUNKS_IOV) max = UTIL_CHUNKS_IOV;
+
+  // current span as-is
+  iov[n].iov_base = util_chunks_write(chunks);
+  iov[n].iov_len = util_chunks_len(chunks);
+  n++;
+
+  if(chunks->stream)
+  {
+    // rest of this packet, then header and raw of each after it
+    if(chunks->headat < chunks->headlen && n < max)
+    {
+      iov[n].iov_base = lob_raw(chunks->writing);
+      iov[n].iov_len = lob_len(chunks->writing);
+      n++;
+    }
+    for(cur = lob_next(chunks->writing); cur && (n + 2) <= max; cur = lob_next(cur))
+    {
+      uint8_t *head = chunks->iohead[h++];
+      len = lob_len(cur);
+      size = 0;
+      do {
+        head[size++] = (len & 0x7f) | ((len > 0x7f) ? 0x80 : 0);
+        len >>= 7;
+      }while(len);
+      iov[n].iov_base = head;
+      iov[n].iov_len = size;
+      iov[n+1].iov_base = lob_raw(cur);
+      iov[n+1].iov_len = lob_len(cur);
+      n += 2;
+    }
+    return n;
+  }
+
+  // nothing but an ack
+  if(!chunks->writing) return n;
+
+  // size byte is out, add its data too
+  if(!chunks->waitat && chunks->waiting && n < max)
+  {
+    iov[n].iov_base = lob_raw(chunks->writing)+chunks->writeat;
+    iov[n].iov_len = chunks->waiting;
+    n++;
+  }
+
+  // each following chunk is a size byte and its data, up to the terminating zero one
+  cur = chunks->writing;
+  at = chunks->writeat + chunks->waiting;
+  if(!chunks->waiting) return n; // current span was the terminator
+  while(cur && h < UTIL_CHUNKS_IOV && (n + 2) <= max)
+  {
+    len = lob_len(cur);
+    size = ((len - at) > chunks->cap) ? chunks->cap : (len - at);
+    chunks->iohead[h][0] = size;
+    iov[n].iov_base = chunks->iohead[h++];
+    iov[n].iov_len = 1;
+    n++;
+    if(size)
+    {
+      iov[n].iov_base = lob_raw(cur)+at;
+      iov[n].iov_len = size;
+      n++;
+      at += size;
+      continue;
+    }
+
+    // packet done, the next one only when not waiting on an ack
+    if(chunks->blocking) break;
+    cur = lob_next(cur);
+    at = 0;
+  }
+
+  return n;
+}
+#endif
+
 // queues incoming stream based data
 util_chunks_t util_chunks_read(util_chunks_t chunks, uint8_t *block, size_t len)
 {
+  if(chunks && chunks->stream) return (block) ? stream_read(chunks,block,len) : NULL;
   if(!_util_chunks_append(chunks,block,len)) return NULL;
   if(!chunks->reading) return NULL; // paranoid
   return chunks;
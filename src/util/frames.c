@@ -7,29 +7,119 @@
 // max payload size per frame
 #define PAYLOAD(f) (f->size - 4)
 
-// one malloc per frame, put storage after it
-util_frames_t util_frame_new(util_frames_t frames)
+// frame check, same chaining either way
+#define HASH(f,d,l) ((f->crc) ? crc32c(d,l) : murmur4(d,l))
+
+// windowed frames carry a frame number and tail length after the data
+#define WPAYLOAD(f) (PAYLOAD(f) - 3)
+
+// parity frames are told apart from data (~hash) and meta (hash) frames
+#define PARITY(h) ((h) ^ 0x5a5a5a5a)
+
+// running xor of one parity group being received
+typedef struct frames_fec_struct
 {
-  util_frame_t frame;
-  size_t size = sizeof (struct util_frame_struct);
-  size += PAYLOAD(frames);
-  if(!(frame = malloc(size))) return LOG_WARN("OOM");
-  memset(frame,0,size);
-  
-  // add to inbox
-  frame->prev = frames->cache;
-  frames->cache = frame;
-  frames->in++;
+  uint16_t first; // first frame number in the group
+  uint16_t got; // data frames xor'd in
+  uint8_t parity; // parity frame xor'd in
+  uint8_t bytes[];
+} *frames_fec_t;
+
+#define FECS(f) ((UTIL_FRAMES_WINDOW / f->fec) + 2)
+#define FEC_SIZE(f) (sizeof(struct frames_fec_struct) + PAYLOAD(f))
 
+// hash of the last received frame
+#define INLAST(f) ((f->in)?f->hashes[f->in-1]:f->inbase)
+
+// make room to cache need bytes and slots hashes, doubling so a packet costs O(log n) reallocs
+// the total length isn't known until the tail, so each realloc may still copy what's cached so far
+static util_frames_t frames_grow(util_frames_t frames, uint32_t need, uint16_t slots)
+{
+  if(frames->cachelen < need)
+  {
+    uint32_t len = (frames->cachelen) ? frames->cachelen : (uint32_t)(PAYLOAD(frames) * 8);
+    while(len < need) len *= 2;
+    uint8_t *cache = realloc(frames->cache, len);
+    if(!cache) return LOG_WARN("OOM");
+    frames->cache = cache;
+    frames->cachelen = len;
+  }
+  if(frames->hashlen < slots)
+  {
+    uint16_t len = (frames->hashlen) ? frames->hashlen : 16;
+    while(len < slots) len *= 2;
+    uint32_t *hashes = realloc(frames->hashes, len * sizeof(uint32_t));
+    if(!hashes) return LOG_WARN("OOM");
+    frames->hashes = hashes;
+    frames->hashlen = len;
+  }
   return frames;
 }
 
-util_frame_t util_frame_free(util_frame_t frame)
+// the first tlen bytes of the cache become the packet, keeping any bytes from next on for the following one
+// no copy into the packet itself, but giving back large slack is a realloc that may move it
+static util_frames_t frames_adopt(util_frames_t frames, size_t tlen, uint32_t next)
 {
-  if(!frame) return NULL;
-  util_frame_t prev = frame->prev;
-  free(frame);
-  return util_frame_free(prev);
+  uint8_t *buf = frames->cache;
+  uint8_t *rest = NULL;
+  uint32_t restlen = 0;
+
+  // frames already here for the next packet move to their own cache
+  if(next < frames->cachelen && frames->window && frames->inmask)
+  {
+    restlen = frames->cachelen - next;
+    if(!(rest = malloc(restlen))) return LOG_WARN("OOM");
+    memcpy(rest,buf+next,restlen);
+  }
+
+  // give back any large slack before the packet keeps it
+  if(frames->cachelen > (tlen * 2) && tlen) buf = realloc(buf, tlen);
+  if(!buf) buf = frames->cache;
+  frames->cache = rest;
+  frames->cachelen = restlen;
+
+  // the cache becomes the packet
+  lob_t packet = lob_adopt(buf,tlen);
+  if(!packet) LOG_WARN("packet parsing failed, %lu bytes",tlen);
+  frames->inbox = lob_push(frames->inbox,packet);
+  return frames;
+}
+
+// windowed mode, frames are numbered so several packets can be in flight and only the missing ones are resent
+//   data frame: [data][frame number 2][tail len 1][~hash 4], a non-zero tail ends the packet
+//   meta frame: [next expected 2][highest+1 offset 1][their next 2][received bitmap 4][more 1][meta][hash 4]
+
+// number of frames a packet takes
+static uint16_t window_count(util_frames_t frames, lob_t packet)
+{
+  uint32_t len = lob_len(packet);
+  return (uint16_t)((len + WPAYLOAD(frames) - 1) / WPAYLOAD(frames));
+}
+
+// find the outbox packet and offset for a frame number, NULL when not queued yet
+static lob_t window_frame(util_frames_t frames, uint16_t seq, uint32_t *at)
+{
+  uint16_t off = seq - frames->outseq;
+  lob_t cur;
+  for(cur = frames->outbox; cur; cur = lob_next(cur))
+  {
+    uint16_t count = window_count(frames, cur);
+    if(off < count)
+    {
+      *at = off * WPAYLOAD(frames);
+      return cur;
+    }
+    off -= count;
+  }
+  return NULL;
+}
+
+// a new frame can go out
+static bool window_open(util_frames_t frames)
+{
+  uint32_t at;
+  if((uint16_t)(frames->outnext - frames->outack) >= frames->window) return false;
+  return (window_frame(frames, frames->outnext, &at)) ? true : false;
 }
 
 util_frames_t util_frames_clear(util_frames_t frames)
@@ -38,11 +128,52 @@ util_frames_t util_frames_clear(util_frames_t frames)
   frames->err = 0;
   frames->inbase = frames->outbase = 42;
   frames->in = frames->out = 0;
-  frames->cache = util_frame_free(frames->cache);
+  free(frames->cache);
+  frames->cache = NULL;
+  frames->cachelen = 0;
+  frames->inmask = frames->resend = 0;
+  frames->inseq = frames->inmax = 0;
+  frames->outseq = frames->outack = frames->outnext = 0;
+  frames->parity = 0;
+  if(frames->fecs) memset(frames->fecs,0,FECS(frames) * FEC_SIZE(frames));
   frames->flush = 1; // always force a flush after a clear to let the other party know
   return frames;
 }
 
+util_frames_t util_frames_crc(util_frames_t frames, uint8_t crc)
+{
+  if(!frames) return LOG_WARN("bad args");
+  frames->crc = (crc) ? 1 : 0;
+  util_frames_clear(frames);
+  frames->flush = 0;
+  return frames;
+}
+
+util_frames_t util_frames_window(util_frames_t frames, uint8_t window)
+{
+  if(!frames) return LOG_WARN("bad args");
+  if(window > UTIL_FRAMES_WINDOW) return LOG_WARN("window too large: %u",window);
+  if(window && WPAYLOAD(frames) < 16) return LOG_WARN("frame size too small for windowing: %u",frames->size);
+  frames->window = window;
+  util_frames_clear(frames);
+  frames->flush = 0;
+  return frames;
+}
+
+util_frames_t util_frames_fec(util_frames_t frames, uint8_t group)
+{
+  if(!frames) return LOG_WARN("bad args");
+  if(group && !frames->window) return LOG_WARN("fec requires windowed mode");
+  if(group && (group < 2 || group > 16 || (group & (group - 1)))) return LOG_WARN("invalid fec group: %u",group);
+  free(frames->fecs);
+  frames->fecs = NULL;
+  frames->fec = group;
+  if(group && !(frames->fecs = malloc(FECS(frames) * FEC_SIZE(frames)))) return LOG_WARN("OOM");
+  util_frames_clear(frames);
+  frames->flush = 0;
+  return frames;
+}
+
 util_frames_t util_frames_new(uint8_t size)
 {
   if(size < 16 || size > 128) return LOG_ERROR("invalid size: %u",size);
@@ -63,7 +194,9 @@ util_frames_t util_frames_free(util_frames_t frames)
   if(!frames) return NULL;
   lob_freeall(frames->inbox);
   lob_freeall(frames->outbox);
-  util_frame_free(frames->cache);
+  free(frames->cache);
+  free(frames->hashes);
+  free(frames->fecs);
   free(frames);
   return NULL;
 }
@@ -133,7 +266,13 @@ size_t util_frames_outlen(util_frames_t frames)
   }while(cur);
   
   // subtract sent
-  if(frames->outbox) len -= frames->outbox->id;
+  if(frames->window && frames->outbox)
+  {
+    uint32_t acked = (uint16_t)(frames->outack - frames->outseq) * WPAYLOAD(frames);
+    len -= (acked > lob_len(frames->outbox)) ? lob_len(frames->outbox) : acked;
+  }else if(frames->outbox){
+    len -= frames->outbox->id;
+  }
   
   return len;
 }
@@ -157,9 +296,11 @@ util_frames_t util_frames_await(util_frames_t frames)
   // last status from them
   if(frames->more) return frames;
   // need more to complete inbox
-  if(frames->cache) return frames;
+  if(frames->in || frames->inmask) return frames;
+  // windowed frames not acked yet
+  if(frames->window) return (frames->outack != frames->outnext) ? frames : NULL;
   // outbox is complete, awaiting flush
-  if((frames->out * PAYLOAD(frames)) > lob_len(frames->outbox)) return frames;
+  if((uint32_t)(frames->out * PAYLOAD(frames)) > lob_len(frames->outbox)) return frames;
   return NULL;
 }
 
@@ -170,6 +311,7 @@ util_frames_t util_frames_pending(util_frames_t frames)
   if(frames->err) return LOG_WARN("frame state error");
   
   if(frames->flush) return frames;
+  if(frames->window) return (frames->parity || frames->resend || window_open(frames)) ? frames : NULL;
 
   uint8_t size = PAYLOAD(frames);
   uint32_t len = lob_len(frames->outbox); 
@@ -182,19 +324,314 @@ util_frames_t util_frames_pending(util_frames_t frames)
   return NULL;
 }
 
+static util_frames_t window_data(util_frames_t frames, uint8_t *data, bool fec);
+static util_frames_t window_fec(util_frames_t frames, uint8_t *data, bool parity);
+
+static util_frames_t window_inbox(util_frames_t frames, uint8_t *data, uint8_t *meta)
+{
+  uint8_t size = PAYLOAD(frames);
+  uint32_t hash1, hash2 = HASH(frames,data,size);
+  uint16_t inack = frames->inseq + frames->in;
+  memcpy(&hash1,data+size,4);
+
+  if(hash1 == hash2)
+  {
+    if(meta) memcpy(meta,data+10,size-10);
+
+    // their acks for what we've sent
+    uint16_t ack, next;
+    uint32_t bits;
+    memcpy(&ack,data,2);
+    memcpy(&next,data+3,2);
+    memcpy(&bits,data+5,4);
+    uint16_t adv = ack - frames->outack;
+    uint16_t flight = frames->outnext - frames->outack;
+    if((int16_t)adv < 0)
+    {
+      // reordered or late, everything it says is already known
+      LOG_DEBUG("ignoring stale ack %u behind %u",ack,frames->outack);
+      return frames;
+    }
+    if(adv > flight)
+    {
+      LOG_WARN("invalid ack %u outside of %u+%u",ack,frames->outack,flight);
+      frames->err = 1;
+      return NULL;
+    }
+    frames->outack = ack;
+    flight -= adv;
+    frames->resend = (adv < 64) ? (frames->resend >> adv) : 0;
+
+    // anything missing below the highest they've seen is lost, bit0 (ack itself) always is
+    uint64_t acked = ((uint64_t)bits) << 1;
+    uint8_t lost = data[2], i;
+    if(lost > flight) lost = flight;
+    for(i = 0; i < lost; i++) if(!(acked & (1ULL << i))) frames->resend |= (1ULL << i);
+    frames->resend &= ~acked;
+
+    // done with any fully acked packets
+    while(frames->outbox)
+    {
+      uint16_t count = window_count(frames, frames->outbox);
+      if((uint16_t)(frames->outack - frames->outseq) < count) break;
+      frames->outseq += count;
+      lob_t done = lob_shift(frames->outbox);
+      frames->outbox = done->next;
+      done->next = NULL;
+      lob_free(done);
+    }
+
+    // if they've sent more than we have, let them know what's missing
+    uint16_t ahead = next - inack;
+    if(ahead && ahead <= UTIL_FRAMES_WINDOW)
+    {
+      if((uint16_t)(frames->inmax - inack) < ahead) frames->inmax = next;
+      frames->flush = 1;
+    }
+
+    frames->more = (data[9])?1:0;
+    return frames;
+  }
+
+  if(hash1 == ~hash2) return window_data(frames, data, true);
+  if(frames->fec && hash1 == PARITY(hash2)) return window_fec(frames, data, true);
+  return LOG_DEBUG("invalid frame hash %lu",hash1);
+}
+
+// a valid data frame, fec is false when it was rebuilt from parity
+static util_frames_t window_data(util_frames_t frames, uint8_t *data, bool fec)
+{
+  uint8_t dsize = WPAYLOAD(frames);
+  uint16_t inack = frames->inseq + frames->in;
+  uint16_t seq;
+
+  uint8_t tail = data[dsize+2];
+  if(tail > dsize) return LOG_DEBUG("invalid tail %u > %u",tail,dsize);
+  memcpy(&seq,data+dsize,2);
+
+  // dedup anything already here or outside the window
+  uint16_t off = seq - frames->inseq;
+  if(off < frames->in) return frames;
+  uint16_t gap = off - frames->in;
+  if(gap >= frames->window) return frames;
+  if(frames->inmask & (1ULL << gap)) return frames;
+
+  // stored at its place in the packet, hashes hold the tail
+  if(!frames_grow(frames, (off + 1) * dsize, off + 1)) return NULL;
+  memcpy(frames->cache+(off*dsize),data,dsize);
+  frames->hashes[off] = tail;
+  frames->inmask |= (1ULL << gap);
+  if((uint16_t)(seq + 1 - inack) > (uint16_t)(frames->inmax - inack)) frames->inmax = seq + 1;
+  if(gap) frames->flush = 1; // tell them about the hole
+
+  // advance through everything in order, finishing packets along the way
+  while(frames->inmask & 1)
+  {
+    frames->inmask >>= 1;
+    frames->in++;
+    tail = frames->hashes[frames->in-1];
+
+    // ack every half window w/o waiting on a gap or the end of the packet
+    if(!(frames->in % ((frames->window > 1) ? frames->window / 2 : 1))) frames->flush = 1;
+    if(!tail) continue;
+
+    size_t tlen = ((frames->in - 1) * dsize) + tail;
+    uint16_t in = frames->in;
+    frames->inseq += in;
+    frames->in = 0;
+    frames->flush = 1;
+    frames->more = 0;
+    if(frames->inmask) memmove(frames->hashes, frames->hashes+in, (frames->hashlen - in) * sizeof(uint32_t));
+    if(!frames_adopt(frames, tlen, in * dsize)) return NULL;
+  }
+
+  if(fec && frames->fec) return window_fec(frames, data, false);
+  return frames;
+}
+
+// xor a data or parity frame into its group, rebuilding the one missing data frame once possible
+static util_frames_t window_fec(util_frames_t frames, uint8_t *data, bool parity)
+{
+  uint8_t dsize = WPAYLOAD(frames);
+  uint16_t first, i;
+  memcpy(&first,data+dsize,2);
+  first -= first % frames->fec;
+  frames_fec_t fec = (frames_fec_t)(frames->fecs + ((first / frames->fec) % FECS(frames)) * FEC_SIZE(frames));
+
+  // a new group takes over the slot
+  if(fec->first != first)
+  {
+    memset(fec,0,FEC_SIZE(frames));
+    fec->first = first;
+  }
+
+  if(parity)
+  {
+    if(fec->parity) return frames;
+    fec->parity = 1;
+  }else{
+    uint16_t seq;
+    memcpy(&seq,data+dsize,2);
+    fec->got |= (1 << (seq - first));
+  }
+  for(i = 0; i < dsize; i++) fec->bytes[i] ^= data[i];
+  fec->bytes[dsize+2] ^= data[dsize+2];
+
+  // all but one data frame and the parity
+  uint16_t all = (1 << frames->fec) - 1;
+  if(!fec->parity || fec->got == all) return frames;
+  uint16_t missing = all & ~fec->got;
+  if(missing & (missing - 1)) return frames;
+  for(i = 0; !(missing & (1 << i)); i++);
+
+  uint8_t frame[128];
+  uint16_t seq = first + i;
+  memcpy(frame,fec->bytes,dsize);
+  memcpy(frame+dsize,&seq,2);
+  frame[dsize+2] = fec->bytes[dsize+2];
+  fec->got = all;
+  LOG_DEBUG("rebuilt frame %u from parity",seq);
+  return window_data(frames, frame, false);
+}
+
+// what goes out next: 0 meta, 1 parity, 2 resend, 3 new frame
+static uint8_t window_next(util_frames_t frames, uint16_t *seq)
+{
+  uint32_t at;
+  if(frames->flush) return 0;
+
+  // parity right after its group, unless the group is already acked
+  if(frames->parity)
+  {
+    *seq = frames->outnext - frames->fec;
+    if(window_frame(frames, *seq, &at)) return 1;
+    frames->parity = 0;
+  }
+
+  // oldest resend first, then any new frame
+  if(frames->resend)
+  {
+    uint8_t i = 0;
+    while(!(frames->resend & (1ULL << i))) i++;
+    *seq = frames->outack + i;
+    return 2;
+  }
+  if(window_open(frames))
+  {
+    *seq = frames->outnext;
+    return 3;
+  }
+  return 0;
+}
+
+// a data frame w/o its hash
+static util_frames_t window_fill(util_frames_t frames, uint16_t seq, uint8_t *data)
+{
+  uint8_t dsize = WPAYLOAD(frames);
+  uint32_t at;
+  lob_t packet = window_frame(frames, seq, &at);
+  if(!packet) return NULL;
+  uint32_t len = lob_len(packet);
+  uint8_t chunk = ((len - at) > dsize) ? dsize : (uint8_t)(len - at);
+  memcpy(data,lob_raw(packet)+at,chunk);
+  memcpy(data+dsize,&seq,2);
+  if(at + chunk == len) data[dsize+2] = chunk;
+  return frames;
+}
+
+static util_frames_t window_outbox(util_frames_t frames, uint8_t *data, uint8_t *meta)
+{
+  uint8_t size = PAYLOAD(frames);
+  uint8_t dsize = WPAYLOAD(frames);
+  uint32_t hash;
+  uint16_t seq = 0, i, j;
+  uint8_t next = window_next(frames, &seq);
+
+  memset(data,0,size+4);
+
+  // nothing to send, just our state
+  if(!next)
+  {
+    frames->flush = 1; // so _sent() does us proper
+    uint16_t inack = frames->inseq + frames->in;
+    uint32_t bits = (uint32_t)(frames->inmask >> 1);
+    memcpy(data,&inack,2);
+    data[2] = frames->inmax - inack;
+    memcpy(data+3,&(frames->outnext),2);
+    memcpy(data+5,&bits,4);
+    if(frames->outbox) data[9] = 1; // flag we have more to send
+    if(meta) memcpy(data+10,meta,size-10);
+    uint32_t check = HASH(frames,data,size);
+    memcpy(data+size,&check,4);
+    LOG_CRAZY("sending meta frame ack %u next %u",inack,frames->outnext);
+    return frames;
+  }
+
+  // xor of the group, w/ its first frame number in place of one
+  if(next == 1)
+  {
+    uint8_t frame[128];
+    for(i = 0; i < frames->fec; i++)
+    {
+      memset(frame,0,size);
+      window_fill(frames, seq + i, frame);
+      for(j = 0; j < size; j++) data[j] ^= frame[j];
+    }
+    memcpy(data+dsize,&seq,2);
+    hash = PARITY(HASH(frames,data,size));
+    memcpy(data+size,&hash,4);
+    LOG_CRAZY("sending parity frame %u",seq);
+    return frames;
+  }
+
+  window_fill(frames, seq, data);
+  hash = ~HASH(frames,data,size);
+  memcpy(data+size,&hash,4);
+  LOG_CRAZY("sending data frame %u",seq);
+
+  return frames;
+}
+
+static util_frames_t window_sent(util_frames_t frames)
+{
+  uint16_t seq;
+
+  // same choice as _outbox()
+  switch(window_next(frames, &seq))
+  {
+    case 0:
+      frames->flush = 0;
+      return NULL;
+    case 1:
+      frames->parity = 0;
+      break;
+    case 2:
+      frames->resend &= ~(1ULL << (uint16_t)(seq - frames->outack));
+      break;
+    case 3:
+      frames->outnext++;
+      if(frames->fec && !(frames->outnext % frames->fec)) frames->parity = 1;
+      break;
+  }
+
+  if(frames->parity || frames->resend || window_open(frames)) return frames;
+  return NULL;
+}
+
 // the next frame of data in/out, if data NULL bool is just ready check
 util_frames_t util_frames_inbox(util_frames_t frames, uint8_t *data, uint8_t *meta)
 {
   if(!frames) return LOG_WARN("bad args");
   if(frames->err) return LOG_WARN("frame state error");
   if(!data) return util_frames_await(frames);
+  if(frames->window) return window_inbox(frames, data, meta);
   
   // conveniences for code readability
   uint8_t size = PAYLOAD(frames);
   uint32_t hash1;
   memcpy(&(hash1),data+size,4);
-  uint32_t hash2 = murmur4(data,size);
-  uint32_t inlast = (frames->cache)?frames->cache->hash:frames->inbase;
+  uint32_t hash2 = HASH(frames,data,size);
+  uint32_t inlast = INLAST(frames);
   
 //  LOG("frame sz %u hash rx %lu check %lu",size,hash1,hash2);
   
@@ -212,7 +649,7 @@ util_frames_t util_frames_inbox(util_frames_t frames, uint8_t *data, uint8_t *me
     uint8_t *bin = lob_raw(frames->outbox);
     uint32_t len = lob_len(frames->outbox);
     uint32_t rxs = frames->outbase;
-    uint8_t next = 0;
+    uint16_t next = 0;
     do {
       // here next is always the frame to be re-sent, rxs is always the previous frame
       if(rxd == rxs)
@@ -223,7 +660,7 @@ util_frames_t util_frames_inbox(util_frames_t frames, uint8_t *data, uint8_t *me
 
       // handle tail hash correctly like sender
       uint32_t at = next * size;
-      rxs ^= murmur4((bin+at), ((at+size) > len) ? (len - at) : size);
+      rxs ^= HASH(frames,(bin+at), ((at+size) > len) ? (len - at) : size);
       rxs += next;
       if(len < size) break;
     }while((++next) && (next*size) <= len);
@@ -263,18 +700,19 @@ util_frames_t util_frames_inbox(util_frames_t frames, uint8_t *data, uint8_t *me
   
   // dedup, ignore if identical to any received one
   if(hash1 == frames->inbase) return frames;
-  util_frame_t cache = frames->cache;
-  for(;cache;cache = cache->prev) if(cache->hash == hash1) return frames;
+  uint16_t i;
+  for(i=0;i<frames->in;i++) if(frames->hashes[i] == hash1) return frames;
 
   // full data frames must match combined w/ previous
   hash2 ^= inlast;
   hash2 += frames->in;
   if(hash1 == hash2)
   {
-    if(!util_frame_new(frames)) return LOG_WARN("OOM");
+    if(!frames_grow(frames, (frames->in + 2) * size, frames->in + 1)) return NULL;
     // append, update inlast, continue
-    memcpy(frames->cache->data,data,size);
-    frames->cache->hash = hash1;
+    memcpy(frames->cache+(frames->in*size),data,size);
+    frames->hashes[frames->in] = hash1;
+    frames->in++;
     frames->flush = 0;
 //    LOG("got data frame %lu",hash1);
     return frames;
@@ -289,7 +727,7 @@ util_frames_t util_frames_inbox(util_frames_t frames, uint8_t *data, uint8_t *me
   }
   
   // hash must match
-  hash2 = murmur4(data,tail);
+  hash2 = HASH(frames,data,tail);
   hash2 ^= inlast;
   hash2 += frames->in;
   if(hash1 != hash2)
@@ -306,28 +744,12 @@ util_frames_t util_frames_inbox(util_frames_t frames, uint8_t *data, uint8_t *me
 
   size_t tlen = (frames->in * size) + tail;
 
-  // TODO make a lob_new that creates space to prevent double-copy here
-  uint8_t *buf = malloc(tlen);
-  if(!buf) return LOG_WARN("OOM");
-  
-  // copy in tail
-  memcpy(buf+(frames->in * size), data, tail);
-  
-  // eat cached frames copying in reverse
-  util_frame_t frame = frames->cache;
-  while(frames->in && frame)
-  {
-    frames->in--;
-    memcpy(buf+(frames->in*size),frame->data,size);
-    frame = frame->prev;
-  }
-  frames->cache = util_frame_free(frames->cache);
-  
-  lob_t packet = lob_parse(buf,tlen);
-  if(!packet) LOG_WARN("packet parsing failed: %s",util_hex(buf,tlen,NULL));
-  free(buf);
-  frames->inbox = lob_push(frames->inbox,packet);
-  return frames;
+  // append tail, the cache always has room for it
+  if(!frames_grow(frames, (frames->in + 1) * size, frames->in + 1)) return NULL;
+  memcpy(frames->cache+(frames->in * size), data, tail);
+  frames->in = 0;
+
+  return frames_adopt(frames, tlen, tlen);
 }
 
 util_frames_t util_frames_outbox(util_frames_t frames, uint8_t *data, uint8_t *meta)
@@ -335,6 +757,7 @@ util_frames_t util_frames_outbox(util_frames_t frames, uint8_t *data, uint8_t *m
   if(!frames) return LOG_WARN("bad args");
   if(frames->err) return LOG_WARN("frame state error");
   if(!data) return util_frames_waiting(frames); // just a ready check
+  if(frames->window) return window_outbox(frames, data, meta);
   uint8_t size = PAYLOAD(frames);
   uint8_t *out = lob_raw(frames->outbox);
   uint32_t len = lob_len(frames->outbox); 
@@ -349,7 +772,7 @@ util_frames_t util_frames_outbox(util_frames_t frames, uint8_t *data, uint8_t *m
     uint32_t at, i;
     for(i = at = 0;at < len && i < frames->out;i++,at += size)
     {
-      hash ^= murmur4((out+at), ((at - len) < size) ? (at - len) : size);
+      hash ^= HASH(frames,(out+at), ((at+size) > len) ? (len - at) : size);
       hash += i;
     }
   }
@@ -359,12 +782,13 @@ util_frames_t util_frames_outbox(util_frames_t frames, uint8_t *data, uint8_t *m
   {
     frames->flush = 1; // so _sent() does us proper
     memset(data,0,size+4);
-    uint32_t inlast = (frames->cache)?frames->cache->hash:frames->inbase;
+    uint32_t inlast = INLAST(frames);
     memcpy(data,&(inlast),4);
     memcpy(data+4,&(hash),4);
     if(len && (frames->out * size) <= len) data[8] = 1; // flag we have more to send
     if(meta) memcpy(data+10,meta,size-10);
-    murmur(data,size,data+size);
+    uint32_t check = HASH(frames,data,size);
+    memcpy(data+size,&check,4);
     LOG_CRAZY("sending meta frame inlast %lu cur %lu",inlast,hash);
     return frames;
   }
@@ -379,7 +803,7 @@ util_frames_t util_frames_outbox(util_frames_t frames, uint8_t *data, uint8_t *m
   }
   // TODO there's extra space in tail frames that could be used for meta
   memcpy(data,out+at,size);
-  hash ^= murmur4(data,size);
+  hash ^= HASH(frames,data,size);
   hash += frames->out;
   memcpy(data+PAYLOAD(frames),&(hash),4);
   LOG_CRAZY("sending data frame %u %lu",frames->out,hash);
@@ -392,6 +816,7 @@ util_frames_t util_frames_sent(util_frames_t frames)
 {
   if(!frames) return LOG_WARN("bad args");
   if(frames->err) return LOG_WARN("frame state error");
+  if(frames->window) return window_sent(frames);
   uint8_t size = PAYLOAD(frames);
   uint32_t len = lob_len(frames->outbox); 
   uint32_t at = frames->out * size;
@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <time.h>
+#include "chacha.h"
+#include "util.h"
+
+// chacha20 throughput for each kernel, knock sized frames and bulk buffers
+static double bench(uint8_t *key, uint8_t *nonce, uint8_t *buf, uint32_t len, uint32_t rounds)
+{
+  struct timespec a, b;
+  uint32_t i;
+  clock_gettime(CLOCK_MONOTONIC, &a);
+  for(i=0;i<rounds;i++) chacha20_counter(key, nonce, i, buf, buf, len);
+  clock_gettime(CLOCK_MONOTONIC, &b);
+  double secs = (double)(b.tv_sec - a.tv_sec) + (double)(b.tv_nsec - a.tv_nsec) / 1e9;
+  return ((double)len * rounds) / secs / (1024*1024);
+}
+
+int main(int argc, char **argv)
+{
+  static uint8_t buf[65536];
+  uint8_t key[32], nonce[8];
+  uint32_t sizes[] = {64, 1024, 16384, 65536};
+  char *names[] = {"scalar", "4-way", "8-way"};
+  uint8_t level, best = chacha20_kernel(255);
+  uint8_t s;
+
+  memset(key, 7, 32);
+  memset(nonce, 3, 8);
+  memset(buf, 0, sizeof(buf));
+
+  for(level=0;level<=best;level++)
+  {
+    chacha20_kernel(level);
+    for(s=0;s<sizeof(sizes)/sizeof(sizes[0]);s++)
+    {
+      printf("chacha20 %-6s %6u bytes %8.1f MB/s\n", names[level], sizes[s], bench(key, nonce, buf, sizes[s], (64*1024*1024) / sizes[s]));
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <time.h>
+#include "murmur.h"
+#include "crc32c.h"
+#include "util.h"
+
+// per frame check cost, murmur vs crc32c table and hardware
+static double bench(uint8_t kernel, uint8_t *buf, uint32_t len, uint32_t rounds)
+{
+  struct timespec a, b;
+  uint32_t i, sum = 0;
+  clock_gettime(CLOCK_MONOTONIC, &a);
+  for(i=0;i<rounds;i++)
+  {
+    buf[0] = (uint8_t)i;
+    sum += (kernel == 255) ? murmur4(buf, len) : crc32c(buf, len);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &b);
+  if(sum == 42) printf(" "); // keep the loop
+  double secs = (double)(b.tv_sec - a.tv_sec) + (double)(b.tv_nsec - a.tv_nsec) / 1e9;
+  return secs * 1e9 / rounds;
+}
+
+int main(int argc, char **argv)
+{
+  static uint8_t buf[1024];
+  uint32_t sizes[] = {16, 60, 124, 1024};
+  uint8_t best = crc32c_kernel(255);
+  uint8_t s;
+
+  memset(buf, 7, sizeof(buf));
+  for(s=0;s<sizeof(sizes)/sizeof(sizes[0]);s++)
+  {
+    double m = bench(255, buf, sizes[s], 1000000);
+    crc32c_kernel(0);
+    double t = bench(0, buf, sizes[s], 1000000);
+    crc32c_kernel(best);
+    double h = bench(1, buf, sizes[s], 1000000);
+    printf("%5u bytes murmur %6.1f ns crc32c table %6.1f ns %s %6.1f ns\n", sizes[s], m, t, best ? "hardware" : "(none)", h);
+  }
+
+  return 0;
+}
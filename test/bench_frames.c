@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include "util.h"
+#include "util_frames.h"
+
+// goodput of windowed frames w/ and w/o parity over a simulated lossy link
+// one frame per tick each way, DELAY ticks of latency, the receiver also acks on a timer like a real transport
+#define DELAY 8
+#define FRAME 64
+#define PACKETS 64
+#define PACKET 1024
+
+typedef struct wire_struct
+{
+  uint8_t frames[DELAY][FRAME];
+  uint8_t full[DELAY];
+} wire_s;
+
+static uint32_t seed = 42;
+static uint32_t xorshift(void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+// frame put on the link arrives DELAY ticks later, unless lost
+static void wire_tick(wire_s *link, uint32_t tick, util_frames_t from, util_frames_t to, uint8_t send, uint32_t loss)
+{
+  uint8_t at = tick % DELAY;
+  if(link->full[at]) util_frames_inbox(to, link->frames[at], NULL);
+  link->full[at] = 0;
+  if(!send || !util_frames_outbox(from, link->frames[at], NULL)) return;
+  util_frames_sent(from);
+  if((xorshift() % 1000) >= loss) link->full[at] = 1;
+}
+
+static double run(uint32_t loss, uint8_t fec)
+{
+  static uint8_t body[PACKET];
+  wire_s ab, ba;
+  uint32_t tick, got = 0, i;
+  util_frames_t a = util_frames_new(FRAME);
+  util_frames_t b = util_frames_new(FRAME);
+  util_frames_window(a, 16);
+  util_frames_window(b, 16);
+  util_frames_fec(a, fec);
+  util_frames_fec(b, fec);
+  memset(&ab, 0, sizeof(ab));
+  memset(&ba, 0, sizeof(ba));
+
+  for(i = 0; i < PACKETS; i++)
+  {
+    lob_t packet = lob_new();
+    lob_body(packet, body, PACKET);
+    util_frames_send(a, packet);
+  }
+
+  for(tick = 0; got < PACKETS && tick < 1000000; tick++)
+  {
+    lob_t packet;
+    wire_tick(&ab, tick, a, b, (util_frames_pending(a) || !(tick % (DELAY*2))) ? 1 : 0, loss);
+    wire_tick(&ba, tick, b, a, (util_frames_pending(b) || !(tick % (DELAY*2))) ? 1 : 0, loss);
+    while((packet = util_frames_receive(b)))
+    {
+      got++;
+      lob_free(packet);
+    }
+  }
+
+  util_frames_free(a);
+  util_frames_free(b);
+  return (double)(PACKETS * PACKET) / tick;
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t loss;
+  uint8_t groups[] = {0, 4, 8, 16};
+  uint8_t g;
+
+  util_sys_logging(0);
+  printf("loss  ");
+  for(g = 0; g < sizeof(groups); g++)
+  {
+    if(groups[g]) printf("   fec %2u", groups[g]);
+    else printf("   no fec");
+  }
+  printf("   (bytes per tick, %u byte frames, %u tick delay)\n", FRAME, DELAY);
+
+  for(loss = 0; loss <= 200; loss += 20)
+  {
+    printf("%4.1f%%", (double)loss / 10);
+    for(g = 0; g < sizeof(groups); g++) printf(" %8.2f", run(loss, groups[g]));
+    printf("\n");
+  }
+
+  return 0;
+}
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "net_shm.h"
+#include "net_unix.h"
+#include "util_loop.h"
+#include "util_sys.h"
+
+// one-way small channel packet rate between two meshes in this process, shm rings vs unix sockets, both driven by one util_loop
+#define PACKETS 200000
+#define PACKET 64
+#define BURST 256
+
+static int got = 0;
+static void bench_handler(chan_t chan, void *arg)
+{
+  lob_t packet;
+  while((packet = chan_receiving(chan)))
+  {
+    if(packet->body_len) got++;
+    lob_free(packet);
+  }
+}
+
+static lob_t bench_on_open(link_t link, lob_t open)
+{
+  if(lob_get_cmp(open,"type","bench")) return open;
+  chan_t chan = link_chan(link, open);
+  chan_handle(chan,bench_handler,NULL);
+  chan_receive(chan,open);
+  return NULL;
+}
+
+static unsigned long long now_us(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (unsigned long long)tv.tv_sec * 1000000 + (unsigned long long)tv.tv_usec;
+}
+
+// packets per second, 0 on failure
+static double run(uint8_t shm)
+{
+  static uint8_t body[PACKET];
+  char pathA[64], pathB[64];
+  mesh_t meshA = mesh_new();
+  mesh_t meshB = mesh_new();
+  lob_free(mesh_generate(meshA));
+  lob_free(mesh_generate(meshB));
+  mesh_on_open(meshB, "bench", bench_on_open);
+  util_loop_t loop = util_loop_new(meshA);
+  link_t linkAB = link_get_keys(meshA, meshB->keys);
+  link_t linkBA = link_get_keys(meshB, meshA->keys);
+  lob_t options = lob_new(), path;
+#ifdef __linux__
+  net_shm_t sA = NULL, sB = NULL;
+#endif
+  net_unix_t xA = NULL, xB = NULL;
+
+  snprintf(pathA,sizeof(pathA),"/tmp/bench_shm_a.%d",(int)getpid());
+  snprintf(pathB,sizeof(pathB),"/tmp/bench_shm_b.%d",(int)getpid());
+  if(shm)
+  {
+#ifdef __linux__
+    lob_set(options,"path",pathA);
+    sA = net_shm_new(meshA, options);
+    lob_set(options,"path",pathB);
+    sB = net_shm_new(meshB, options);
+    net_shm_loop(sA, loop);
+    net_shm_loop(sB, loop);
+    path = net_shm_path(sB);
+#else
+    path = NULL;
+#endif
+  }else{
+    lob_set(options,"path",pathA);
+    xA = net_unix_new(meshA, options);
+    lob_set(options,"path",pathB);
+    xB = net_unix_new(meshB, options);
+    net_unix_loop(xA, loop);
+    net_unix_loop(xB, loop);
+    path = net_unix_path(xB);
+  }
+  lob_free(options);
+  if(path) mesh_path(meshA, linkAB, path);
+  lob_free(path);
+
+  int i;
+  for(i = 0; i < 1000 && !(link_up(linkAB) && link_up(linkBA)); i++) util_loop_once(loop, 10);
+
+  lob_t open = lob_new();
+  lob_set(open,"type","bench");
+  lob_set_uint(open,"c",e3x_exchange_cid(linkAB->x, NULL));
+  chan_t chan = link_chan(linkAB, open);
+  chan_send(chan, open);
+
+  // keep a burst in flight so both sides stay busy
+  got = 0;
+  unsigned long long start = now_us(), deadline = start + 60000000;
+  for(i = 0; i < PACKETS && link_up(linkAB); i++)
+  {
+    lob_t packet = chan_packet(chan);
+    lob_body(packet, body, PACKET);
+    chan_send(chan, packet);
+    if(i % BURST == BURST - 1) while(got < i - BURST && now_us() < deadline) util_loop_once(loop, 10);
+  }
+  while(got < PACKETS && now_us() < deadline) util_loop_once(loop, 10);
+  unsigned long long us = now_us() - start;
+  if(!us) us = 1;
+
+  util_loop_free(loop);
+  mesh_free(meshA);
+  mesh_free(meshB);
+#ifdef __linux__
+  net_shm_free(sA);
+  net_shm_free(sB);
+#endif
+  net_unix_free(xA);
+  net_unix_free(xB);
+  return (got == PACKETS) ? (double)PACKETS / ((double)us / 1000000) : 0;
+}
+
+int main(int argc, char **argv)
+{
+  util_sys_logging(argc > 1);
+  printf("%u packets of %u bytes\n", PACKETS, PACKET);
+  printf("shm  %10.0f packets/s\n", run(1));
+  printf("unix %10.0f packets/s\n", run(0));
+  return 0;
+}
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include "net_tcp4.h"
+#include "net_udp4.h"
+#include "util_loop.h"
+#include "util_sys.h"
+
+// one-way channel throughput between two meshes in this process over loopback, tcp4 vs udp4, both driven by one util_loop
+#define PACKETS 2000
+#define PACKET 1000
+
+static int got = 0;
+static void bench_handler(chan_t chan, void *arg)
+{
+  lob_t packet;
+  while((packet = chan_receiving(chan)))
+  {
+    if(packet->body_len) got++;
+    lob_free(packet);
+  }
+}
+
+static lob_t bench_on_open(link_t link, lob_t open)
+{
+  if(lob_get_cmp(open,"type","bench")) return open;
+  chan_t chan = link_chan(link, open);
+  chan_handle(chan,bench_handler,NULL);
+  chan_receive(chan,open);
+  return NULL;
+}
+
+static double run(uint8_t tcp)
+{
+  static uint8_t body[PACKET];
+  mesh_t meshA = mesh_new();
+  mesh_t meshB = mesh_new();
+  lob_free(mesh_generate(meshA));
+  lob_free(mesh_generate(meshB));
+  mesh_on_open(meshB, "bench", bench_on_open);
+  util_loop_t loop = util_loop_new(meshA);
+  net_tcp4_t tA = NULL, tB = NULL;
+  net_udp4_t uA = NULL, uB = NULL;
+  link_t linkAB = link_get_keys(meshA, meshB->keys);
+  link_t linkBA = link_get_keys(meshB, meshA->keys);
+
+  if(tcp)
+  {
+    tA = net_tcp4_new(meshA, NULL);
+    tB = net_tcp4_new(meshB, NULL);
+    net_tcp4_loop(tA, loop);
+    net_tcp4_loop(tB, loop);
+    lob_t path = lob_new();
+    lob_set(path,"type","tcp4");
+    lob_set(path,"ip","127.0.0.1");
+    lob_set_int(path,"port",net_tcp4_port(tB));
+    mesh_path(meshA, linkAB, path);
+    lob_free(path);
+  }else{
+    uA = net_udp4_new(meshA, NULL);
+    uB = net_udp4_new(meshB, NULL);
+    net_udp4_loop(uA, loop);
+    net_udp4_loop(uB, loop);
+    net_udp4_direct(uA,link_handshake(linkAB),"127.0.0.1",net_udp4_port(uB));
+  }
+
+  int i;
+  for(i = 0; i < 1000 && !(link_up(linkAB) && link_up(linkBA)); i++) util_loop_once(loop, 10);
+  if(!link_up(linkAB) || !link_up(linkBA)) return 0;
+
+  lob_t open = lob_new();
+  lob_set(open,"type","bench");
+  lob_set_uint(open,"c",e3x_exchange_cid(linkAB->x, NULL));
+  chan_t chan = link_chan(linkAB, open);
+  chan_send(chan, open);
+
+  got = 0;
+  unsigned long long start = util_sys_ms(0);
+  for(i = 0; i < PACKETS; i++)
+  {
+    lob_t packet = chan_packet(chan);
+    lob_body(packet, body, PACKET);
+    chan_send(chan, packet);
+  }
+  while(got < PACKETS && util_sys_ms(0) - start < 60000) util_loop_once(loop, 10);
+  unsigned long long ms = util_sys_ms(0) - start;
+  if(!ms) ms = 1;
+
+  util_loop_free(loop);
+  mesh_free(meshA);
+  mesh_free(meshB);
+  net_tcp4_free(tA);
+  net_tcp4_free(tB);
+  net_udp4_free(uA);
+  net_udp4_free(uB);
+  return (got == PACKETS) ? ((double)PACKETS * PACKET / 1024 / 1024) / ((double)ms / 1000) : 0;
+}
+
+int main(int argc, char **argv)
+{
+  util_sys_logging(argc > 1);
+  printf("%u packets of %u bytes over loopback\n", PACKETS, PACKET);
+  printf("tcp4 %8.2f MB/s\n", run(1));
+  printf("udp4 %8.2f MB/s\n", run(0));
+  return 0;
+}
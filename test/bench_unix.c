@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "net_unix.h"
+#include "net_tcp4.h"
+#include "net_udp4.h"
+#include "util_loop.h"
+#include "util_sys.h"
+
+// ping-pong channel round trips between two meshes in this process, unix vs tcp4 vs udp4, all driven by one util_loop
+#define ROUNDS 2000
+#define PACKET 100
+
+static int got = 0;
+
+// B echoes every body back
+static void echo_handler(chan_t chan, void *arg)
+{
+  lob_t packet, reply;
+  while((packet = chan_receiving(chan)))
+  {
+    if(packet->body_len)
+    {
+      reply = chan_packet(chan);
+      lob_body(reply, packet->body, packet->body_len);
+      chan_send(chan, reply);
+    }
+    lob_free(packet);
+  }
+}
+
+static void ping_handler(chan_t chan, void *arg)
+{
+  lob_t packet;
+  while((packet = chan_receiving(chan)))
+  {
+    if(packet->body_len) got++;
+    lob_free(packet);
+  }
+}
+
+static lob_t bench_on_open(link_t link, lob_t open)
+{
+  if(lob_get_cmp(open,"type","bench")) return open;
+  chan_t chan = link_chan(link, open);
+  chan_handle(chan,echo_handler,NULL);
+  chan_receive(chan,open);
+  return NULL;
+}
+
+static unsigned long long now_us(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (unsigned long long)tv.tv_sec * 1000000 + (unsigned long long)tv.tv_usec;
+}
+
+// average round trip in microseconds, 0 on failure
+static double run(char *type)
+{
+  static uint8_t body[PACKET];
+  char pathA[64], pathB[64];
+  mesh_t meshA = mesh_new();
+  mesh_t meshB = mesh_new();
+  lob_free(mesh_generate(meshA));
+  lob_free(mesh_generate(meshB));
+  mesh_on_open(meshB, "bench", bench_on_open);
+  util_loop_t loop = util_loop_new(meshA);
+  net_unix_t xA = NULL, xB = NULL;
+  net_tcp4_t tA = NULL, tB = NULL;
+  net_udp4_t uA = NULL, uB = NULL;
+  link_t linkAB = link_get_keys(meshA, meshB->keys);
+  link_t linkBA = link_get_keys(meshB, meshA->keys);
+  lob_t path = NULL;
+
+  if(util_cmp(type,"unix") == 0)
+  {
+    lob_t options = lob_new();
+    snprintf(pathA,sizeof(pathA),"/tmp/bench_unix_a.%d",(int)getpid());
+    snprintf(pathB,sizeof(pathB),"/tmp/bench_unix_b.%d",(int)getpid());
+    lob_set(options,"path",pathA);
+    xA = net_unix_new(meshA, options);
+    lob_set(options,"path",pathB);
+    xB = net_unix_new(meshB, options);
+    lob_free(options);
+    net_unix_loop(xA, loop);
+    net_unix_loop(xB, loop);
+    path = net_unix_path(xB);
+  }else if(util_cmp(type,"tcp4") == 0){
+    tA = net_tcp4_new(meshA, NULL);
+    tB = net_tcp4_new(meshB, NULL);
+    net_tcp4_loop(tA, loop);
+    net_tcp4_loop(tB, loop);
+    path = lob_new();
+    lob_set(path,"type","tcp4");
+    lob_set(path,"ip","127.0.0.1");
+    lob_set_int(path,"port",net_tcp4_port(tB));
+  }else{
+    uA = net_udp4_new(meshA, NULL);
+    uB = net_udp4_new(meshB, NULL);
+    net_udp4_loop(uA, loop);
+    net_udp4_loop(uB, loop);
+    net_udp4_direct(uA,link_handshake(linkAB),"127.0.0.1",net_udp4_port(uB));
+  }
+  if(path) mesh_path(meshA, linkAB, path);
+  lob_free(path);
+
+  int i;
+  for(i = 0; i < 1000 && !(link_up(linkAB) && link_up(linkBA)); i++) util_loop_once(loop, 10);
+
+  lob_t open = lob_new();
+  lob_set(open,"type","bench");
+  lob_set_uint(open,"c",e3x_exchange_cid(linkAB->x, NULL));
+  chan_t chan = link_chan(linkAB, open);
+  chan_handle(chan,ping_handler,NULL);
+  chan_send(chan, open);
+
+  // one warm-up round trip then time the rest
+  unsigned long long start = 0, deadline = now_us() + 60000000;
+  got = 0;
+  for(i = 0; i <= ROUNDS && link_up(linkAB) && now_us() < deadline; i++)
+  {
+    if(i == 1) start = now_us();
+    lob_t packet = chan_packet(chan);
+    lob_body(packet, body, PACKET);
+    chan_send(chan, packet);
+    while(got <= i && now_us() < deadline) util_loop_once(loop, 10);
+  }
+  unsigned long long us = now_us() - start;
+
+  util_loop_free(loop);
+  mesh_free(meshA);
+  mesh_free(meshB);
+  net_unix_free(xA);
+  net_unix_free(xB);
+  net_tcp4_free(tA);
+  net_tcp4_free(tB);
+  net_udp4_free(uA);
+  net_udp4_free(uB);
+  return (got == ROUNDS + 1) ? (double)us / ROUNDS : 0;
+}
+
+int main(int argc, char **argv)
+{
+  util_sys_logging(argc > 1);
+  printf("%u round trips of %u bytes\n", ROUNDS, PACKET);
+  printf("unix %8.1f us\n", run("unix"));
+  printf("tcp4 %8.1f us\n", run("tcp4"));
+  printf("udp4 %8.1f us\n", run("udp4"));
+  return 0;
+}
@@ -1,6 +1,15 @@
 #include "e3x.h"
 #include "util.h"
 #include "unit_test.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static void *rand_thread(void *arg)
+{
+  e3x_rand((uint8_t*)arg, 64);
+  return NULL;
+}
 
 int main(int argc, char **argv)
 {
@@ -9,6 +18,39 @@ int main(int argc, char **argv)
   fail_unless(!lob_get(opts,"err"));
   fail_unless(!e3x_err());
   lob_free(opts);
+
+  // drbg output never repeats, across refills and threads
+  uint8_t a[64], b[64], big[1000], zero[64];
+  memset(zero,0,64);
+  fail_unless(e3x_rand(a,64) == a);
+  fail_unless(e3x_rand(b,64) == b);
+  fail_unless(memcmp(a,b,64) != 0);
+  fail_unless(memcmp(a,zero,64) != 0);
+  e3x_rand(big,sizeof(big));
+  fail_unless(memcmp(big,big+500,64) != 0);
+  fail_unless(memcmp(big+900,zero,64) != 0);
+  pthread_t t;
+  fail_unless(pthread_create(&t, NULL, rand_thread, b) == 0);
+  pthread_join(t, NULL);
+  fail_unless(memcmp(a,b,64) != 0);
+
+  // nor in a forked child, which reseeds instead of continuing the parent's stream
+  int fds[2];
+  fail_unless(pipe(fds) == 0);
+  pid_t pid = fork();
+  fail_unless(pid >= 0);
+  if(pid == 0)
+  {
+    e3x_rand(b,64);
+    _exit(write(fds[1],b,64) == 64 ? 0 : 1);
+  }
+  e3x_rand(a,64);
+  fail_unless(read(fds[0],b,64) == 64);
+  int status;
+  fail_unless(waitpid(pid,&status,0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  fail_unless(memcmp(a,b,64) != 0);
+  close(fds[0]);
+  close(fds[1]);
   return 0;
 }
 
@@ -12,6 +12,7 @@
 int main(int argc, char **argv)
 {
   lob_t opts = lob_new();
+  lob_set_uint(opts,"pool",2);
   fail_unless(e3x_init(opts) == 0);
   fail_unless(!e3x_err());
 
@@ -43,8 +44,15 @@ int main(int argc, char **argv)
   local_t localA = cs->local_new(keys,secrets);
   fail_unless(localA);
 
+  // ephemeral pool
+  fail_unless(cs->refill);
+  fail_unless(cs->refill() == 1);
+  fail_unless(cs->refill() == 1);
+  fail_unless(cs->refill() == 0);
+
   remote_t remoteA = cs->remote_new(lob_get_base32(keys,"1a"), NULL);
   fail_unless(remoteA);
+  fail_unless(cs->refill() == 1);
 
   // create another to start testing real packets
   lob_t secretsB = e3x_generate();
@@ -82,10 +90,34 @@ int main(int argc, char **argv)
   ephemeral_t ephemAB = cs->ephemeral_new(remoteB,outerBA);
   fail_unless(ephemAB);
 
+  lob_t replayBA = lob_copy(couterBA);
   lob_t cinnerAB = cs->ephemeral_decrypt(ephemAB,couterBA);
   fail_unless(cinnerAB);
   fail_unless(util_cmp(lob_get(cinnerAB,"type"),"foo") == 0);
 
+  // the same packet again is dropped before any crypto
+  fail_unless(cs->replays == 0);
+  fail_unless(!cs->ephemeral_decrypt(ephemAB,replayBA));
+  fail_unless(cs->replays == 1);
+
+  // out of order is fine within the window, anything behind it is not
+  lob_t p1 = cs->ephemeral_encrypt(ephemBA,channelBA);
+  lob_t p2 = cs->ephemeral_encrypt(ephemBA,channelBA);
+  lob_t p3 = cs->ephemeral_encrypt(ephemBA,channelBA);
+  lob_t again = lob_copy(p1);
+  fail_unless(cs->ephemeral_decrypt(ephemAB,p3));
+  fail_unless(cs->ephemeral_decrypt(ephemAB,p1));
+  fail_unless(!cs->ephemeral_decrypt(ephemAB,again));
+  fail_unless(cs->ephemeral_decrypt(ephemAB,p2));
+  fail_unless(cs->replays == 2);
+  lob_t old = cs->ephemeral_encrypt(ephemBA,channelBA);
+  int i;
+  for(i=0;i<1100;i++) lob_free(cs->ephemeral_encrypt(ephemBA,channelBA));
+  lob_t last = cs->ephemeral_encrypt(ephemBA,channelBA);
+  fail_unless(cs->ephemeral_decrypt(ephemAB,last));
+  fail_unless(!cs->ephemeral_decrypt(ephemAB,old));
+  fail_unless(cs->replays == 3);
+
   return 0;
 }
 
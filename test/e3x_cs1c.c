@@ -12,6 +12,7 @@
 int main(int argc, char **argv)
 {
   lob_t opts = lob_new();
+  lob_set_uint(opts,"pool",2);
   fail_unless(e3x_init(opts) == 0);
   fail_unless(!e3x_err());
 
@@ -43,8 +44,15 @@ int main(int argc, char **argv)
   local_t localA = cs->local_new(keys,secrets);
   fail_unless(localA);
 
+  // ephemeral pool
+  fail_unless(cs->refill);
+  fail_unless(cs->refill() == 1);
+  fail_unless(cs->refill() == 1);
+  fail_unless(cs->refill() == 0);
+
   remote_t remoteA = cs->remote_new(lob_get_base32(keys,"1c"), NULL);
   fail_unless(remoteA);
+  fail_unless(cs->refill() == 1);
 
   // create another to start testing real packets
   lob_t secretsB = e3x_generate();
@@ -84,10 +92,16 @@ int main(int argc, char **argv)
   ephemeral_t ephemAB = cs->ephemeral_new(remoteB,outerBA);
   fail_unless(ephemAB);
 
+  lob_t replayBA = lob_copy(couterBA);
   lob_t cinnerAB = cs->ephemeral_decrypt(ephemAB,couterBA);
   fail_unless(cinnerAB);
   fail_unless(util_cmp(lob_get(cinnerAB,"type"),"foo") == 0);
 
+  // the same packet again is dropped before any crypto
+  fail_unless(cs->replays == 0);
+  fail_unless(!cs->ephemeral_decrypt(ephemAB,replayBA));
+  fail_unless(cs->replays == 1);
+
   return 0;
 }
 
@@ -0,0 +1,133 @@
+#include "e3x.h"
+#include "util.h"
+#include "unit_test.h"
+#include "util_sys.h"
+
+int main(int argc, char **argv)
+{
+  lob_t opts = lob_new();
+  fail_unless(e3x_init(opts) == 0);
+  fail_unless(!e3x_err());
+
+  // need cs4a support to continue testing
+  e3x_cipher_t cs = e3x_cipher_set(0x4a,NULL);
+  if(!cs) return 0;
+
+  cs = e3x_cipher_set(0,"4a");
+  fail_unless(cs);
+  fail_unless(cs->id == CS_4a);
+
+  // RFC 7748 vectors
+  uint8_t scalar[32], point[32], out[32];
+  char hex[129];
+  util_unhex("a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4",64,scalar);
+  util_unhex("e6db6867583030db3594c1a424b15f7c726624ec26b3353b10a903a6d0ab1c4c",64,point);
+  fail_unless(x25519(out,scalar,point) == 0);
+  fail_unless(strcmp(util_hex(out,32,hex),"c3da55379de9c6908e94ea4df28d084f32eccf03491c71f754b4075577a28552") == 0);
+  util_unhex("77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a",64,scalar);
+  x25519_base(out,scalar);
+  fail_unless(strcmp(util_hex(out,32,hex),"8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a") == 0);
+  memset(point,0,32);
+  fail_unless(x25519(out,scalar,point) == 1);
+
+  // RFC 7539 poly1305 and chacha20 block counter vectors
+  uint8_t key[32], mac[16], nonce[8], text[16];
+  util_unhex("85d6be7857556d337f4452fe42d506a80103808afb0db2fd4abff6af4149f51b",64,key);
+  poly1305(mac,(uint8_t*)"Cryptographic Forum Research Group",34,key);
+  fail_unless(strcmp(util_hex(mac,16,hex),"a8061dc1305136c6c22b8baf0c0127a9") == 0);
+  uint8_t i;
+  for(i=0;i<32;i++) key[i] = i;
+  util_unhex("0000004a00000000",16,nonce);
+  chacha20_counter(key,nonce,1,(uint8_t*)"Ladies and Gentl",text,16);
+  fail_unless(strcmp(util_hex(text,16,hex),"6e2e359a2568f98041ba0728dd0d6981") == 0);
+
+  lob_t secrets = e3x_generate();
+  fail_unless(secrets);
+  fail_unless(lob_get(secrets,"4a"));
+  lob_t keys = lob_linked(secrets);
+  fail_unless(keys);
+  fail_unless(lob_get(keys,"4a"));
+  LOG("generated key %s secret %s",lob_get(keys,"4a"),lob_get(secrets,"4a"));
+
+  local_t localA = cs->local_new(keys,secrets);
+  fail_unless(localA);
+
+  remote_t remoteA = cs->remote_new(lob_get_base32(keys,"4a"), NULL);
+  fail_unless(remoteA);
+
+  // create another to start testing real packets
+  lob_t secretsB = e3x_generate();
+  fail_unless(lob_linked(secretsB));
+  local_t localB = cs->local_new(lob_linked(secretsB),secretsB);
+  fail_unless(localB);
+  remote_t remoteB = cs->remote_new(lob_get_base32(lob_linked(secretsB),"4a"), NULL);
+  fail_unless(remoteB);
+
+  // generate a message
+  lob_t messageAB = lob_new();
+  lob_set_int(messageAB,"a",42);
+  lob_t outerAB = cs->remote_encrypt(remoteB,localA,messageAB);
+  fail_unless(outerAB);
+  LOG("len %lu",lob_len(outerAB));
+  fail_unless(lob_len(outerAB) == 85);
+
+  // decrypt and verify it
+  lob_t innerAB = cs->local_decrypt(localB,outerAB);
+  fail_unless(innerAB);
+  fail_unless(lob_get_int(innerAB,"a") == 42);
+  fail_unless(cs->remote_verify(remoteA,localB,outerAB) == 0);
+  fail_unless(cs->remote_verify(remoteB,localB,outerAB) != 0);
+
+  // a tampered handshake doesn't decrypt
+  outerAB->body[40] ^= 1;
+  fail_unless(!cs->local_decrypt(localB,outerAB));
+  fail_unless(cs->remote_verify(remoteA,localB,outerAB) != 0);
+  outerAB->body[40] ^= 1;
+
+  ephemeral_t ephemBA = cs->ephemeral_new(remoteA,outerAB);
+  fail_unless(ephemBA);
+
+  lob_t channelBA = lob_new();
+  lob_set(channelBA,"type","foo");
+  lob_t couterBA = cs->ephemeral_encrypt(ephemBA,channelBA);
+  fail_unless(couterBA);
+  LOG("len %lu",lob_len(couterBA));
+  fail_unless(lob_len(couterBA) == 58);
+
+  lob_t outerBA = cs->remote_encrypt(remoteA,localB,messageAB);
+  fail_unless(outerBA);
+  fail_unless(cs->remote_verify(remoteB,localA,outerBA) == 0);
+
+  // and B's handshake reflected back at it doesn't pass as A's
+  fail_unless(cs->remote_verify(remoteA,localB,outerBA) != 0);
+  ephemeral_t ephemAB = cs->ephemeral_new(remoteB,outerBA);
+  fail_unless(ephemAB);
+
+  // forged channel packets are rejected and left as they were
+  couterBA->body[30] ^= 1;
+  fail_unless(!cs->ephemeral_decrypt(ephemAB,couterBA));
+  couterBA->body[30] ^= 1;
+
+  lob_t replayBA = lob_copy(couterBA);
+  lob_t cinnerAB = cs->ephemeral_decrypt(ephemAB,couterBA);
+  fail_unless(cinnerAB);
+  fail_unless(util_cmp(lob_get(cinnerAB,"type"),"foo") == 0);
+
+  // the same packet again is dropped before any crypto
+  fail_unless(cs->replays == 0);
+  fail_unless(!cs->ephemeral_decrypt(ephemAB,replayBA));
+  fail_unless(cs->replays == 1);
+
+  // bigger than one aead step
+  lob_t bigBA = lob_new();
+  lob_body(bigBA,NULL,2000);
+  for(i=0;i<250;i++) memcpy(bigBA->body+(i*8),"abcdefgh",8);
+  lob_t bouterBA = cs->ephemeral_encrypt(ephemBA,bigBA);
+  fail_unless(bouterBA);
+  lob_t binnerAB = cs->ephemeral_decrypt(ephemAB,bouterBA);
+  fail_unless(binnerAB);
+  fail_unless(binnerAB->body_len == 2000);
+  fail_unless(memcmp(binnerAB->body,bigBA->body,2000) == 0);
+
+  return 0;
+}
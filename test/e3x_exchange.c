@@ -95,6 +95,51 @@ int main(int argc, char **argv)
   lob_free(cinAB);
   lob_free(coutAB);
 
+  // going down and handshaking again restarts A's seqs under a new key, B must not take them as replays
+  int i;
+  uint8_t token[16];
+  for(i=0;i<16;i++)
+  {
+    uint32_t at = e3x_exchange_out(xAB,0) + 2;
+    memcpy(token,xAB->token,16);
+    fail_unless(e3x_exchange_down(xAB));
+    fail_unless(memcmp(token,xAB->token,16) != 0);
+    fail_unless(e3x_exchange_out(xAB,at) == at);
+    hsAB = e3x_exchange_handshake(xAB, NULL);
+    fail_unless(hsAB);
+    fail_unless(e3x_exchange_verify(xBA,hsAB) == 0);
+    fail_unless(e3x_exchange_in(xBA,at) == at);
+    fail_unless(e3x_exchange_sync(xBA,hsAB));
+    lob_free(hsAB);
+    hsBA = e3x_exchange_handshake(xBA, NULL);
+    fail_unless(e3x_exchange_verify(xAB,hsBA) == 0);
+    fail_unless(e3x_exchange_sync(xAB,hsBA));
+    lob_free(hsBA);
+    coutAB = e3x_exchange_send(xAB,chanAB);
+    fail_unless(coutAB);
+    cinAB = e3x_exchange_receive(xBA,coutAB);
+    fail_unless(cinAB);
+    lob_free(cinAB);
+    lob_free(coutAB);
+  }
+
+  // a newer handshake for the same key (keepalive) keeps the window, old packets are still replays
+  coutAB = e3x_exchange_send(xAB,chanAB);
+  fail_unless(coutAB);
+  cinAB = e3x_exchange_receive(xBA,coutAB);
+  fail_unless(cinAB);
+  lob_free(cinAB);
+  uint32_t at = e3x_exchange_out(xAB,0) + 2;
+  fail_unless(e3x_exchange_out(xAB,at) == at);
+  hsAB = e3x_exchange_handshake(xAB, NULL);
+  fail_unless(e3x_exchange_verify(xBA,hsAB) == 0);
+  fail_unless(e3x_exchange_in(xBA,at) == at);
+  fail_unless(e3x_exchange_sync(xBA,hsAB));
+  lob_free(hsAB);
+  fail_unless(!e3x_exchange_receive(xBA,coutAB));
+  lob_free(coutAB);
+  lob_free(chanAB);
+
   e3x_exchange_free(xAB);
   e3x_exchange_free(xBA);
   e3x_self_free(selfA);
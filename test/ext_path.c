@@ -36,10 +36,13 @@ int main(int argc, char **argv)
   lob_t pingBA = lob_new();
   lob_set(pingBA,"type","path");
   lob_set_uint(pingBA,"c",e3x_exchange_cid(linkBA->x, NULL));
-  fail_unless(link_receive(linkAB, pingBA, NULL));
+  fail_unless(link_receive(linkAB, pingBA));
 
   path_ping(linkBA, pong, NULL);
   fail_unless(status);
+  fail_unless(link_pipe_best(linkBA));
+  fail_unless(link_pipe_best(linkBA)->rtt);
+  fail_unless(link_pipe_best(linkBA)->replies == 1);
 
   return 0;
 }
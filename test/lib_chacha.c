@@ -25,6 +25,27 @@ int main(int argc, char **argv)
   fail_unless(chacha20(key,nonce,test,9));
   fail_unless(util_cmp(util_hex(test,9,hex),"ffffffffffffffffff") == 0);
 
+  // every block-parallel kernel matches the scalar one, across lengths and a 32bit counter wrap
+  uint8_t in[2100], ref[2100], out[2100];
+  uint32_t i, len;
+  uint8_t level, best = chacha20_kernel(255);
+  uint32_t bad = 0;
+  LOG("best chacha kernel %u",best);
+  for(i=0;i<sizeof(in);i++) in[i] = (uint8_t)(i*7);
+  for(len=1;len<=sizeof(in);len += (len < 600) ? 1 : 61)
+  {
+    chacha20_kernel(0);
+    chacha20_counter(key,nonce,0xfffffffdULL,in,ref,len);
+    for(level=1;level<=best;level++)
+    {
+      if(chacha20_kernel(level) != level) bad++;
+      memset(out,0,sizeof(out));
+      chacha20_counter(key,nonce,0xfffffffdULL,in,out,len);
+      if(memcmp(ref,out,len) != 0) bad++;
+    }
+  }
+  fail_unless(bad == 0);
+  fail_unless(chacha20_kernel(255) == best);
 
   return 0;
 }
@@ -151,6 +151,139 @@ int main(int argc, char **argv)
   fail_unless(util_chunks_next(f1));
   fail_unless(util_chunks_size(f1) == -1);
   
+  LOG("testing varint stream mode");
+  util_chunks_t s1 = util_chunks_stream(util_chunks_new(0),1);
+  util_chunks_t s2 = util_chunks_stream(util_chunks_new(0),1);
+  fail_unless(s1 && s2);
+  fail_unless(util_chunks_len(s1) == 0);
+  lob_t sbig = lob_new();
+  lob_body(sbig,NULL,3*1024*1024);
+  uint32_t i;
+  for(i=0;i<sbig->body_len;i++) sbig->body[i] = (uint8_t)(i*31);
+  fail_unless(util_chunks_send(s1, lob_copy(packet)));
+  fail_unless(util_chunks_send(s1, lob_copy(sbig)));
+  fail_unless(util_chunks_send(s1, lob_copy(packet)));
+  fail_unless(util_chunks_len(s1) == 1); // 102 fits in one varint byte
+  fail_unless(*util_chunks_write(s1) == 102);
+
+  // written in pieces that don't line up w/ anything
+  size_t piece;
+  uint32_t len32;
+  while((len32 = util_chunks_len(s1)))
+  {
+    piece = (len32 > 65521) ? 65521 : len32;
+    fail_unless(util_chunks_read(s2, util_chunks_write(s1), piece));
+    fail_unless(util_chunks_written(s1, piece));
+  }
+  fail_unless(!util_chunks_writing(s1));
+  p1 = util_chunks_receive(s2);
+  fail_unless(p1 && p1->body_len == 100);
+  lob_free(p1);
+  p1 = util_chunks_receive(s2);
+  fail_unless(p1 && p1->body_len == sbig->body_len);
+  fail_unless(memcmp(p1->body,sbig->body,sbig->body_len) == 0);
+  lob_free(p1);
+  p1 = util_chunks_receive(s2);
+  fail_unless(p1 && p1->body_len == 100);
+  lob_free(p1);
+  fail_unless(!util_chunks_receive(s2));
+
+  // oversized lengths are an error
+  uint8_t huge[] = {0xff,0xff,0xff,0xff,0x0f};
+  fail_unless(!util_chunks_read(s2, huge, 5));
+  fail_unless(s2->err);
+  util_chunks_free(s2);
+
+  // so is a varint that never ends, and nothing after it gets read
+  uint8_t endless[] = {0x80,0x80,0x80,0x80,0x80,0x80,0x01};
+  uint8_t one[] = {0x00};
+  s2 = util_chunks_stream(util_chunks_new(0),1);
+  fail_unless(!util_chunks_read(s2, endless, 7));
+  fail_unless(s2->err);
+  fail_unless(!util_chunks_read(s2, one, 1));
+  fail_unless(s2->err);
+  util_chunks_free(s2);
+
+  // or one overflowing 32 bits, that would wrap around to an empty keepalive
+  uint8_t wrap[] = {0x80,0x80,0x80,0x80,0x10};
+  s2 = util_chunks_stream(util_chunks_new(0),1);
+  fail_unless(!util_chunks_read(s2, wrap, 5));
+  fail_unless(s2->err);
+  fail_unless(!util_chunks_read(s2, one, 1));
+  fail_unless(s2->err);
+  lob_free(sbig);
+  util_chunks_free(s1);
+  util_chunks_free(s2);
+
+  LOG("testing iovec export");
+  struct iovec iov[UTIL_CHUNKS_IOV];
+  uint8_t wire[2048];
+  int count, c;
+  size_t total;
+
+  // chunked, unblocked, a tail chunk of one byte
+  c1 = util_chunks_new(10);
+  c2 = util_chunks_new(10);
+  c1->blocking = 0;
+  lob_t odd = lob_new();
+  lob_body(odd,NULL,17); // 19 raw, 9+9+1
+  fail_unless(util_chunks_send(c1, lob_copy(odd)));
+  fail_unless(util_chunks_send(c1, lob_copy(odd)));
+  count = util_chunks_iov(c1, iov, UTIL_CHUNKS_IOV);
+  fail_unless(count == 14);
+  for(total=0,c=0;c<count;c++)
+  {
+    memcpy(wire+total,iov[c].iov_base,iov[c].iov_len);
+    total += iov[c].iov_len;
+  }
+  fail_unless(total == 2 * (19 + 4));
+  fail_unless(util_chunks_read(c2, wire, total));
+  fail_unless(util_chunks_written(c1, total));
+  fail_unless(!util_chunks_writing(c1));
+  p1 = util_chunks_receive(c2);
+  fail_unless(p1 && p1->body_len == 17);
+  lob_free(p1);
+  p1 = util_chunks_receive(c2);
+  fail_unless(p1 && p1->body_len == 17);
+  lob_free(p1);
+  util_chunks_free(c1);
+  util_chunks_free(c2);
+
+  // stream mode, several packets in one go after a partial write
+  s1 = util_chunks_stream(util_chunks_new(0),1);
+  s2 = util_chunks_stream(util_chunks_new(0),1);
+  fail_unless(util_chunks_send(s1, lob_copy(packet)));
+  fail_unless(util_chunks_send(s1, lob_copy(odd)));
+  fail_unless(util_chunks_send(s1, lob_copy(packet)));
+  count = util_chunks_iov(s1, iov, UTIL_CHUNKS_IOV);
+  fail_unless(count == 6);
+  fail_unless(util_chunks_read(s2, iov[0].iov_base, 1));
+  fail_unless(util_chunks_read(s2, iov[1].iov_base, 50));
+  fail_unless(util_chunks_written(s1, 51));
+  count = util_chunks_iov(s1, iov, UTIL_CHUNKS_IOV);
+  fail_unless(count == 5);
+  fail_unless(iov[0].iov_len == 52);
+  for(total=0,c=0;c<count;c++)
+  {
+    memcpy(wire+total,iov[c].iov_base,iov[c].iov_len);
+    total += iov[c].iov_len;
+  }
+  fail_unless(total == 52 + 1 + 19 + 1 + 102);
+  fail_unless(util_chunks_read(s2, wire, total));
+  fail_unless(util_chunks_written(s1, total));
+  fail_unless(!util_chunks_iov(s1, iov, UTIL_CHUNKS_IOV));
+  fail_unless(!util_chunks_written(s1, 1));
+  for(c=0;c<3;c++)
+  {
+    p1 = util_chunks_receive(s2);
+    fail_unless(p1);
+    lob_free(p1);
+  }
+  fail_unless(!util_chunks_receive(s2));
+  lob_free(odd);
+  util_chunks_free(s1);
+  util_chunks_free(s2);
+
 
   return 0;
 }
@@ -0,0 +1,36 @@
+#include "crc32c.h"
+#include "util.h"
+#include "unit_test.h"
+
+int main(int argc, char **argv)
+{
+  uint8_t buf[300];
+  uint32_t i, len, bad = 0;
+
+  // rfc 3720 check value and zeros vector
+  fail_unless(crc32c((uint8_t*)"123456789",9) == 0xe3069283);
+  memset(buf,0,32);
+  fail_unless(crc32c(buf,32) == 0x8a9136aa);
+  fail_unless(crc32c(buf,0) == 0);
+
+  // running crc is the same as all at once
+  fail_unless(crc32c_update(crc32c_update(0,(uint8_t*)"1234",4),(uint8_t*)"56789",5) == 0xe3069283);
+
+  // hardware matches the table at every length and alignment
+  for(i=0;i<sizeof(buf);i++) buf[i] = (uint8_t)(i * 7 + 3);
+  uint8_t best = crc32c_kernel(255);
+  LOG("crc32c kernel %u",best);
+  for(len=0;len<256;len++)
+  {
+    for(i=0;i<8;i++)
+    {
+      crc32c_kernel(0);
+      uint32_t soft = crc32c(buf+i,len);
+      crc32c_kernel(best);
+      if(crc32c(buf+i,len) != soft) bad++;
+    }
+  }
+  fail_unless(bad == 0);
+
+  return 0;
+}
@@ -23,6 +23,18 @@ int main(int argc, char **argv)
   fail_unless(util_cmp(lob_get(packet,"foo"),"[\"bar\"]") == 0);
   
   lob_free(packet);
+
+  // adopting keeps the given storage
+  uint8_t *owned = malloc(len);
+  memcpy(owned,buf,len);
+  packet = lob_adopt(owned,len);
+  fail_unless(packet);
+  fail_unless(packet->raw == owned);
+  fail_unless(util_cmp(lob_get(packet,"type"),"test") == 0);
+  lob_free(packet);
+  owned = malloc(1);
+  fail_unless(!lob_adopt(owned,1));
+
   packet = lob_new();
   lob_set_base32(packet,"32",buf,len);
   fail_unless(lob_get(packet,"32"));
@@ -0,0 +1,64 @@
+#include "telehash.h"
+#include "unit_test.h"
+
+// generator multiples must match the ladder used for any other point
+static void check_curve(uECC_Curve curve)
+{
+  uint8_t privA[32], pubA[64], privB[32], pubB[64], G[64], one[32];
+  uint8_t secretA[32], secretB[32], hash[32], sig[64];
+  int bytes = uECC_curve_private_key_size(curve);
+  int size = uECC_curve_public_key_size(curve);
+  int i;
+
+  // 1 * G
+  memset(one,0,sizeof(one));
+  one[bytes-1] = 1;
+  fail_unless(uECC_compute_public_key(one, G, curve));
+  fail_unless(uECC_valid_public_key(G, curve));
+
+  for(i = 0; i < 8; i++)
+  {
+    fail_unless(uECC_make_key(pubA, privA, curve));
+    fail_unless(uECC_make_key(pubB, privB, curve));
+    fail_unless(uECC_valid_public_key(pubA, curve));
+
+    // k * G through the ladder
+    fail_unless(uECC_shared_secret(G, privA, secretA, curve));
+    fail_unless(memcmp(secretA, pubA, size/2) == 0);
+
+    // ecdh both ways
+    fail_unless(uECC_shared_secret(pubB, privA, secretA, curve));
+    fail_unless(uECC_shared_secret(pubA, privB, secretB, curve));
+    fail_unless(memcmp(secretA, secretB, size/2) == 0);
+
+    // signatures use the table too
+    e3x_rand(hash, 32);
+    fail_unless(uECC_sign(privA, hash, 32, sig, curve));
+    fail_unless(uECC_verify(pubA, hash, 32, sig, curve));
+    fail_unless(!uECC_verify(pubB, hash, 32, sig, curve));
+  }
+}
+
+int main(int argc, char **argv)
+{
+  fail_unless(!e3x_init(NULL));
+#if uECC_FIXED_BASE
+  // already built by the cipher sets
+  fail_unless(uECC_precompute(uECC_secp160r1()));
+  fail_unless(uECC_precompute(uECC_secp256r1()));
+#endif
+
+  check_curve(uECC_secp160r1());
+  check_curve(uECC_secp256r1());
+
+  // known 2 * G on secp256r1
+  uint8_t two[32], pub[64];
+  char hex[129];
+  memset(two,0,sizeof(two));
+  two[31] = 2;
+  fail_unless(uECC_compute_public_key(two, pub, uECC_secp256r1()));
+  util_hex(pub,64,hex);
+  fail_unless(strcmp(hex,"7cf27b188d034f7e8a52380304b51ac3c08969e277f21b35a60b48fc4766997807775510db8ed040293d9ac69f7430dbba7dade63ce982299e04b79d227873d1") == 0);
+
+  return 0;
+}
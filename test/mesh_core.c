@@ -6,6 +6,33 @@ link_t net_send(link_t link, lob_t packet, void *arg)
   return link;
 }
 
+// records the order packets leave the link queue
+static lob_t sent = NULL;
+link_t net_capture(link_t link, lob_t packet, void *arg)
+{
+  if(packet) sent = lob_push(sent, packet);
+  return link;
+}
+
+link_t net_fail(link_t link, lob_t packet, void *arg)
+{
+  return NULL;
+}
+
+// refuses while busy, else captures
+static int busy = 0;
+link_t net_busy(link_t link, lob_t packet, void *arg)
+{
+  if(busy && packet) return NULL;
+  return net_capture(link, packet, arg);
+}
+
+static int writable = 0;
+void link_writable_test(link_t link)
+{
+  writable++;
+}
+
 link_t net_test(link_t link, lob_t path)
 {
   fail_unless(path);
@@ -42,6 +69,20 @@ int main(int argc, char **argv)
   fail_unless(chan);
   lob_free(open);
 
+  // handshakes are cached per at
+  lob_t hs1 = link_handshake(link);
+  lob_t hs2 = link_handshake(link);
+  fail_unless(hs1 && hs2 && hs1 != hs2);
+  fail_unless(lob_len(hs1) == lob_len(hs2));
+  fail_unless(memcmp(lob_raw(hs1),lob_raw(hs2),lob_len(hs1)) == 0);
+  lob_free(hs2);
+  e3x_exchange_out(link->x, e3x_exchange_out(link->x,0)+1);
+  hs2 = link_handshake(link);
+  fail_unless(hs2);
+  fail_unless(memcmp(lob_raw(hs1),lob_raw(hs2),lob_len(hs1)) != 0);
+  lob_free(hs1);
+  lob_free(hs2);
+
   mesh_on_path(mesh, "test", net_test);
   link = mesh_path(mesh,link,lob_set(lob_new(),"type","test"));
   fail_unless(link);
@@ -52,7 +93,125 @@ int main(int argc, char **argv)
 
   fail_unless(mesh_process(mesh, 1));
 
+  // send queue priorities and window
+  mesh_on_writable(mesh, "test", link_writable_test);
+  fail_unless(link_pipe(link, net_capture, NULL));
+  sent = lob_freeall(sent); // handshake from the pipe change
+  fail_unless(link_window(link, 1) == 1);
+  fail_unless(link_queue(link, lob_set(lob_new(),"n","bulk1"), LINK_BULK));
+  fail_unless(link_queue(link, lob_set(lob_new(),"n","bulk2"), LINK_BULK));
+  fail_unless(link_queue(link, lob_set(lob_new(),"n","chat"), LINK_INTERACTIVE));
+  fail_unless(!link_writable(link));
+  fail_unless(link_queue(link, lob_set(lob_new(),"n","hs"), LINK_HANDSHAKE));
+  fail_unless(lob_get_cmp(sent,"n","bulk1") == 0);
+  fail_unless(lob_get_cmp(lob_next(sent),"n","hs") == 0);
+  fail_unless(!lob_next(lob_next(sent)));
+  fail_unless(link_sent(link, 100));
+  fail_unless(lob_get_cmp(lob_next(lob_next(sent)),"n","chat") == 0);
+  fail_unless(link_sent(link, 100));
+  fail_unless(lob_get_cmp(lob_next(lob_next(lob_next(sent))),"n","bulk2") == 0);
+  fail_unless(!writable);
+  fail_unless(link_sent(link, 100));
+  fail_unless(link_writable(link));
+  fail_unless(writable == 1);
+  sent = lob_freeall(sent);
+  fail_unless(link_window(link, 0) == 0);
+
+  // multiple pipes, failover and rtt selection
+  link_pipe_t good = link_pipe_best(link);
+  fail_unless(good && good->send == net_capture);
+  fail_unless(link_pipe(link, net_fail, NULL)); // added even though the handshake fails on it
+  fail_unless(link_pipe_best(link)->send == net_fail); // newest wins until measured
+  fail_unless(link_pipe_best(link)->fails == 1);
+  fail_unless(link_send(link, lob_set(lob_new(),"n","failover")));
+  fail_unless(lob_get_cmp(sent,"n","failover") == 0);
+  fail_unless(link_pipe_rtt(link, good, 50) == good);
+  fail_unless(link_pipe_best(link) == good);
+  fail_unless(link_unpipe(link, net_fail, NULL));
+  fail_unless(link_unpipe(link, net_send, NULL)); // from mesh_path above
+  fail_unless(!link_unpipe(link, net_send, NULL));
+  fail_unless(link_pipes(link, NULL) == good);
+  fail_unless(!link_pipes(link, good));
+  sent = lob_freeall(sent);
+
+  // a refused packet isn't inflight and stays first in line, until every pipe is failing
+  fail_unless(link_unpipe(link, net_capture, NULL));
+  fail_unless(link_pipe(link, net_busy, NULL));
+  sent = lob_freeall(sent);
+  busy = 1;
+  fail_unless(link_window(link, 1000) == 1000);
+  fail_unless(link_queue(link, lob_set(lob_new(),"n","first"), LINK_BULK));
+  fail_unless(link->inflight == 0 && link->queued);
+  fail_unless(link_queue(link, lob_set(lob_new(),"n","second"), LINK_BULK));
+  fail_unless(link->inflight == 0 && !sent);
+  busy = 0;
+  fail_unless(link_flush(link));
+  fail_unless(lob_get_cmp(sent,"n","first") == 0);
+  fail_unless(lob_get_cmp(lob_next(sent),"n","second") == 0);
+  fail_unless(link->inflight == lob_len(sent) + lob_len(lob_next(sent)) && !link->queued);
+  sent = lob_freeall(sent);
+  fail_unless(link_sent(link, link->inflight));
+  busy = 1;
+  fail_unless(link_queue(link, lob_set(lob_new(),"n","third"), LINK_BULK));
+  fail_unless(link_flush(link) && link->queued);
+  fail_unless(link_flush(link) && !link->queued);
+  fail_unless(!link->inflight && !sent);
+  fail_unless(link_unpipe(link, net_busy, NULL));
+  fail_unless(link_window(link, 0) == 0);
+
   link_free(link);
+
+  // handshake admission per source, with a cookie to get past it
+  lob_t challenge = NULL, hs = lob_new();
+  uint8_t csid = 0x1a;
+  lob_head(hs,&csid,1);
+  lob_body(hs,NULL,64);
+  fail_unless(mesh_admission(mesh, 1, 2));
+  fail_unless(mesh_admit(mesh, lob_copy(hs), (uint8_t*)"src1", 4, &challenge));
+  fail_unless(!challenge);
+  fail_unless(mesh_admit(mesh, lob_copy(hs), (uint8_t*)"src1", 4, &challenge));
+  fail_unless(!mesh_admit(mesh, lob_copy(hs), (uint8_t*)"src1", 4, &challenge));
+  fail_unless(challenge);
+  fail_unless(lob_get_cmp(challenge,"type","cookie") == 0);
+  fail_unless(mesh_admit(mesh, lob_copy(hs), (uint8_t*)"src2", 4, NULL));
+  fail_unless(mesh_cookie_len(hs, NULL) == lob_len(hs));
+  lob_t echo = mesh_cookie(lob_copy(hs), lob_get(challenge,"cookie"));
+  fail_unless(lob_len(echo) == mesh_cookie_len(hs, lob_get(challenge,"cookie")));
+  lob_free(echo);
+  echo = mesh_admit(mesh, mesh_cookie(lob_copy(hs), lob_get(challenge,"cookie")), (uint8_t*)"src1", 4, NULL);
+  fail_unless(echo && echo->head_len == 1 && lob_len(echo) == lob_len(hs));
+  lob_free(echo);
+  fail_unless(!mesh_admit(mesh, mesh_cookie(lob_copy(hs), lob_get(challenge,"cookie")), (uint8_t*)"src2", 4, NULL));
+  fail_unless(mesh->admission->admitted == 3);
+  fail_unless(mesh->admission->challenged == 1);
+  fail_unless(mesh->admission->cookied == 1);
+  fail_unless(mesh->admission->dropped == 1);
+
+  // a bad or stale cookie is answered with a current one
+  lob_t fresh = NULL;
+  fail_unless(!mesh_admit(mesh, mesh_cookie(lob_copy(hs), lob_get(challenge,"cookie")), (uint8_t*)"src2", 4, &fresh));
+  fail_unless(fresh && lob_get_cmp(fresh,"type","cookie") == 0);
+  echo = mesh_admit(mesh, mesh_cookie(lob_copy(hs), lob_get(fresh,"cookie")), (uint8_t*)"src2", 4, NULL);
+  fail_unless(echo);
+  lob_free(echo);
+  lob_free(fresh);
+
+  // cookied handshakes have their own bigger budget
+  int i;
+  for(i = 1; i < 2 * MESH_COOKIE_SCALE; i++)
+  {
+    echo = mesh_admit(mesh, mesh_cookie(lob_copy(hs), lob_get(challenge,"cookie")), (uint8_t*)"src1", 4, NULL);
+    fail_unless(echo);
+    lob_free(echo);
+  }
+  fail_unless(!mesh_admit(mesh, mesh_cookie(lob_copy(hs), lob_get(challenge,"cookie")), (uint8_t*)"src1", 4, NULL));
+  fail_unless(mesh->admission->cookied == 2 * MESH_COOKIE_SCALE + 1);
+  fail_unless(mesh->admission->dropped == 3);
+  lob_free(challenge);
+  fail_unless(mesh_process(mesh, 5));
+  fail_unless(mesh_admit(mesh, lob_copy(hs), (uint8_t*)"src1", 4, NULL));
+  lob_free(hs);
+
   mesh_free(mesh);
 
   return 0;
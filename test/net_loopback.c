@@ -2,6 +2,15 @@
 #include "unit_test.h"
 
 static uint8_t status = 0;
+link_t pair_send(link_t link, lob_t packet, void *arg);
+static uint8_t opens = 0;
+
+lob_t batch_open(link_t link, lob_t open)
+{
+  if(!lob_get_cmp(open,"type","batch")) opens++;
+  lob_free(open);
+  return NULL;
+}
 
 void link_check(link_t link)
 {
@@ -34,6 +43,42 @@ int main(int argc, char **argv)
   fail_unless(link_up(linkAB));
   fail_unless(link_up(linkBA));
   fail_unless(status);
+
+  // repeat handshakes come from the key cache
+  fail_unless(meshA->keys_seen && meshB->keys_seen);
+  uint32_t parsedA = meshA->keys_parsed, parsedB = meshB->keys_parsed;
+  uint32_t hitA = meshA->keys_hit, hitB = meshB->keys_hit;
+  fail_unless(parsedA && parsedB);
+  fail_unless(link_resync(linkAB));
+  fail_unless(link_up(linkAB));
+  fail_unless(link_up(linkBA));
+  fail_unless(meshA->keys_parsed == parsedA && meshB->keys_parsed == parsedB);
+  fail_unless(meshA->keys_hit > hitA && meshB->keys_hit > hitB);
+  fail_unless(link_get(meshA, meshB->id) == linkAB && link_get(meshB, meshA->id) == linkBA);
+
+  // a batch of opens and one undeliverable packet
+  mesh_on_open(meshA, "batch", batch_open);
+  lob_t batch = NULL;
+  int i;
+  for(i=0;i<3;i++)
+  {
+    lob_t open = lob_new();
+    lob_set(open,"type","batch");
+    lob_set_uint(open,"c",e3x_exchange_cid(linkBA->x, NULL));
+    batch = lob_push(batch, e3x_exchange_send(linkBA->x, open));
+    lob_free(open);
+  }
+  lob_t junk = lob_new();
+  lob_body(junk,NULL,32);
+  batch = lob_push(batch, junk);
+  fail_unless(mesh_receive_batch(meshA, batch) == linkAB);
+  fail_unless(opens == 3);
+
+  // the pair hands packets over synchronously, a window never fills up
+  fail_unless(link_window(linkAB, 100) == 100);
+  for(i=0;i<8;i++) fail_unless(link_send(linkAB, lob_set_uint(lob_new(),"c",1)));
+  fail_unless(!linkAB->queued && !linkAB->inflight);
+  fail_unless(link_window(linkAB, 0) == 0);
   
   fail_unless(mesh_process(meshA,1));
   fail_unless(mesh_linked(meshA, hashname_char(meshB->id),0));
@@ -42,6 +87,33 @@ int main(int argc, char **argv)
   fail_unless(!mesh_linked(meshA, hashname_char(meshB->id),0));
   fail_unless(!status);
 
+  // keepalive probes an idle link and times out a silent one
+  mesh_t meshC = mesh_new();
+  fail_unless(mesh_generate(meshC));
+  mesh_t meshD = mesh_new();
+  fail_unless(mesh_generate(meshD));
+  net_loopback_t pairCD = net_loopback_new(meshC,meshD);
+  link_t linkCD = link_get(meshC, meshD->id);
+  link_t linkDC = link_get(meshD, meshC->id);
+  fail_unless(link_resync(linkCD));
+  fail_unless(link_up(linkCD));
+  fail_unless(mesh_keepalive(meshC, 2, 5));
+  fail_unless(mesh_deadline(meshC,10) == 10);
+  fail_unless(mesh_process(meshC,10));
+  fail_unless(linkCD->seen == 10);
+  fail_unless(!linkCD->probed);
+  fail_unless(mesh_deadline(meshC,11) == 12);
+  fail_unless(mesh_process(meshC,12));
+  fail_unless(linkCD->probed == 12);
+  fail_unless(linkCD->heard);
+  fail_unless(mesh_process(meshC,13));
+  fail_unless(linkCD->seen == 13);
+  fail_unless(link_unpipe(linkDC, pair_send, pairCD));
+  fail_unless(mesh_process(meshC,15));
+  fail_unless(link_up(linkCD));
+  fail_unless(mesh_process(meshC,18));
+  fail_unless(!link_up(linkCD));
+
   return 0;
 }
 
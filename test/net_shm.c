@@ -0,0 +1,336 @@
+// memfd_create
+#define _GNU_SOURCE
+
+#include "net_shm.h"
+#include "util_loop.h"
+#include "util_sys.h"
+#include "unit_test.h"
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#ifdef __linux__
+
+static int pipes(link_t link)
+{
+  int count = 0;
+  link_pipe_t pipe;
+  for(pipe = link_pipes(link, NULL); pipe; pipe = link_pipes(link, pipe)) count++;
+  return count;
+}
+
+// pass an offer along as is, or its map copied into a memfd w/o any seals
+static int offer(int sock, int *fds, uint32_t size, int sealed)
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union { char buf[CMSG_SPACE(3 * sizeof(int))]; struct cmsghdr align; } control;
+  int send[3] = {fds[0], fds[1], fds[2]};
+  if(!sealed)
+  {
+    struct stat st;
+    fstat(fds[0], &st);
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fds[0], 0);
+    send[0] = memfd_create("unsealed", MFD_CLOEXEC);
+    if(map == MAP_FAILED || send[0] < 0 || write(send[0], map, (size_t)st.st_size) != st.st_size) return 0;
+    munmap(map, (size_t)st.st_size);
+  }
+  memset(&msg,0,sizeof(msg));
+  memset(&control,0,sizeof(control));
+  iov.iov_base = &size;
+  iov.iov_len = sizeof(size);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(send));
+  memcpy(CMSG_DATA(cmsg), send, sizeof(send));
+  if(sendmsg(sock, &msg, 0) < 0) return 0;
+  if(!sealed) close(send[0]);
+  return 1;
+}
+
+// a raw connection to the listener at path
+static int dial(char *path)
+{
+  struct sockaddr_un sa;
+  int sock = socket(AF_UNIX, SOCK_SEQPACKET|SOCK_NONBLOCK, 0);
+  memset(&sa,0,sizeof(sa));
+  sa.sun_family = AF_UNIX;
+  strcpy(sa.sun_path, path);
+  if(connect(sock, (struct sockaddr *)&sa, sizeof(sa)) < 0) return -1;
+  return sock;
+}
+
+static int got = 0;
+static void burst_handler(chan_t chan, void *arg)
+{
+  lob_t packet;
+  while((packet = chan_receiving(chan)))
+  {
+    if(packet->body_len == 600 && packet->body[0] == (uint8_t)got) got++;
+    lob_free(packet);
+  }
+}
+
+static lob_t burst_on_open(link_t link, lob_t open)
+{
+  if(lob_get_cmp(open,"type","burst")) return open;
+  chan_t chan = link_chan(link, open);
+  chan_handle(chan,burst_handler,NULL);
+  chan_receive(chan,open);
+  return NULL;
+}
+
+int main(int argc, char **argv)
+{
+  char pathA[64], pathB[64];
+  snprintf(pathA,sizeof(pathA),"/tmp/net_shm_a.%d",(int)getpid());
+  snprintf(pathB,sizeof(pathB),"/tmp/net_shm_b.%d",(int)getpid());
+
+  mesh_t meshA = mesh_new();
+  fail_unless(meshA);
+  fail_unless(mesh_generate(meshA));
+  mesh_t meshB = mesh_new();
+  fail_unless(meshB);
+  fail_unless(mesh_generate(meshB));
+  mesh_on_open(meshB, "burst", burst_on_open);
+
+  // a path is required and rings are powers of two
+  fail_unless(!net_shm_new(meshA, NULL));
+  lob_t options = lob_new();
+  lob_set(options,"path",pathA);
+  lob_set_uint(options,"ring",5000);
+  fail_unless(!net_shm_new(meshA, options));
+
+  // small rings so they wrap and fill
+  lob_set_uint(options,"ring",4096);
+  net_shm_t netA = net_shm_new(meshA, options);
+  fail_unless(netA);
+
+  // a live listener is never taken over
+  fail_unless(!net_shm_new(meshB, options));
+  fail_unless(access(pathA, F_OK) == 0);
+  lob_set(options,"path",pathB);
+  net_shm_t netB = net_shm_new(meshB, options);
+  fail_unless(netB);
+
+  util_loop_t loop = util_loop_new(meshA);
+  fail_unless(loop);
+  fail_unless(net_shm_loop(netA, loop));
+  fail_unless(net_shm_loop(netB, loop));
+
+  link_t linkAB = link_get_keys(meshA, meshB->keys);
+  link_t linkBA = link_get_keys(meshB, meshA->keys);
+  fail_unless(linkAB);
+  fail_unless(linkBA);
+
+  // the connector maps right away and watches its socket and doorbell
+  lob_t path = net_shm_path(netB);
+  fail_unless(path);
+  fail_unless(lob_get_cmp(path,"type","shm") == 0);
+  fail_unless(mesh_path(meshA, linkAB, path));
+  fail_unless(pipes(linkAB) == 1);
+  struct pollfd fds[4];
+  int ms = -1;
+  fail_unless(net_shm_fds(netA, fds, 4, &ms) == 3);
+  fail_unless(ms == -1);
+
+  int i;
+  for(i=64;i;i--)
+  {
+    fail_unless(util_loop_once(loop, 10));
+    if(link_up(linkAB) && link_up(linkBA)) break;
+  }
+  fail_unless(i);
+  fail_unless(pipes(linkBA) == 1);
+  fail_unless(net_shm_fds(netB, fds, 4, &ms) == 3);
+
+  uid_t uid = 1;
+  pid_t pid = 0;
+  fail_unless(net_shm_peer(netA, linkAB, &uid, &pid));
+  fail_unless(uid == geteuid());
+  fail_unless(pid == getpid());
+  fail_unless(net_shm_peer(netB, linkBA, &uid, &pid));
+  fail_unless(!net_shm_peer(netA, linkBA, &uid, &pid));
+
+  // pipes are reused per peer, from either side
+  fail_unless(mesh_path(meshA, linkAB, path));
+  fail_unless(pipes(linkAB) == 1);
+  lob_free(path);
+  path = net_shm_path(netA);
+  fail_unless(mesh_path(meshB, linkBA, path));
+  fail_unless(pipes(linkBA) == 1);
+  lob_free(path);
+
+  // far more than the ring holds, all arrive in order
+  lob_t open = lob_new();
+  lob_set(open,"type","burst");
+  lob_set_uint(open,"c",e3x_exchange_cid(linkAB->x, NULL));
+  chan_t chan = link_chan(linkAB, open);
+  fail_unless(chan);
+  chan_send(chan, open);
+  uint8_t body[600];
+  for(i=0;i<100;i++)
+  {
+    lob_t packet = chan_packet(chan);
+    memset(body,i,sizeof(body));
+    lob_body(packet, body, sizeof(body));
+    chan_send(chan, packet);
+  }
+  for(i=256;i && got < 100;i--) util_loop_once(loop, 10);
+  fail_unless(got == 100);
+
+  // too large for the ring is refused w/o taking it, the link drops it once the pipe has failed it enough
+  lob_t big = lob_new();
+  lob_body(big, NULL, 4096);
+  fail_unless(link_send(linkAB, big));
+  fail_unless(linkAB->queued);
+  for(i=0;i<LINK_PIPE_FAILS && linkAB->queued;i++) link_flush(linkAB);
+  fail_unless(!linkAB->queued);
+  util_loop_once(loop, 0);
+
+  // offers come w/ the memfd sealed at its size
+  char pathC[64];
+  snprintf(pathC,sizeof(pathC),"/tmp/net_shm_c.%d",(int)getpid());
+  struct sockaddr_un sc;
+  memset(&sc,0,sizeof(sc));
+  sc.sun_family = AF_UNIX;
+  strcpy(sc.sun_path, pathC);
+  int listener = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  fail_unless(bind(listener, (struct sockaddr *)&sc, sizeof(sc)) == 0 && listen(listener, 1) == 0);
+  path = lob_new();
+  lob_set(path,"type","shm");
+  lob_set(path,"path",pathC);
+  lob_t idC = e3x_generate();
+  link_t linkAC = link_get_keys(meshA, lob_linked(idC));
+  lob_free(idC);
+  fail_unless(linkAC);
+  fail_unless(mesh_path(meshA, linkAC, path));
+  lob_free(path);
+  int accepted = accept(listener, NULL, NULL);
+  fail_unless(accepted >= 0);
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union { char buf[CMSG_SPACE(3 * sizeof(int))]; struct cmsghdr align; } control;
+  uint32_t size = 0;
+  int offered[3] = {-1,-1,-1};
+  memset(&msg,0,sizeof(msg));
+  iov.iov_base = &size;
+  iov.iov_len = sizeof(size);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  fail_unless(recvmsg(accepted, &msg, 0) == sizeof(size));
+  fail_unless((cmsg = CMSG_FIRSTHDR(&msg)) && cmsg->cmsg_type == SCM_RIGHTS);
+  memcpy(offered, CMSG_DATA(cmsg), sizeof(offered));
+  fail_unless(size == 4096);
+  int seals = fcntl(offered[0], F_GET_SEALS);
+  fail_unless(seals >= 0 && (seals & F_SEAL_SHRINK) && (seals & F_SEAL_GROW) && (seals & F_SEAL_SEAL));
+  fail_unless(ftruncate(offered[0], 0) < 0);
+
+  // and one w/o them is refused, the same map sealed is taken
+  uint8_t byte;
+  int unsealed = dial(pathB), sealed = dial(pathB);
+  fail_unless(unsealed >= 0 && sealed >= 0);
+  fail_unless(offer(unsealed, offered, size, 0));
+  fail_unless(offer(sealed, offered, size, 1));
+  for(i=0;i<4;i++) util_loop_once(loop, 10);
+  fail_unless(recv(unsealed, &byte, 1, 0) == 0);
+  fail_unless(recv(sealed, &byte, 1, 0) < 0 && errno == EAGAIN);
+  close(unsealed);
+  close(sealed);
+  for(i=0;i<3;i++) close(offered[i]);
+  close(accepted);
+  close(listener);
+  unlink(pathC);
+  for(i=8;i && pipes(linkAC);i--) util_loop_once(loop, 10);
+  fail_unless(pipes(linkAC) == 0);
+
+  // a second hashname handshaking over the same pipe takes it over
+  mesh_t meshC = mesh_new();
+  fail_unless(mesh_generate(meshC));
+  link_t linkCB = link_get_keys(meshC, meshB->keys);
+  link_t linkBC = link_get_keys(meshB, meshC->keys);
+  fail_unless(linkCB);
+  fail_unless(linkBC);
+  link_pipe_t ab = link_pipes(linkAB, NULL);
+  fail_unless(ab->send(linkAB, link_handshake(linkCB), ab->arg));
+  for(i=64;i && !pipes(linkBC);i--) util_loop_once(loop, 10);
+  fail_unless(pipes(linkBC) == 1);
+  fail_unless(pipes(linkBA) == 0);
+
+  // the link it left going down, or a stale drop from it, doesn't close it
+  link_down(linkBA);
+  link_pipe_t bc = link_pipes(linkBC, NULL);
+  fail_unless(bc->send(linkBA, NULL, bc->arg));
+  for(i=0;i<4;i++) util_loop_once(loop, 0);
+  fail_unless(pipes(linkBC) == 1);
+  fail_unless(net_shm_peer(netB, linkBC, NULL, NULL));
+  fail_unless(pipes(linkAB) == 1);
+
+  // a closed pipe is dropped from the other side's link, and the socket file goes with it
+  fail_unless(util_loop_remove(loop, netB));
+  net_shm_free(netB);
+  fail_unless(pipes(linkBC) == 0);
+  fail_unless(access(pathB, F_OK) != 0);
+  for(i=8;i && pipes(linkAB);i--) util_loop_once(loop, 10);
+  fail_unless(pipes(linkAB) == 0);
+
+  // connecting to a listener w/ a full backlog is retried from the loop, then offers the map
+  netB = net_shm_new(meshB, options);
+  fail_unless(netB);
+  lob_free(options);
+  fail_unless(net_shm_loop(netB, loop));
+  struct sockaddr_un sa;
+  memset(&sa,0,sizeof(sa));
+  sa.sun_family = AF_UNIX;
+  strcpy(sa.sun_path, pathB);
+  int full[256], count;
+  for(count = 0; count < 256; count++)
+  {
+    full[count] = socket(AF_UNIX, SOCK_SEQPACKET|SOCK_NONBLOCK, 0);
+    if(connect(full[count], (struct sockaddr *)&sa, sizeof(sa)) < 0) break;
+  }
+  fail_unless(count < 256);
+  path = net_shm_path(netB);
+  fail_unless(mesh_path(meshA, linkAB, path));
+  lob_free(path);
+  fail_unless(pipes(linkAB) == 1);
+  fail_unless(!net_shm_peer(netA, linkAB, NULL, NULL));
+  ms = -1;
+  fail_unless(net_shm_fds(netA, fds, 4, &ms) == 1);
+  fail_unless(ms == NET_SHM_RETRY);
+  for(i=64;i && !net_shm_peer(netA, linkAB, NULL, NULL);i--) util_loop_once(loop, 10);
+  fail_unless(i);
+  fail_unless(net_shm_fds(netA, fds, 4, &ms) == 3);
+  for(i = 0; i <= count; i++) close(full[i]);
+  fail_unless(util_loop_remove(loop, netB));
+  net_shm_free(netB);
+
+  util_loop_free(loop);
+  net_shm_free(netA);
+  fail_unless(access(pathA, F_OK) != 0);
+  mesh_free(meshC);
+
+  return 0;
+}
+
+#else
+
+int main(int argc, char **argv)
+{
+  return 0;
+}
+
+#endif // __linux__
@@ -1,50 +1,113 @@
 #include "net_tcp4.h"
+#include "util_loop.h"
 #include "util_sys.h"
-#include "util_unix.h"
 #include "unit_test.h"
 
+static int pipes(link_t link)
+{
+  int count = 0;
+  link_pipe_t pipe;
+  for(pipe = link_pipes(link, NULL); pipe; pipe = link_pipes(link, pipe)) count++;
+  return count;
+}
+
 int main(int argc, char **argv)
 {
   mesh_t meshA = mesh_new();
   fail_unless(meshA);
-  lob_t secretsA = mesh_generate(meshA);
-  fail_unless(secretsA);
-
+  fail_unless(mesh_generate(meshA));
   mesh_t meshB = mesh_new();
   fail_unless(meshB);
-  lob_t secretsB = mesh_generate(meshB);
-  fail_unless(secretsB);
-  
+  fail_unless(mesh_generate(meshB));
+
   net_tcp4_t netA = net_tcp4_new(meshA, NULL);
   fail_unless(netA);
-  fail_unless(netA->port > 0);
-  fail_unless(netA->path);
-  LOG("netA %.*s",netA->path->head_len,netA->path->head);
-
+  fail_unless(net_tcp4_port(netA) > 0);
   net_tcp4_t netB = net_tcp4_new(meshB, NULL);
   fail_unless(netB);
-  fail_unless(netB->port > 0);
-  LOG("netB %.*s",netB->path->head_len,netB->path->head);
-  
-  link_t linkAB = link_keys(meshA, meshB->keys);
-  link_t linkBA = link_keys(meshB, meshA->keys);
+  fail_unless(net_tcp4_port(netB) > 0);
+
+  // both transports on one loop, it only needs a mesh for deadlines
+  util_loop_t loop = util_loop_new(meshA);
+  fail_unless(loop);
+  fail_unless(net_tcp4_loop(netA, loop));
+  fail_unless(net_tcp4_loop(netB, loop));
+
+  link_t linkAB = link_get_keys(meshA, meshB->keys);
+  link_t linkBA = link_get_keys(meshB, meshA->keys);
   fail_unless(linkAB);
   fail_unless(linkBA);
-  
-  fail_unless(link_path(linkAB,netB->path));
-  fail_unless(link_path(linkBA,netA->path));
-  
-  link_sync(linkAB);
-  // let tcp go back and forth enough, need a better way to do this
-  int loop;
-  for(loop = 10; loop; loop--)
+
+  // a path connects and handshakes over the new pipe
+  lob_t path = lob_new();
+  lob_set(path,"type","tcp4");
+  lob_set(path,"ip","127.0.0.1");
+  lob_set_int(path,"port",net_tcp4_port(netB));
+  fail_unless(mesh_path(meshA, linkAB, path));
+  fail_unless(pipes(linkAB) == 1);
+
+  // the listener and the connecting socket that wants to write
+  struct pollfd fds[4];
+  int ms = -1;
+  fail_unless(net_tcp4_fds(netA, fds, 4, &ms) == 2);
+  fail_unless(fds[0].fd == net_tcp4_socket(netA));
+  fail_unless(fds[1].events & POLLOUT);
+
+  int i;
+  for(i=64;i;i--)
   {
-    net_tcp4_loop(netB);
-    net_tcp4_loop(netA);
+    fail_unless(util_loop_once(loop, 10));
+    if(link_up(linkAB) && link_up(linkBA)) break;
   }
-  fail_unless(e3x_exchange_out(linkBA->x,0) >= e3x_exchange_out(linkAB->x,0));
-  fail_unless(e3x_exchange_out(linkBA->x,0) == e3x_exchange_out(linkAB->x,0));
+  fail_unless(i);
+  fail_unless(pipes(linkBA) == 1);
+
+  // once flushed only reads are of interest
+  for(i=0;i<4;i++) util_loop_once(loop, 0);
+  fail_unless(net_tcp4_fds(netA, fds, 4, &ms) == 2);
+  fail_unless(fds[1].events == POLLIN);
+
+  // connections are reused per peer, from either side
+  fail_unless(mesh_path(meshA, linkAB, path));
+  fail_unless(pipes(linkAB) == 1);
+  lob_set_int(path,"port",net_tcp4_port(netA));
+  fail_unless(mesh_path(meshB, linkBA, path));
+  fail_unless(pipes(linkBA) == 1);
+  fail_unless(net_tcp4_fds(netB, fds, 4, &ms) == 2);
+  lob_free(path);
+
+  // a second hashname handshaking over the same connection takes it over
+  mesh_t meshC = mesh_new();
+  fail_unless(mesh_generate(meshC));
+  link_t linkCB = link_get_keys(meshC, meshB->keys);
+  link_t linkBC = link_get_keys(meshB, meshC->keys);
+  fail_unless(linkCB);
+  fail_unless(linkBC);
+  link_pipe_t ab = link_pipes(linkAB, NULL);
+  fail_unless(ab->send(linkAB, link_handshake(linkCB), ab->arg));
+  for(i=64;i && !pipes(linkBC);i--) util_loop_once(loop, 10);
+  fail_unless(pipes(linkBC) == 1);
+  fail_unless(pipes(linkBA) == 0);
+
+  // the link it left going down, or a stale drop from it, doesn't close it
+  link_down(linkBA);
+  link_pipe_t bc = link_pipes(linkBC, NULL);
+  fail_unless(bc->send(linkBA, NULL, bc->arg));
+  for(i=0;i<4;i++) util_loop_once(loop, 0);
+  fail_unless(pipes(linkBC) == 1);
+  fail_unless(net_tcp4_fds(netB, fds, 4, &ms) == 2);
+  fail_unless(pipes(linkAB) == 1);
+
+  // a closed connection is dropped from the other side's link
+  fail_unless(util_loop_remove(loop, netB));
+  net_tcp4_free(netB);
+  fail_unless(pipes(linkBC) == 0);
+  for(i=8;i && pipes(linkAB);i--) util_loop_once(loop, 10);
+  fail_unless(pipes(linkAB) == 0);
+
+  util_loop_free(loop);
+  net_tcp4_free(netA);
+  mesh_free(meshC);
 
   return 0;
 }
-
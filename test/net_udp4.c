@@ -1,4 +1,5 @@
 #include "net_udp4.h"
+#include "util_frames.h"
 #include "util_sys.h"
 #include "unit_test.h"
 
@@ -40,6 +41,38 @@ int main(int argc, char **argv)
   fail_unless(i);
   LOG_DEBUG("done in %d loops",32-i);
 
+  // frame modes are options, invalid ones are refused up front
+  lob_t options = lob_new();
+  lob_set_int(options,"frames",UTIL_FRAMES_WINDOW+1);
+  fail_unless(!net_udp4_new(meshA, options));
+  lob_set_int(options,"frames",8);
+  lob_set_int(options,"fec",3);
+  fail_unless(!net_udp4_new(meshA, options));
+
+  // crc checked, windowed and w/ parity on both sides
+  lob_set_int(options,"fec",4);
+  lob_set_int(options,"crc",1);
+  mesh_t meshC = mesh_new();
+  fail_unless(mesh_generate(meshC));
+  mesh_t meshD = mesh_new();
+  fail_unless(mesh_generate(meshD));
+  net_udp4_t netC = net_udp4_new(meshC, options);
+  fail_unless(netC);
+  net_udp4_t netD = net_udp4_new(meshD, options);
+  fail_unless(netD);
+  lob_free(options);
+  link_t linkCD = link_get_keys(meshC, meshD->keys);
+  link_t linkDC = link_get_keys(meshD, meshC->keys);
+  fail_unless(linkCD && linkDC);
+  net_udp4_direct(netC,link_handshake(linkCD),"127.0.0.1",net_udp4_port(netD));
+  for(i=32;i;i--)
+  {
+    net_udp4_process(netC);
+    net_udp4_process(netD);
+    if(link_up(linkCD) && link_up(linkDC)) break;
+  }
+  fail_unless(i);
+
   return 0;
 }
 
@@ -0,0 +1,172 @@
+#include "net_unix.h"
+#include "util_loop.h"
+#include "util_sys.h"
+#include "unit_test.h"
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static int pipes(link_t link)
+{
+  int count = 0;
+  link_pipe_t pipe;
+  for(pipe = link_pipes(link, NULL); pipe; pipe = link_pipes(link, pipe)) count++;
+  return count;
+}
+
+int main(int argc, char **argv)
+{
+  char pathA[64], pathB[64];
+  snprintf(pathA,sizeof(pathA),"/tmp/net_unix_a.%d",(int)getpid());
+  snprintf(pathB,sizeof(pathB),"/tmp/net_unix_b.%d",(int)getpid());
+
+  mesh_t meshA = mesh_new();
+  fail_unless(meshA);
+  fail_unless(mesh_generate(meshA));
+  mesh_t meshB = mesh_new();
+  fail_unless(meshB);
+  fail_unless(mesh_generate(meshB));
+
+  // a path is required
+  fail_unless(!net_unix_new(meshA, NULL));
+
+  lob_t options = lob_new();
+  lob_set(options,"path",pathA);
+  net_unix_t netA = net_unix_new(meshA, options);
+  fail_unless(netA);
+
+  // a live listener or anything not a socket is never taken over
+  fail_unless(!net_unix_new(meshB, options));
+  fail_unless(access(pathA, F_OK) == 0);
+  FILE *file = fopen(pathB,"w");
+  fail_unless(file);
+  fclose(file);
+  lob_set(options,"path",pathB);
+  fail_unless(!net_unix_new(meshB, options));
+  fail_unless(access(pathB, F_OK) == 0);
+  unlink(pathB);
+
+  // but one left behind by a process that's gone is
+  struct sockaddr_un sa;
+  memset(&sa,0,sizeof(sa));
+  sa.sun_family = AF_UNIX;
+  strcpy(sa.sun_path, pathB);
+  int old = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  fail_unless(bind(old, (struct sockaddr *)&sa, sizeof(sa)) == 0);
+  close(old);
+  fail_unless(access(pathB, F_OK) == 0);
+  net_unix_t netB = net_unix_new(meshB, options);
+  fail_unless(netB);
+
+  util_loop_t loop = util_loop_new(meshA);
+  fail_unless(loop);
+  fail_unless(net_unix_loop(netA, loop));
+  fail_unless(net_unix_loop(netB, loop));
+
+  link_t linkAB = link_get_keys(meshA, meshB->keys);
+  link_t linkBA = link_get_keys(meshB, meshA->keys);
+  fail_unless(linkAB);
+  fail_unless(linkBA);
+
+  // connecting is immediate and the handshake already went out whole
+  lob_t path = net_unix_path(netB);
+  fail_unless(path);
+  fail_unless(lob_get_cmp(path,"path",pathB) == 0);
+  fail_unless(mesh_path(meshA, linkAB, path));
+  fail_unless(pipes(linkAB) == 1);
+  struct pollfd fds[4];
+  int ms = -1;
+  fail_unless(net_unix_fds(netA, fds, 4, &ms) == 2);
+  fail_unless(fds[1].events == POLLIN);
+
+  int i;
+  for(i=64;i;i--)
+  {
+    fail_unless(util_loop_once(loop, 10));
+    if(link_up(linkAB) && link_up(linkBA)) break;
+  }
+  fail_unless(i);
+  fail_unless(pipes(linkBA) == 1);
+
+  // both ends know who the other process is
+  uid_t uid = 1;
+  pid_t pid = 0;
+  fail_unless(net_unix_peer(netA, linkAB, &uid, &pid));
+  fail_unless(uid == geteuid());
+  fail_unless(pid == getpid());
+  fail_unless(net_unix_peer(netB, linkBA, &uid, &pid));
+  fail_unless(pid == getpid());
+  fail_unless(!net_unix_peer(netA, linkBA, &uid, &pid));
+
+  // connections are reused per peer, from either side
+  fail_unless(mesh_path(meshA, linkAB, path));
+  fail_unless(pipes(linkAB) == 1);
+  lob_free(path);
+  path = net_unix_path(netA);
+  fail_unless(mesh_path(meshB, linkBA, path));
+  fail_unless(pipes(linkBA) == 1);
+  lob_free(path);
+
+  // a second hashname handshaking over the same connection takes it over
+  mesh_t meshC = mesh_new();
+  fail_unless(mesh_generate(meshC));
+  link_t linkCB = link_get_keys(meshC, meshB->keys);
+  link_t linkBC = link_get_keys(meshB, meshC->keys);
+  fail_unless(linkCB);
+  fail_unless(linkBC);
+  link_pipe_t ab = link_pipes(linkAB, NULL);
+  fail_unless(ab->send(linkAB, link_handshake(linkCB), ab->arg));
+  for(i=64;i && !pipes(linkBC);i--) util_loop_once(loop, 10);
+  fail_unless(pipes(linkBC) == 1);
+  fail_unless(pipes(linkBA) == 0);
+
+  // the link it left going down, or a stale drop from it, doesn't close it
+  link_down(linkBA);
+  link_pipe_t bc = link_pipes(linkBC, NULL);
+  fail_unless(bc->send(linkBA, NULL, bc->arg));
+  for(i=0;i<4;i++) util_loop_once(loop, 0);
+  fail_unless(pipes(linkBC) == 1);
+  fail_unless(net_unix_fds(netB, fds, 4, &ms) == 2);
+  fail_unless(pipes(linkAB) == 1);
+
+  // a closed connection is dropped from the other side's link, and the socket file goes with it
+  fail_unless(util_loop_remove(loop, netB));
+  net_unix_free(netB);
+  fail_unless(pipes(linkBC) == 0);
+  fail_unless(access(pathB, F_OK) != 0);
+  for(i=8;i && pipes(linkAB);i--) util_loop_once(loop, 10);
+  fail_unless(pipes(linkAB) == 0);
+
+  // connecting to a listener w/ a full backlog is retried from the loop
+  netB = net_unix_new(meshB, options);
+  fail_unless(netB);
+  lob_free(options);
+  fail_unless(net_unix_loop(netB, loop));
+  int full[256], count;
+  for(count = 0; count < 256; count++)
+  {
+    full[count] = socket(AF_UNIX, SOCK_SEQPACKET|SOCK_NONBLOCK, 0);
+    if(connect(full[count], (struct sockaddr *)&sa, sizeof(sa)) < 0) break;
+  }
+  fail_unless(count < 256);
+  path = net_unix_path(netB);
+  fail_unless(mesh_path(meshA, linkAB, path));
+  lob_free(path);
+  fail_unless(pipes(linkAB) == 1);
+  fail_unless(!net_unix_peer(netA, linkAB, NULL, NULL));
+  ms = -1;
+  fail_unless(net_unix_fds(netA, fds, 4, &ms) == 1);
+  fail_unless(ms == NET_UNIX_RETRY);
+  for(i=64;i && !net_unix_peer(netA, linkAB, NULL, NULL);i--) util_loop_once(loop, 10);
+  fail_unless(i);
+  for(i = 0; i <= count; i++) close(full[i]);
+  fail_unless(util_loop_remove(loop, netB));
+  net_unix_free(netB);
+
+  util_loop_free(loop);
+  net_unix_free(netA);
+  fail_unless(access(pathA, F_OK) != 0);
+  mesh_free(meshC);
+
+  return 0;
+}
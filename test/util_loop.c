@@ -0,0 +1,123 @@
+#include "net_udp4.h"
+#include "util_loop.h"
+#include "util_sys.h"
+#include "unit_test.h"
+#include <unistd.h>
+
+// one transport that always has something to read and one that only has a timer
+static int busy[2], busied = 0, timed = 0;
+static int busy_fds(void *net, struct pollfd *fds, int max, int *ms)
+{
+  fds[0].fd = busy[0];
+  fds[0].events = POLLIN;
+  return 1;
+}
+static void *busy_ready(void *net, struct pollfd *fds, int count)
+{
+  busied++;
+  return net;
+}
+static int timer_fds(void *net, struct pollfd *fds, int max, int *ms)
+{
+  if(*ms < 0 || *ms > 20) *ms = 20;
+  return 0;
+}
+static void *timer_ready(void *net, struct pollfd *fds, int count)
+{
+  timed++;
+  return net;
+}
+
+int main(int argc, char **argv)
+{
+  mesh_t meshA = mesh_new();
+  fail_unless(meshA);
+  fail_unless(mesh_generate(meshA));
+  mesh_t meshB = mesh_new();
+  fail_unless(meshB);
+  fail_unless(mesh_generate(meshB));
+
+  net_udp4_t netA = net_udp4_new(meshA, NULL);
+  fail_unless(netA);
+  net_udp4_t netB = net_udp4_new(meshB, NULL);
+  fail_unless(netB);
+
+  util_loop_t loopA = util_loop_new(meshA);
+  fail_unless(loopA);
+  fail_unless(net_udp4_loop(netA, loopA));
+  util_loop_t loopB = util_loop_new(meshB);
+  fail_unless(loopB);
+  fail_unless(net_udp4_loop(netB, loopB));
+
+  // the socket is always read, written only when frames are pending
+  struct pollfd fds[2];
+  int ms = -1;
+  fail_unless(net_udp4_fds(netA, fds, 2, &ms) == 1);
+  fail_unless(fds[0].fd == net_udp4_socket(netA));
+  fail_unless(fds[0].events == POLLIN);
+  fail_unless(ms == -1);
+
+  link_t linkAB = link_get_keys(meshA, meshB->keys);
+  link_t linkBA = link_get_keys(meshB, meshA->keys);
+  fail_unless(linkAB);
+  fail_unless(linkBA);
+  net_udp4_direct(netA,link_handshake(linkAB),"127.0.0.1",net_udp4_port(netB));
+  fail_unless(net_udp4_fds(netA, fds, 2, &ms) == 1);
+  fail_unless(fds[0].events & POLLOUT);
+
+  int i;
+  for(i=64;i;i--)
+  {
+    fail_unless(util_loop_once(loopA, 10));
+    fail_unless(util_loop_once(loopB, 10));
+    if(link_up(linkAB) && link_up(linkBA)) break;
+  }
+  fail_unless(i);
+
+  // once everything is delivered an idle loop sleeps instead of spinning
+  for(i=0;i<8;i++)
+  {
+    util_loop_once(loopA, 0);
+    util_loop_once(loopB, 0);
+  }
+  unsigned long long start = util_sys_ms(0);
+  for(i=0;util_sys_ms(0) - start < 100;i++) fail_unless(util_loop_once(loopA, 100));
+  fail_unless(i <= 2);
+
+  // the mesh deadline alone wakes it for a keepalive probe, which the other side answers
+  fail_unless(mesh_keepalive(meshA, 1, 0));
+  fail_unless(mesh_deadline(meshA, util_sys_seconds()));
+  start = util_sys_ms(0);
+  for(i=0;!linkAB->probed && util_sys_ms(0) - start < 3000;i++) fail_unless(util_loop_once(loopA, -1));
+  fail_unless(linkAB->probed);
+  fail_unless(i < 8);
+  for(i=0;i<8;i++)
+  {
+    util_loop_once(loopB, 10);
+    util_loop_once(loopA, 10);
+  }
+  fail_unless(linkAB->heard || linkAB->seen >= linkAB->probed);
+
+  // a transport timer still fires while another's fd is always ready
+  util_loop_t loopC = util_loop_new(meshA);
+  fail_unless(loopC);
+  fail_unless(pipe(busy) == 0);
+  fail_unless(write(busy[1],"x",1) == 1);
+  fail_unless(util_loop_add(loopC, &busied, busy_fds, busy_ready));
+  fail_unless(util_loop_add(loopC, &timed, timer_fds, timer_ready));
+  start = util_sys_ms(0);
+  while(!timed && util_sys_ms(0) - start < 1000) fail_unless(util_loop_once(loopC, -1));
+  fail_unless(timed == 1);
+  fail_unless(busied > 1);
+  util_loop_free(loopC);
+  close(busy[0]);
+  close(busy[1]);
+
+  fail_unless(util_loop_remove(loopA, netA));
+  util_loop_free(loopA);
+  util_loop_free(loopB);
+  net_udp4_free(netA);
+  net_udp4_free(netB);
+
+  return 0;
+}
@@ -0,0 +1,56 @@
+#include <unistd.h>
+#include "net_loopback.h"
+#include "unit_test.h"
+
+int main(int argc, char **argv)
+{
+  mesh_t meshA = mesh_new();
+  fail_unless(meshA);
+  lob_t secretsA = mesh_generate(meshA);
+  fail_unless(secretsA);
+
+  mesh_t meshB = mesh_new();
+  fail_unless(meshB);
+  lob_t secretsB = mesh_generate(meshB);
+  fail_unless(secretsB);
+
+  util_workers_t workers = util_workers_new(meshA, 2);
+  fail_unless(workers);
+
+  net_loopback_t pair = net_loopback_new(meshA,meshB);
+  fail_unless(pair);
+
+  link_t linkAB = link_get(meshA, meshB->id);
+  link_t linkBA = link_get(meshB, meshA->id);
+  fail_unless(linkAB);
+  fail_unless(linkBA);
+
+  // A's side of the handshake is now waiting on a worker
+  fail_unless(link_resync(linkBA));
+  fail_unless(!link_up(linkBA));
+
+  int i;
+  uint32_t done = 0;
+  for(i = 0; i < 500 && util_workers_pending(workers); i++)
+  {
+    done += util_workers_process(workers);
+    usleep(1000);
+  }
+  done += util_workers_process(workers);
+  fail_unless(done);
+  fail_unless(!util_workers_pending(workers));
+  fail_unless(link_up(linkAB));
+  fail_unless(link_up(linkBA));
+
+  // channel packets still go straight through
+  lob_t open = lob_new();
+  lob_set(open,"type","test");
+  lob_set_uint(open,"c",e3x_exchange_cid(linkBA->x, NULL));
+  fail_unless(link_direct(linkBA, open));
+
+  fail_unless(!util_workers_free(workers));
+  mesh_free(meshA);
+  mesh_free(meshB);
+
+  return 0;
+}
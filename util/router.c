@@ -21,6 +21,7 @@ int main(int argc, char *argv[])
   lob_t options, json;
   mesh_t mesh;
   net_udp4_t udp4;
+  util_loop_t loop;
   int port = 0;
   int link = 0;
 
@@ -45,7 +46,8 @@ int main(int argc, char *argv[])
   lob_set_int(options,"port",port);
 
   udp4 = net_udp4_new(mesh, options);
-  util_sock_timeout(net_udp4_socket(udp4),100);
+  loop = util_loop_new(mesh);
+  net_udp4_loop(udp4, loop);
 
   json = mesh_json(mesh);
   printf("%s\n",lob_json(json));
@@ -57,7 +59,7 @@ int main(int argc, char *argv[])
     printf("sent hello to %d\n",link);
   }
 
-  while(net_udp4_process(udp4));
+  util_loop_run(loop);
 
   perror("exiting");
   return 0;